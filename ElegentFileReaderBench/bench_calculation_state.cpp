@@ -0,0 +1,180 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "CalculationState.h"
+#include "WorkerPool.h"
+
+using score::CalculationState;
+using score::DoubleState;
+using score::detail::Isa;
+
+namespace {
+/// from a single column of a short projection to many policies x 240 months, past the non-temporal threshold
+void ColumnSizes(benchmark::internal::Benchmark* benchmark)
+{
+    for (const int64_t size : {16, 240, 4 * 1024, 64 * 1024, 1024 * 1024, 4 * 1024 * 1024, 32 * 1024 * 1024})
+        benchmark->Arg(size);
+}
+
+void SetBytes(benchmark::State& state)
+{
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0) * static_cast<int64_t>(sizeof(double)));
+}
+
+/// what set_not_calculated() does: the best kernel, streaming above the threshold
+void BM_SetNotCalculated(benchmark::State& state)
+{
+    std::vector<double> values(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        DoubleState::set_not_calculated_score(values.data(), values.size());
+        benchmark::ClobberMemory();
+    }
+    SetBytes(state);
+}
+BENCHMARK(BM_SetNotCalculated)->Apply(ColumnSizes);
+
+/// the same over a pool of every logical cpu; a fresh array each time would show the first touch too, but mostly page faults
+void BM_SetNotCalculated_Parallel(benchmark::State& state)
+{
+    static score::WorkerPool pool(0, true);
+    std::vector<double> values(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        DoubleState::set_not_calculated_score(pool, values.data(), values.size());
+        benchmark::ClobberMemory();
+    }
+    SetBytes(state);
+}
+BENCHMARK(BM_SetNotCalculated_Parallel)->Apply(ColumnSizes)->UseRealTime();
+
+template <Isa isa, bool non_temporal>
+void BM_Fill(benchmark::State& state)
+{
+    if (!score::detail::is_supported(isa)) {
+        state.SkipWithError("not supported by this cpu");
+        return;
+    }
+
+    std::vector<uint64_t> values(static_cast<size_t>(state.range(0)));
+    const uint64_t pattern = DoubleState::fill_pattern_of(CalculationState::NotCalculated);
+    for (auto _ : state) {
+        score::detail::fill_pattern(isa, values.data(), values.size(), pattern, non_temporal);
+        benchmark::ClobberMemory();
+    }
+    SetBytes(state);
+}
+BENCHMARK_TEMPLATE(BM_Fill, Isa::Scalar, false)->Apply(ColumnSizes);
+BENCHMARK_TEMPLATE(BM_Fill, Isa::Avx2, false)->Apply(ColumnSizes);
+BENCHMARK_TEMPLATE(BM_Fill, Isa::Avx2, true)->Apply(ColumnSizes);
+BENCHMARK_TEMPLATE(BM_Fill, Isa::Avx512, false)->Apply(ColumnSizes);
+BENCHMARK_TEMPLATE(BM_Fill, Isa::Avx512, true)->Apply(ColumnSizes);
+
+/// the baselines: the compiler's own fill, and (MSVC) the rep stosq the code used to use
+void BM_StdFill(benchmark::State& state)
+{
+    std::vector<uint64_t> values(static_cast<size_t>(state.range(0)));
+    const uint64_t pattern = DoubleState::fill_pattern_of(CalculationState::NotCalculated);
+    for (auto _ : state) {
+        std::fill(values.begin(), values.end(), pattern);
+        benchmark::ClobberMemory();
+    }
+    SetBytes(state);
+}
+BENCHMARK(BM_StdFill)->Apply(ColumnSizes);
+
+#if defined(_MSC_VER) && defined(_WIN64)
+void BM_RepStosq(benchmark::State& state)
+{
+    std::vector<uint64_t> values(static_cast<size_t>(state.range(0)));
+    const uint64_t pattern = DoubleState::fill_pattern_of(CalculationState::NotCalculated);
+    for (auto _ : state) {
+        __stosq(reinterpret_cast<unsigned long long*>(values.data()), pattern, values.size());
+        benchmark::ClobberMemory();
+    }
+    SetBytes(state);
+}
+BENCHMARK(BM_RepStosq)->Apply(ColumnSizes);
+#endif
+
+/// a calculated column with one value left uncalculated at the end: the whole column has to be scanned
+std::vector<double> CalculatedColumn(const benchmark::State& state)
+{
+    std::vector<double> values(static_cast<size_t>(state.range(0)), 1.5);
+    DoubleState::set<CalculationState::NotCalculated>(values.back());
+    return values;
+}
+
+template <Isa isa>
+void BM_CountStates(benchmark::State& state)
+{
+    if (!score::detail::is_supported(isa)) {
+        state.SkipWithError("not supported by this cpu");
+        return;
+    }
+
+    const std::vector<double> values = CalculatedColumn(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(score::detail::count_states(isa, values.data(), values.size()));
+    SetBytes(state);
+}
+BENCHMARK_TEMPLATE(BM_CountStates, Isa::Scalar)->Apply(ColumnSizes);
+BENCHMARK_TEMPLATE(BM_CountStates, Isa::Avx2)->Apply(ColumnSizes);
+BENCHMARK_TEMPLATE(BM_CountStates, Isa::Avx512)->Apply(ColumnSizes);
+
+template <Isa isa>
+void BM_FindFirstUncalculated(benchmark::State& state)
+{
+    if (!score::detail::is_supported(isa)) {
+        state.SkipWithError("not supported by this cpu");
+        return;
+    }
+
+    const std::vector<double> values = CalculatedColumn(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(score::detail::find_first_uncalculated(isa, values.data(), values.size()));
+    SetBytes(state);
+}
+BENCHMARK_TEMPLATE(BM_FindFirstUncalculated, Isa::Scalar)->Apply(ColumnSizes);
+BENCHMARK_TEMPLATE(BM_FindFirstUncalculated, Isa::Avx2)->Apply(ColumnSizes);
+BENCHMARK_TEMPLATE(BM_FindFirstUncalculated, Isa::Avx512)->Apply(ColumnSizes);
+
+template <Isa isa>
+void BM_CalculatedMask(benchmark::State& state)
+{
+    if (!score::detail::is_supported(isa)) {
+        state.SkipWithError("not supported by this cpu");
+        return;
+    }
+
+    const std::vector<double> values = CalculatedColumn(state);
+    std::vector<uint64_t> mask((values.size() + 63) / 64);
+    for (auto _ : state) {
+        score::detail::calculated_mask(isa, values.data(), values.size(), mask.data());
+        benchmark::ClobberMemory();
+    }
+    SetBytes(state);
+}
+BENCHMARK_TEMPLATE(BM_CalculatedMask, Isa::Scalar)->Apply(ColumnSizes);
+BENCHMARK_TEMPLATE(BM_CalculatedMask, Isa::Avx2)->Apply(ColumnSizes);
+BENCHMARK_TEMPLATE(BM_CalculatedMask, Isa::Avx512)->Apply(ColumnSizes);
+
+/// a sparse recalculation: one value changed in the middle of a calculated column, checked through its BlockSummary
+void BM_FindFirstUncalculated_Summary(benchmark::State& state)
+{
+    std::vector<double> values(static_cast<size_t>(state.range(0)), 1.5);
+    score::BlockSummary summary(values.data(), values.size());
+    const size_t changed = values.size() / 2;
+    for (auto _ : state) {
+        DoubleState::set<CalculationState::NotCalculated>(values.data(), changed, summary);
+        benchmark::DoNotOptimize(DoubleState::find_first_uncalculated(values.data(), summary));
+        values[changed] = 1.5;
+        summary.calculated(changed);
+    }
+    SetBytes(state);
+}
+BENCHMARK(BM_FindFirstUncalculated_Summary)->Apply(ColumnSizes);
+}
@@ -0,0 +1,94 @@
+#include "pch.h"
+
+#include <vector>
+
+#include "ColumnAggregate.h"
+
+using score::CalculationState;
+using score::DoubleState;
+using score::detail::Isa;
+
+namespace {
+/// 240 months, up to a reporting run's policies x scenarios in one column
+void ColumnSizes(benchmark::internal::Benchmark* benchmark)
+{
+    for (const int64_t size : {240, 4 * 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024})
+        benchmark->Arg(size);
+}
+
+/// every 10th value NoAvg
+std::vector<double> Column(const benchmark::State& state)
+{
+    std::vector<double> values(static_cast<size_t>(state.range(0)));
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = static_cast<double>(i % 1000);
+        if (i % 10 == 0)
+            DoubleState::set<CalculationState::NoAvg>(values[i]);
+    }
+    return values;
+}
+
+void SetBytes(benchmark::State& state)
+{
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0) * static_cast<int64_t>(sizeof(double)));
+}
+
+template <Isa isa>
+void BM_Aggregate(benchmark::State& state)
+{
+    if (!score::detail::is_supported(isa)) {
+        state.SkipWithError("not supported by this cpu");
+        return;
+    }
+
+    const std::vector<double> values = Column(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(score::detail::aggregate(isa, values.data(), values.size()));
+    SetBytes(state);
+}
+BENCHMARK_TEMPLATE(BM_Aggregate, Isa::Scalar)->Apply(ColumnSizes);
+BENCHMARK_TEMPLATE(BM_Aggregate, Isa::Avx2)->Apply(ColumnSizes);
+BENCHMARK_TEMPLATE(BM_Aggregate, Isa::Avx512)->Apply(ColumnSizes);
+
+template <Isa isa>
+void BM_Accumulate(benchmark::State& state)
+{
+    if (!score::detail::is_supported(isa)) {
+        state.SkipWithError("not supported by this cpu");
+        return;
+    }
+
+    const std::vector<double> values = Column(state);
+    std::vector<double> sums(values.size());
+    std::vector<uint64_t> counts(values.size());
+    for (auto _ : state) {
+        score::detail::accumulate(isa, values.data(), values.size(), sums.data(), counts.data());
+        benchmark::ClobberMemory();
+    }
+    SetBytes(state);
+}
+BENCHMARK_TEMPLATE(BM_Accumulate, Isa::Scalar)->Apply(ColumnSizes);
+BENCHMARK_TEMPLATE(BM_Accumulate, Isa::Avx2)->Apply(ColumnSizes);
+BENCHMARK_TEMPLATE(BM_Accumulate, Isa::Avx512)->Apply(ColumnSizes);
+
+/// the baseline: the two loops of the avxing test, with NO_AVG as a plain double
+void BM_AccumulateTwoLoops(benchmark::State& state)
+{
+    const double no_avg = 1e300;
+    std::vector<double> values = Column(state);
+    for (auto& value : values)
+        if (DoubleState::is<CalculationState::NoAvg>(value))
+            value = no_avg;
+    std::vector<double> sums(values.size());
+    std::vector<uint64_t> counts(values.size());
+    for (auto _ : state) {
+        for (size_t i = 0; i < values.size(); ++i)
+            sums[i] += (values[i] == no_avg) ? 0 : values[i];
+        for (size_t i = 0; i < values.size(); ++i)
+            counts[i] += (values[i] == no_avg) ? 0 : 1;
+        benchmark::ClobberMemory();
+    }
+    SetBytes(state);
+}
+BENCHMARK(BM_AccumulateTwoLoops)->Apply(ColumnSizes);
+}
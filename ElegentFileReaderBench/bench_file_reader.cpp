@@ -0,0 +1,626 @@
+#include "pch.h"
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "BufferPool.h"
+#include "CSVFileIndex.h"
+#include "ElegentFileReader.h"
+#include "ElegentFileWriter.h"
+#include "ExternalSort.h"
+#include "HashJoin.h"
+#include "InputSource.h"
+#include "Sampling.h"
+#include "TableLoader.h"
+#include "Trace.h"
+
+namespace {
+/// The files the benchmarks read, made up so they run anywhere:
+///     CashFlows: shaped like "Main model_Main Model - MCEV~control~cf.csv" - comma separated, 24 narrow fields,
+///                a block of 1201 monthly records per "batch|model point" key (in field 2)
+///     Meritz:    shaped like Meritz.tbl - tab separated, 164 fields, rows of small ints and rates
+/// The same seed every time, so the numbers can be compared run to run.
+enum class Shape { CashFlows, Meritz };
+enum class Eol { Lf, CrLf };
+
+struct SyntheticFile {
+    std::string path_;
+    uint64_t bytes_ = 0;
+    uint64_t records_ = 0; // with the header
+    std::vector<std::string> keys_;
+};
+
+const size_t cash_flow_keys = 64;
+const size_t months = 1201;
+const size_t meritz_rows = 4000;
+
+class Random {
+public:
+    uint32_t next() { return state_ = state_ * 1664525u + 1013904223u; }
+    double rate() { return (next() >> 8) / double(1 << 24); }
+
+private:
+    uint32_t state_ = 12345;
+};
+
+void WriteCashFlows(std::ofstream& file, const char* eol, SyntheticFile& info)
+{
+    file << "RUN,SCEN,KEY,T";
+    for (int i = 1; i <= 20; ++i)
+        file << ",CF" << i;
+    file << eol;
+
+    Random random;
+    const char* const products[] = {"ANN", "END", "TERM", "UL"};
+    char number[32];
+    for (size_t k = 0; k < cash_flow_keys; ++k) {
+        const std::string key = "batch" + std::to_string(k % 8) + "|" + products[k % 4] + "_" + std::to_string(4750 + k) + "_YYY_RP_Other";
+        info.keys_.push_back(key);
+        for (size_t t = 0; t < months; ++t) {
+            file << "1,0," << key << ',' << t;
+            for (int i = 0; i < 20; ++i) {
+                snprintf(number, sizeof(number), ",%.6f", (random.rate() - 0.5) * 20000);
+                file << number;
+            }
+            file << eol;
+        }
+    }
+    info.records_ = 1 + cash_flow_keys * months;
+}
+
+void WriteMeritz(std::ofstream& file, const char* eol, SyntheticFile& info)
+{
+    file << "TBL_NAME\tCODE6\tCODE7\tCODE8\tCODE10\tSEX";
+    for (int age = -99; age <= 133; ++age) {
+        if (age > -76 && age < 0)
+            continue; // as in the real file: -99 to -76, then 0 to 133
+        file << '\t' << age;
+    }
+    file << eol;
+
+    Random random;
+    char number[32];
+    for (size_t row = 0; row < meritz_rows; ++row) {
+        file << 1111111 + row / 2 << "\t0\t0\t0\t0\t" << (row % 2 ? "MALE" : "FEMALE");
+        for (int field = 6; field < 164; ++field) {
+            if (field < 40) {
+                file << "\t0";
+            } else {
+                snprintf(number, sizeof(number), "\t%.5f", random.rate() / 10);
+                file << number;
+            }
+        }
+        file << eol;
+    }
+    info.records_ = 1 + meritz_rows;
+}
+
+/// written once per run, to the temp directory
+const SyntheticFile& GetFile(const Shape shape, const Eol line_end)
+{
+    static std::map<std::pair<Shape, Eol>, SyntheticFile> files;
+    auto& info = files[{shape, line_end}];
+    if (!info.path_.empty())
+        return info;
+
+    const std::string name = std::string(shape == Shape::CashFlows ? "efr_bench_cf" : "efr_bench_meritz")
+        + (line_end == Eol::Lf ? "_lf" : "_crlf") + (shape == Shape::CashFlows ? ".csv" : ".tbl");
+    info.path_ = (std::filesystem::temp_directory_path() / name).string();
+    {
+        std::ofstream file(info.path_, std::ios::binary);
+        const char* const eol = line_end == Eol::Lf ? "\n" : "\r\n";
+        if (shape == Shape::CashFlows)
+            WriteCashFlows(file, eol, info);
+        else
+            WriteMeritz(file, eol, info);
+    }
+    info.bytes_ = std::filesystem::file_size(info.path_);
+    return info;
+}
+
+char Delimiter(const Shape shape)
+{
+    return shape == Shape::CashFlows ? ',' : '\t';
+}
+
+/// bytes/s and records/s
+void SetRates(benchmark::State& state, const SyntheticFile& file)
+{
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * file.bytes_));
+    state.counters["records"] = benchmark::Counter(static_cast<double>(state.iterations() * file.records_), benchmark::Counter::kIsRate);
+}
+
+/// read_size from 1 KB to 1 MB
+void ReadSizes(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->RangeMultiplier(4)->Range(1 << 10, 1 << 20)->ArgName("read_size");
+}
+
+/// from the file, or from source if there is one
+void ReadAll(benchmark::State& state, ElegentFileReader& reader, const SyntheticFile& file, const bool skip,
+             std::unique_ptr<InputSource> source = nullptr)
+{
+    if (source)
+        reader.open(std::move(source));
+    else
+        reader.open(file.path_.c_str());
+    for (auto _ : state) {
+        reader.seek(0);
+        while (!reader.isEOF()) {
+            if (skip)
+                reader.skipRecord();
+            else
+                benchmark::DoNotOptimize(reader.readRecord().data());
+        }
+    }
+    SetRates(state, file);
+#if ELEGENT_READER_STATS
+    // how often records straddle blocks, and what that costs: build with ELEGENT_READER_STATS=1 to size read_size
+    const ReaderStats& stats = reader.stats();
+    state.counters["straddling"] = benchmark::Counter(double(stats.partial_records_) / double(stats.blocks_read_));
+    state.counters["moved/block"] = benchmark::Counter(double(stats.partial_record_bytes_) / double(stats.blocks_read_));
+#endif
+}
+
+template <Shape shape, Eol line_end, bool skip>
+void BM_Read(benchmark::State& state)
+{
+    const SyntheticFile& file = GetFile(shape, line_end);
+    ElegentFileReader reader(static_cast<uint32_t>(state.range(0)), Delimiter(shape));
+    ReadAll(state, reader, file, skip);
+}
+// narrow and wide rows, LF and CRLF, readRecord and skipRecord
+BENCHMARK_TEMPLATE(BM_Read, Shape::CashFlows, Eol::CrLf, false)->Apply(ReadSizes);
+BENCHMARK_TEMPLATE(BM_Read, Shape::CashFlows, Eol::CrLf, true)->Apply(ReadSizes);
+BENCHMARK_TEMPLATE(BM_Read, Shape::CashFlows, Eol::Lf, false)->Apply(ReadSizes);
+BENCHMARK_TEMPLATE(BM_Read, Shape::CashFlows, Eol::Lf, true)->Apply(ReadSizes);
+BENCHMARK_TEMPLATE(BM_Read, Shape::Meritz, Eol::CrLf, false)->Apply(ReadSizes);
+BENCHMARK_TEMPLATE(BM_Read, Shape::Meritz, Eol::CrLf, true)->Apply(ReadSizes);
+BENCHMARK_TEMPLATE(BM_Read, Shape::Meritz, Eol::Lf, false)->Apply(ReadSizes);
+BENCHMARK_TEMPLATE(BM_Read, Shape::Meritz, Eol::Lf, true)->Apply(ReadSizes);
+
+/// BM_Read with tracing on: the cost of a span per readBlock, worst at small read sizes
+template <Shape shape>
+void BM_Read_Traced(benchmark::State& state)
+{
+    const SyntheticFile& file = GetFile(shape, Eol::CrLf);
+    ElegentFileReader reader(static_cast<uint32_t>(state.range(0)), Delimiter(shape));
+    trace::enable();
+    ReadAll(state, reader, file, false);
+    trace::enable(false);
+    trace::clear();
+}
+BENCHMARK_TEMPLATE(BM_Read_Traced, Shape::CashFlows)->Apply(ReadSizes);
+BENCHMARK_TEMPLATE(BM_Read_Traced, Shape::Meritz)->Apply(ReadSizes);
+
+/// the same parsing from each InputSource: what the ifstream costs over pread, a mapping, or bytes already in memory
+enum class Source { File, Pread, Mapped, Memory };
+
+template <Source source>
+void BM_Read_Source(benchmark::State& state)
+{
+    const SyntheticFile& file = GetFile(Shape::Meritz, Eol::CrLf);
+    std::string contents;
+    std::unique_ptr<InputSource> input;
+    if (Source::File == source) {
+        input = std::make_unique<FileSource>(file.path_.c_str());
+    } else if (Source::Pread == source) {
+        input = std::make_unique<PreadSource>(file.path_.c_str());
+    } else if (Source::Mapped == source) {
+        input = std::make_unique<MappedSource>(file.path_.c_str());
+    } else {
+        std::ifstream is(file.path_, std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+        input = std::make_unique<MemorySource>(contents.data(), contents.size());
+    }
+    ElegentFileReader reader(static_cast<uint32_t>(state.range(0)), '\t');
+    ReadAll(state, reader, file, false, std::move(input));
+}
+BENCHMARK_TEMPLATE(BM_Read_Source, Source::File)->Apply(ReadSizes);
+BENCHMARK_TEMPLATE(BM_Read_Source, Source::Pread)->Apply(ReadSizes);
+BENCHMARK_TEMPLATE(BM_Read_Source, Source::Mapped)->Apply(ReadSizes);
+BENCHMARK_TEMPLATE(BM_Read_Source, Source::Memory)->Apply(ReadSizes);
+
+template <Shape shape>
+void BM_Read_DelimitersAsOne(benchmark::State& state)
+{
+    const SyntheticFile& file = GetFile(shape, Eol::CrLf);
+    ElegentFileReader reader(static_cast<uint32_t>(state.range(0)), Delimiter(shape), true);
+    ReadAll(state, reader, file, false);
+}
+BENCHMARK_TEMPLATE(BM_Read_DelimitersAsOne, Shape::CashFlows)->Apply(ReadSizes);
+BENCHMARK_TEMPLATE(BM_Read_DelimitersAsOne, Shape::Meritz)->Apply(ReadSizes);
+
+/// only the key fields split out; the rest of the record is one field
+template <Shape shape>
+void BM_Read_MaxFields(benchmark::State& state)
+{
+    const SyntheticFile& file = GetFile(shape, Eol::CrLf);
+    ElegentFileReader reader(static_cast<uint32_t>(state.range(0)), Delimiter(shape), false, 4);
+    ReadAll(state, reader, file, false);
+}
+BENCHMARK_TEMPLATE(BM_Read_MaxFields, Shape::CashFlows)->Apply(ReadSizes);
+BENCHMARK_TEMPLATE(BM_Read_MaxFields, Shape::Meritz)->Apply(ReadSizes);
+
+/// model startup: dozens of small tables (about 8 KB each, like the input variable tables)
+const std::vector<std::string>& SmallTables()
+{
+    static std::vector<std::string> tables;
+    if (!tables.empty())
+        return tables;
+    Random random;
+    char number[32];
+    for (int table = 0; table < 48; ++table) {
+        tables.push_back((std::filesystem::temp_directory_path() / ("efr_bench_table" + std::to_string(table) + ".tbl")).string());
+        std::ofstream file(tables.back(), std::ios::binary);
+        file << "KEY\tVALUE1\tVALUE2\tVALUE3\tVALUE4\r\n";
+        for (int row = 0; row < 200; ++row) {
+            file << "K" << row;
+            for (int field = 0; field < 4; ++field) {
+                snprintf(number, sizeof(number), "\t%.5f", random.rate());
+                file << number;
+            }
+            file << "\r\n";
+        }
+    }
+    return tables;
+}
+
+void CountRecords(ElegentFileReader& reader, size_t& records)
+{
+    while (!reader.isEOF())
+        records += !reader.readRecord().empty();
+}
+
+void BM_LoadTables_OneAtATime(benchmark::State& state)
+{
+    const auto& tables = SmallTables();
+    for (auto _ : state) {
+        std::vector<size_t> records(tables.size());
+        for (size_t i = 0; i < tables.size(); ++i) {
+            ElegentFileReader reader(static_cast<uint32_t>(64_Kb), '\t');
+            reader.open(tables[i].c_str());
+            CountRecords(reader, records[i]);
+        }
+        benchmark::DoNotOptimize(records.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * tables.size()));
+}
+BENCHMARK(BM_LoadTables_OneAtATime)->UseRealTime();
+
+void BM_LoadTables(benchmark::State& state)
+{
+    const auto& tables = SmallTables();
+    score::TableLoader loader(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        std::vector<size_t> records(tables.size());
+        for (size_t i = 0; i < tables.size(); ++i)
+            loader.add(tables[i], [&records, i](ElegentFileReader& reader) { CountRecords(reader, records[i]); });
+        loader.load();
+        benchmark::DoNotOptimize(records.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * tables.size()));
+}
+BENCHMARK(BM_LoadTables)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->ArgName("workers")->UseRealTime();
+
+/// per policy lookups: a small file opened, read and closed over and over - a new reader each time, the same reader
+/// reopened, or a new reader with its buffers from a pool
+enum class Reuse { None, Reopen, Pool };
+
+template <Reuse reuse>
+void BM_OpenSmallFile(benchmark::State& state)
+{
+    const auto& tables = SmallTables();
+    const uint32_t read_size = static_cast<uint32_t>(state.range(0));
+    BufferPool pool;
+    ElegentFileReader reopened(read_size, '\t');
+    size_t next = 0;
+    size_t records = 0;
+    for (auto _ : state) {
+        if (Reuse::Reopen == reuse) {
+            reopened.reopen(tables[next].c_str());
+            CountRecords(reopened, records);
+        } else {
+            ElegentFileReader reader(read_size, '\t');
+            if (Reuse::Pool == reuse)
+                reader.setBufferPool(&pool);
+            reader.open(tables[next].c_str());
+            CountRecords(reader, records);
+        }
+        next = next + 1 < tables.size() ? next + 1 : 0;
+    }
+    benchmark::DoNotOptimize(records);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK_TEMPLATE(BM_OpenSmallFile, Reuse::None)->Arg(64 << 10)->Arg(1 << 20)->ArgName("read_size");
+BENCHMARK_TEMPLATE(BM_OpenSmallFile, Reuse::Reopen)->Arg(64 << 10)->Arg(1 << 20)->ArgName("read_size");
+BENCHMARK_TEMPLATE(BM_OpenSmallFile, Reuse::Pool)->Arg(64 << 10)->Arg(1 << 20)->ArgName("read_size");
+
+/// an estimate of the records instead of counting them: compare with BM_Read<CashFlows, CrLf, true>
+void BM_EstimateStats(benchmark::State& state)
+{
+    const SyntheticFile& file = GetFile(Shape::CashFlows, Eol::CrLf);
+    ElegentFileReader reader(64_Kb, ',');
+    reader.open(file.path_.c_str());
+    uint64_t seed = 0;
+    double error = 0;
+    for (auto _ : state) {
+        const FileEstimate estimate = EstimateStats(reader, static_cast<size_t>(state.range(0)), true, seed++);
+        error += std::abs(double(estimate.records_) - double(file.records_ - 1)) / double(file.records_ - 1);
+    }
+    state.counters["error"] = benchmark::Counter(error / double(state.iterations()));
+}
+BENCHMARK(BM_EstimateStats)->Arg(16)->Arg(256)->Arg(4096)->ArgName("k");
+
+/// the rows of one table, and of one sex: filtered by the reader on the raw bytes, or by the caller on every record
+enum class Filter { InCaller, InReader };
+enum class Rows { OneTable, Female };
+
+template <Filter filter, Rows rows>
+void BM_Filter(benchmark::State& state)
+{
+    const SyntheticFile& file = GetFile(Shape::Meritz, Eol::CrLf);
+    const size_t field = rows == Rows::OneTable ? 0 : 5;
+    const std::string value = rows == Rows::OneTable ? std::to_string(1111111 + meritz_rows / 4) : "FEMALE";
+    ElegentFileReader reader(static_cast<uint32_t>(state.range(0)), '\t');
+    if (filter == Filter::InReader)
+        reader.whereEquals(field, value);
+    reader.open(file.path_.c_str());
+    size_t matches = 0;
+    for (auto _ : state) {
+        reader.seek(0);
+        matches = 0;
+        while (!reader.isEOF()) {
+            const auto& record = reader.readRecord();
+            matches += record.size() > field && value == record[field];
+        }
+    }
+    SetRates(state, file);
+    state.counters["matches"] = benchmark::Counter(double(matches));
+}
+BENCHMARK_TEMPLATE(BM_Filter, Filter::InCaller, Rows::OneTable)->Arg(64 << 10)->Arg(1 << 20)->ArgName("read_size");
+BENCHMARK_TEMPLATE(BM_Filter, Filter::InReader, Rows::OneTable)->Arg(64 << 10)->Arg(1 << 20)->ArgName("read_size");
+BENCHMARK_TEMPLATE(BM_Filter, Filter::InCaller, Rows::Female)->Arg(64 << 10)->Arg(1 << 20)->ArgName("read_size");
+BENCHMARK_TEMPLATE(BM_Filter, Filter::InReader, Rows::Female)->Arg(64 << 10)->Arg(1 << 20)->ArgName("read_size");
+
+/// writing the cash flows out (64 keys x 1201 months x 20 doubles, CRLF): with ofstream <<, as the outputs are written
+/// now (at its default 6 digits, and at the 17 that read back the same), or with ElegentFileWriter
+enum class Writer { Ofstream, Ofstream17, Elegent, ElegentBehind };
+
+template <Writer writer>
+void BM_WriteCashFlows(benchmark::State& state)
+{
+    const std::string path = (std::filesystem::temp_directory_path() / "efr_bench_write.csv").string();
+    std::vector<double> cash_flows(20 * months);
+    Random random;
+    for (auto& cash_flow : cash_flows)
+        cash_flow = (random.rate() - 0.5) * 20000;
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        if (writer == Writer::Ofstream || writer == Writer::Ofstream17) {
+            std::ofstream file(path, std::ios::binary);
+            if (writer == Writer::Ofstream17)
+                file << std::setprecision(17);
+            for (size_t k = 0; k < cash_flow_keys; ++k)
+                for (size_t t = 0; t < months; ++t) {
+                    file << "1,0,batch" << k % 8 << "|ANN_" << 4750 + k << ',' << t;
+                    for (size_t i = 0; i < 20; ++i)
+                        file << ',' << cash_flows[t * 20 + i];
+                    file << "\r\n";
+                }
+            bytes = file.tellp();
+        } else {
+            ElegentFileWriter file(static_cast<uint32_t>(1024_Kb), ',', ElegentFileWriter::LineEnd::CrLf, false,
+                                   writer == Writer::ElegentBehind);
+            file.open(path.c_str());
+            for (size_t k = 0; k < cash_flow_keys; ++k) {
+                const std::string key = "batch" + std::to_string(k % 8) + "|ANN_" + std::to_string(4750 + k);
+                for (size_t t = 0; t < months; ++t) {
+                    file.field(1);
+                    file.field(0);
+                    file.field(key);
+                    file.field(t);
+                    for (size_t i = 0; i < 20; ++i)
+                        file.field(cash_flows[t * 20 + i]);
+                    file.endRecord();
+                }
+            }
+            bytes = file.bytesWritten();
+            file.close();
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * cash_flow_keys * months));
+}
+BENCHMARK_TEMPLATE(BM_WriteCashFlows, Writer::Ofstream)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_WriteCashFlows, Writer::Ofstream17)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_WriteCashFlows, Writer::Elegent)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_WriteCashFlows, Writer::ElegentBehind)->UseRealTime();
+
+/// the cash flows sorted by CF1 (field 4, random): by SortFile in a budget (256 MB: in memory; less: runs spilled and
+/// merged), and the way it's done without it - every line in a std::string, a stable_sort and an ofstream
+void BM_SortFile(benchmark::State& state)
+{
+    const SyntheticFile& file = GetFile(Shape::CashFlows, Eol::CrLf);
+    const std::string output = (std::filesystem::temp_directory_path() / "efr_bench_sorted.csv").string();
+    score::SortOptions options;
+    options.keys_ = {4};
+    options.delimiter_ = ',';
+    options.memory_budget_ = static_cast<uint64_t>(state.range(0)) << 20;
+    score::SortStats stats;
+    for (auto _ : state)
+        stats = score::SortFile(file.path_.c_str(), output.c_str(), options);
+    SetRates(state, file);
+    state.counters["runs"] = benchmark::Counter(double(stats.runs_));
+}
+BENCHMARK(BM_SortFile)->Arg(4)->Arg(16)->Arg(256)->ArgName("budget_mb")->UseRealTime();
+
+void BM_SortFile_Strings(benchmark::State& state)
+{
+    const SyntheticFile& file = GetFile(Shape::CashFlows, Eol::CrLf);
+    const std::string output = (std::filesystem::temp_directory_path() / "efr_bench_sorted.csv").string();
+    const auto key = [](const std::string& line) {
+        size_t begin = 0;
+        for (int field = 0; field < 4; ++field)
+            begin = line.find(',', begin) + 1;
+        return std::string_view(line).substr(begin, line.find(',', begin) - begin);
+    };
+    for (auto _ : state) {
+        std::ifstream in(file.path_, std::ios::binary);
+        std::string header;
+        std::getline(in, header);
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(in, line);)
+            lines.push_back(std::move(line));
+        std::stable_sort(lines.begin(), lines.end(), [&](const std::string& a, const std::string& b) { return key(a) < key(b); });
+        std::ofstream out(output, std::ios::binary);
+        out << header << '\n';
+        for (const auto& line : lines)
+            out << line << '\n';
+    }
+    SetRates(state, file);
+}
+BENCHMARK(BM_SortFile_Strings)->UseRealTime();
+
+/// a product code table (OriginalProdCode -> ProdCode, IsVA), in memory, and an inforce file of 200k policies
+/// with codes from it at random (1 in 10 not in it)
+const size_t policies = 200000;
+
+const std::string& ProductTable(const size_t products)
+{
+    static std::map<size_t, std::string> tables;
+    std::string& table = tables[products];
+    if (table.empty())
+        for (size_t product = 0; product < products; ++product)
+            table += "C" + std::to_string(product * 7919) + "\tnote\tPROD" + std::to_string(product % 97) + "\t"
+                + (product % 5 ? "N" : "Y") + "\r\n";
+    return table;
+}
+
+const SyntheticFile& InforceFile(const size_t products)
+{
+    static std::map<size_t, SyntheticFile> files;
+    SyntheticFile& info = files[products];
+    if (!info.path_.empty())
+        return info;
+    info.path_ = (std::filesystem::temp_directory_path() / ("efr_bench_inforce" + std::to_string(products) + ".tbl")).string();
+    {
+        std::ofstream file(info.path_, std::ios::binary);
+        Random random;
+        for (size_t policy = 0; policy < policies; ++policy) {
+            const size_t product = random.next() % (products + products / 9);
+            file << "POL" << policy << "\tC" << product * 7919 << "\t" << random.next() % 100000 << "\t1\t0\t35\tM\r\n";
+        }
+    }
+    info.bytes_ = std::filesystem::file_size(info.path_);
+    info.records_ = policies;
+    return info;
+}
+
+/// the join the old way: a record at a time through a map of strings
+void BM_JoinProducts_StringMap(benchmark::State& state)
+{
+    const size_t products = static_cast<size_t>(state.range(0));
+    std::unordered_map<std::string, std::pair<std::string, std::string>> map;
+    ElegentFileReader small(64_Kb, '\t');
+    small.open(std::make_unique<MemorySource>(ProductTable(products).data(), ProductTable(products).size()));
+    while (!small.isEOF()) {
+        const auto& record = small.readRecord();
+        if (record.size() == 4)
+            map.emplace(record[0], std::make_pair(record[2], record[3]));
+    }
+    const SyntheticFile& file = InforceFile(products);
+    ElegentFileReader large(64_Kb, '\t');
+    large.open(file.path_.c_str());
+    for (auto _ : state) {
+        large.seek(0);
+        size_t joined = 0;
+        while (!large.isEOF()) {
+            const auto& record = large.readRecord();
+            if (record.size() < 2)
+                continue;
+            const auto product = map.find(record[1]);
+            if (product != map.end())
+                joined += product->second.second[0] == 'Y';
+        }
+        benchmark::DoNotOptimize(joined);
+    }
+    SetRates(state, file);
+}
+BENCHMARK(BM_JoinProducts_StringMap)->Arg(4000)->Arg(1000000)->ArgName("products");
+
+template <size_t batch>
+void BM_JoinProducts(benchmark::State& state)
+{
+    const size_t products = static_cast<size_t>(state.range(0));
+    score::HashJoin join(batch);
+    ElegentFileReader small(64_Kb, '\t');
+    small.open(std::make_unique<MemorySource>(ProductTable(products).data(), ProductTable(products).size()));
+    join.build(small, 0, {2, 3});
+    const SyntheticFile& file = InforceFile(products);
+    ElegentFileReader large(64_Kb, '\t');
+    large.open(file.path_.c_str());
+    for (auto _ : state) {
+        large.seek(0);
+        size_t joined = 0;
+        join.probe(large, 1, [&](const ElegentFileReader::Record&, const char* const* product) { joined += product[1][0] == 'Y'; });
+        benchmark::DoNotOptimize(joined);
+    }
+    SetRates(state, file);
+}
+BENCHMARK_TEMPLATE(BM_JoinProducts, 1)->Arg(4000)->Arg(1000000)->ArgName("products");
+BENCHMARK_TEMPLATE(BM_JoinProducts, 16)->Arg(4000)->Arg(1000000)->ArgName("products");
+
+/// the last rows of a big file: read backwards, instead of skipping through it (BM_Read<CashFlows, CrLf, true>)
+void BM_Tail(benchmark::State& state)
+{
+    const SyntheticFile& file = GetFile(Shape::CashFlows, Eol::CrLf);
+    ElegentFileReader reader(64_Kb, ',');
+    reader.open(file.path_.c_str());
+    for (auto _ : state)
+        benchmark::DoNotOptimize(reader.tail(static_cast<size_t>(state.range(0))).data());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * state.range(0)));
+}
+BENCHMARK(BM_Tail)->Arg(1)->Arg(100)->Arg(10000)->ArgName("n");
+
+void BM_CreateIndex(benchmark::State& state)
+{
+    const SyntheticFile& file = GetFile(Shape::CashFlows, Eol::CrLf);
+    ElegentFileReader reader(static_cast<uint32_t>(state.range(0)), ',', false, 4);
+    reader.open(file.path_.c_str());
+    for (auto _ : state) {
+        CSVFileIndex index;
+        index.createIndex(reader, 2);
+        benchmark::DoNotOptimize(index.find(file.keys_.front()).record_count_);
+    }
+    SetRates(state, file);
+}
+BENCHMARK(BM_CreateIndex)->Apply(ReadSizes);
+
+void BM_Find(benchmark::State& state)
+{
+    const SyntheticFile& file = GetFile(Shape::CashFlows, Eol::CrLf);
+    ElegentFileReader reader(64_Kb, ',', false, 4);
+    reader.open(file.path_.c_str());
+    CSVFileIndex index;
+    index.createIndex(reader, 2);
+
+    size_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(index.find(file.keys_[next]).begin_offset_);
+        next = next + 1 < file.keys_.size() ? next + 1 : 0;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_Find);
+}
@@ -0,0 +1,4 @@
+#include "pch.h"
+
+// Run with --benchmark_filter=<regex> to pick benchmarks; --benchmark_format=csv for a spreadsheet
+BENCHMARK_MAIN();
@@ -0,0 +1,97 @@
+#include "pch.h"
+
+#include "BufferPool.h"
+
+#include <new>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+size_t RoundUp(const size_t bytes, const size_t multiple)
+{
+    return (bytes + multiple - 1) / multiple * multiple;
+}
+}
+
+void* HugePageResource::do_allocate(const size_t bytes, const size_t alignment)
+{
+    if (bytes < huge_page_size)
+        return upstream_->allocate(bytes, alignment);
+
+#if defined(_WIN32)
+    const size_t large_page = ::GetLargePageMinimum();
+    void* p = large_page ? ::VirtualAlloc(nullptr, RoundUp(bytes, large_page), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE)
+                         : nullptr;
+    if (!p)
+        p = ::VirtualAlloc(nullptr, RoundUp(bytes, huge_page_size), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+#else
+    const size_t size = RoundUp(bytes, huge_page_size);
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (MAP_FAILED == p) {
+        p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == p)
+            throw std::bad_alloc();
+        ::madvise(p, size, MADV_HUGEPAGE);
+    }
+    return p;
+#endif
+}
+
+void HugePageResource::do_deallocate(void* const p, const size_t bytes, const size_t alignment)
+{
+    if (bytes < huge_page_size)
+        return upstream_->deallocate(p, bytes, alignment);
+
+#if defined(_WIN32)
+    ::VirtualFree(p, 0, MEM_RELEASE);
+#else
+    ::munmap(p, RoundUp(bytes, huge_page_size));
+#endif
+}
+
+BufferPool::BufferPool(std::pmr::memory_resource* const resource, const size_t max_buffers)
+    : resource_(resource),
+      max_buffers_(max_buffers)
+{ }
+
+BufferPool::Buffers __vectorcall BufferPool::take()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            Buffers buffers = std::move(free_.back());
+            free_.pop_back();
+            ++reused_;
+            return buffers;
+        }
+    }
+    return Buffers{Buffer(ResourceAllocator<char>(resource_)), Record()};
+}
+
+void __vectorcall BufferPool::give(Buffers&& buffers)
+{
+    buffers.buffer_.clear();
+    buffers.record_.clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_.size() < max_buffers_)
+        free_.push_back(std::move(buffers));
+}
+
+size_t BufferPool::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return free_.size();
+}
+
+uint64_t BufferPool::reused() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return reused_;
+}
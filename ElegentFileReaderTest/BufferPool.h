@@ -0,0 +1,129 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// An allocator for a std::pmr::memory_resource that goes along with the memory when a container is moved or swapped
+/// (std::pmr::polymorphic_allocator stays put, and copies), so a buffer can be handed from a pool to a reader and back.
+template <class T>
+class ResourceAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ResourceAllocator(std::pmr::memory_resource* const resource = std::pmr::new_delete_resource()) noexcept
+        : resource_(resource)
+    { }
+    template <class U>
+    ResourceAllocator(const ResourceAllocator<U>& other) noexcept
+        : resource_(other.resource())
+    { }
+
+    T* allocate(const size_t n)
+    {
+        return static_cast<T*>(resource_->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* const p, const size_t n)
+    {
+        resource_->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    /// default-initialized, not zeroed: resize() before a read doesn't write over the whole block the read then fills
+    template <class U>
+    void construct(U* const p) noexcept(std::is_nothrow_default_constructible<U>::value)
+    {
+        ::new (static_cast<void*>(p)) U;
+    }
+    template <class U, class... Args>
+    void construct(U* const p, Args&&... args)
+    {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+
+    std::pmr::memory_resource* resource() const
+    {
+        return resource_;
+    }
+
+    template <class U>
+    bool operator==(const ResourceAllocator<U>& other) const
+    {
+        return resource_ == other.resource();
+    }
+    template <class U>
+    bool operator!=(const ResourceAllocator<U>& other) const
+    {
+        return resource_ != other.resource();
+    }
+
+private:
+    std::pmr::memory_resource* resource_;
+};
+
+/// Allocations of huge_page_size and up in huge pages, where the os gives them: fewer page faults and TLB misses for
+/// a read_size in MB. Smaller ones come from upstream.
+///     Linux:   explicit huge pages (hugetlbfs) if some are reserved, if not transparent huge pages (madvise)
+///     Windows: large pages need the "Lock pages in memory" privilege; without it, ordinary pages
+class HugePageResource : public std::pmr::memory_resource {
+public:
+    static const size_t huge_page_size = 2 * 1024 * 1024;
+
+    explicit HugePageResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : upstream_(upstream)
+    { }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* const upstream_;
+};
+
+/// Buffers for readers to share: a reader opening a file takes its buffers from the pool, and closing it gives them
+/// back with their capacity, so the next reader (or the next small file) starts with memory already allocated and
+/// touched. Thread safe; it must outlive the readers using it (see ElegentFileReader::setBufferPool()).
+class BufferPool {
+public:
+    using Buffer = std::vector<char, ResourceAllocator<char>>;
+    using Record = std::vector<const char*>;
+
+    /// what a reader uses: the file block(s), and the field pointers into them
+    struct Buffers {
+        Buffer buffer_;
+        Record record_;
+    };
+
+    /// new buffers come from resource (e.g. a HugePageResource), which must outlive the pool;
+    /// up to max_buffers given back are kept, the rest freed
+    explicit BufferPool(std::pmr::memory_resource* resource = std::pmr::new_delete_resource(), size_t max_buffers = 64);
+
+    /// ones given back if there are any, otherwise new (empty) ones
+    Buffers __vectorcall take();
+    /// emptied, and kept for the next take() if there is room
+    void __vectorcall give(Buffers&&);
+
+    /// kept for the next take()
+    size_t size() const;
+    /// take()s that got buffers given back
+    uint64_t reused() const;
+
+private:
+    std::pmr::memory_resource* const resource_;
+    const size_t max_buffers_;
+
+    mutable std::mutex mutex_;
+    std::vector<Buffers> free_;
+    uint64_t reused_ = 0;
+};
@@ -3,45 +3,55 @@
 #include "CSVFileIndex.h"
 #include "ElegentFileReader.h"
 #include "Ensure.h"
+#include "Trace.h"
 
 void __vectorcall CSVFileIndex::createIndex(ElegentFileReader& reader, const size_t key_field_index)
 {
+    trace::Span span("createIndex");
     reader.seek(0);
     if (reader.isEOF())
         return;
 
     // skip the header row
     reader.skipRecord();
-    if (reader.isEOF())
-        return;
 
+    // bad rows go to the reader's error policy: a row without the key is left out,
+    // and so is the whole block of a key seen before (the records for a key must be together)
     FileBlockInfo file_block;
-    file_block.begin_offset_ = reader.ftell();
-    auto file_record = reader.readRecord();
-    file_block.end_offset_ = reader.ftell();
-    file_block.record_count_ = 1;
-    std::string current_key = file_record[key_field_index];
-
+    std::string current_key;
+    bool duplicate = false;
     while (!reader.isEOF()) {
-        file_record = reader.readRecord();
+        const auto& file_record = reader.readRecord();
+        if (file_record.size() <= key_field_index) {
+            if (!file_record.empty()) // empty: readRecord() skipped bad rows to the end of the file
+                reader.badRecord(ParseError::Kind::MissingField, key_field_index);
+            continue;
+        }
+
         const char* key = file_record[key_field_index];
-        if (strcmp(key, current_key.c_str()) == 0) {
+        if (file_block.record_count_ && strcmp(key, current_key.c_str()) == 0) {
             file_block.end_offset_ = reader.ftell();
             ++file_block.record_count_;
             continue;
         }
 
         // store the catalogue entry
-        ENSURE(catalogue_.emplace(current_key, file_block).second);
+        if (file_block.record_count_ && !duplicate)
+            catalogue_.emplace(current_key, file_block);
 
         // reset for next entry
-        file_block.begin_offset_ = file_block.end_offset_; // end of previous block is the start of the next block
+        current_key = key;
+        duplicate = catalogue_.count(current_key) != 0;
+        if (duplicate)
+            reader.badRecord(ParseError::Kind::DuplicateKey, key_field_index);
+        file_block.begin_offset_ = reader.recordOffset();
         file_block.end_offset_ = reader.ftell();
         file_block.record_count_ = 1;
-        current_key = key;
     }
 
-    ENSURE(catalogue_.emplace(current_key, file_block).second);
+    if (file_block.record_count_ && !duplicate)
+        catalogue_.emplace(current_key, file_block);
+    span.arg("keys", catalogue_.size());
 }
 
 namespace {
@@ -53,3 +63,13 @@ const CSVFileIndex::FileBlockInfo& __vectorcall CSVFileIndex::find(const std::st
     const auto iter = catalogue_.find(key);
     return iter == catalogue_.end() ? not_found : iter->second;
 }
+
+void __vectorcall CSVFileIndex::find(const std::vector<std::string>& keys, std::vector<FileBlockInfo>& blocks)
+{
+    trace::Span span("find");
+    span.arg("keys", keys.size());
+    blocks.clear();
+    blocks.reserve(keys.size());
+    for (const auto& key : keys)
+        blocks.push_back(find(key));
+}
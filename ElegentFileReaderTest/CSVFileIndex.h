@@ -1,6 +1,7 @@
 #pragma once
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 class ElegentFileReader;
 
@@ -14,6 +15,8 @@ public:
 
     void __vectorcall createIndex(ElegentFileReader&, const size_t);
     const FileBlockInfo& __vectorcall find(const std::string& key);
+    /// find for a batch of keys: blocks[i] for keys[i]; traced as one span (a span per find would cost more than the find)
+    void __vectorcall find(const std::vector<std::string>& keys, std::vector<FileBlockInfo>& blocks);
 
 private:
     std::unordered_map<std::string, const FileBlockInfo> catalogue_;
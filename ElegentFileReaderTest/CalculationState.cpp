@@ -0,0 +1,568 @@
+#include "pch.h"
+
+#include "CalculationState.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace score {
+namespace detail {
+namespace {
+
+void ScalarFill(uint64_t* values, size_t size, const uint64_t pattern)
+{
+    for (size_t i = 0; i < size; ++i)
+        values[i] = pattern;
+}
+
+/// scalar stores up to the alignment, for aligned (and streaming) vector stores
+/// returns the number of values done
+size_t AlignTo(uint64_t* values, const size_t size, const size_t alignment, const uint64_t pattern)
+{
+    const size_t misalignment = reinterpret_cast<uintptr_t>(values) & (alignment - 1);
+    const size_t head = misalignment ? (alignment - misalignment) / sizeof(uint64_t) : 0;
+    const size_t count = head < size ? head : size;
+    ScalarFill(values, count, pattern);
+    return count;
+}
+
+SCORE_TARGET("avx2")
+void Avx2Fill(uint64_t* values, size_t size, const uint64_t pattern, const bool non_temporal)
+{
+    const size_t head = AlignTo(values, size, sizeof(__m256i), pattern);
+    values += head;
+    size -= head;
+
+    const __m256i broadcast = _mm256_set1_epi64x(static_cast<long long>(pattern));
+    const size_t per_store = sizeof(__m256i) / sizeof(uint64_t);
+    const size_t per_loop = 4 * per_store;
+    size_t i = 0;
+    if (non_temporal) {
+        for (; i + per_loop <= size; i += per_loop) {
+            __m256i* const p = reinterpret_cast<__m256i*>(values + i);
+            _mm256_stream_si256(p, broadcast);
+            _mm256_stream_si256(p + 1, broadcast);
+            _mm256_stream_si256(p + 2, broadcast);
+            _mm256_stream_si256(p + 3, broadcast);
+        }
+        _mm_sfence(); // streaming stores are weakly ordered
+    } else {
+        for (; i + per_loop <= size; i += per_loop) {
+            __m256i* const p = reinterpret_cast<__m256i*>(values + i);
+            _mm256_store_si256(p, broadcast);
+            _mm256_store_si256(p + 1, broadcast);
+            _mm256_store_si256(p + 2, broadcast);
+            _mm256_store_si256(p + 3, broadcast);
+        }
+    }
+    for (; i + per_store <= size; i += per_store)
+        _mm256_store_si256(reinterpret_cast<__m256i*>(values + i), broadcast);
+    ScalarFill(values + i, size - i, pattern);
+}
+
+SCORE_TARGET("avx512f")
+void Avx512Fill(uint64_t* values, size_t size, const uint64_t pattern, const bool non_temporal)
+{
+    const size_t head = AlignTo(values, size, sizeof(__m512i), pattern);
+    values += head;
+    size -= head;
+
+    const __m512i broadcast = _mm512_set1_epi64(static_cast<long long>(pattern));
+    const size_t per_store = sizeof(__m512i) / sizeof(uint64_t);
+    const size_t per_loop = 4 * per_store;
+    size_t i = 0;
+    if (non_temporal) {
+        for (; i + per_loop <= size; i += per_loop) {
+            __m512i* const p = reinterpret_cast<__m512i*>(values + i);
+            _mm512_stream_si512(p, broadcast);
+            _mm512_stream_si512(p + 1, broadcast);
+            _mm512_stream_si512(p + 2, broadcast);
+            _mm512_stream_si512(p + 3, broadcast);
+        }
+        _mm_sfence();
+    } else {
+        for (; i + per_loop <= size; i += per_loop) {
+            __m512i* const p = reinterpret_cast<__m512i*>(values + i);
+            _mm512_store_si512(p, broadcast);
+            _mm512_store_si512(p + 1, broadcast);
+            _mm512_store_si512(p + 2, broadcast);
+            _mm512_store_si512(p + 3, broadcast);
+        }
+    }
+    // the tail: a masked store rather than up to 31 scalar ones
+    for (; i + per_store <= size; i += per_store)
+        _mm512_store_si512(values + i, broadcast);
+    if (i < size)
+        _mm512_mask_storeu_epi64(values + i, static_cast<__mmask8>((1u << (size - i)) - 1), broadcast);
+}
+
+/// NotCalculatedSaturn and Busy differ only in bit 1: or-ing it in catches both with one compare
+const uint32_t saturn_or_busy_bit = NotCalculatedSaturn ^ Busy;
+static_assert((NotCalculatedSaturn | saturn_or_busy_bit) == Busy && (NoAvg | saturn_or_busy_bit) != Busy, "the states have moved");
+
+bool IsUncalculated(const double& value)
+{
+    const CalculationState state = DoubleState::get_state(value);
+    return NotCalculated == state || (state | saturn_or_busy_bit) == Busy;
+}
+
+unsigned long LowestBit(const uint64_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return index;
+#else
+    return static_cast<unsigned long>(__builtin_ctzll(mask));
+#endif
+}
+
+void ScalarCount(const double* values, const size_t size, StateCounts& counts)
+{
+    for (size_t i = 0; i < size; ++i) {
+        switch (DoubleState::get_state(values[i])) {
+        case NotCalculated:
+            ++counts.not_calculated_;
+            break;
+        case NotCalculatedSaturn:
+            ++counts.not_calculated_saturn_;
+            break;
+        case NoAvg:
+            ++counts.no_avg_;
+            break;
+        case Busy:
+            ++counts.busy_;
+            break;
+        default:
+            ++counts.calculated_;
+        }
+    }
+}
+
+size_t ScalarFindFirstUncalculated(const double* values, const size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+        if (IsUncalculated(values[i]))
+            return i;
+    return size;
+}
+
+/// the bits from bit on, for values up to size
+void ScalarCalculatedMask(const double* values, const size_t size, uint64_t* mask, size_t bit)
+{
+    for (size_t i = 0; i < size; ++i, ++bit) {
+        if (0 == bit % 64)
+            mask[bit / 64] = 0;
+        if (!IsUncalculated(values[i]))
+            mask[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+}
+
+/// the high dwords (where get_state() looks), in the low half of each 64 bit lane
+SCORE_TARGET("avx2")
+__m256i Avx2HighDwords(const double* values)
+{
+    return _mm256_srli_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values)), 32);
+}
+
+/// 4 bits, set for the uncalculated values
+SCORE_TARGET("avx2")
+unsigned Avx2Uncalculated(const double* values)
+{
+    const __m256i high = Avx2HighDwords(values);
+    const __m256i uncalculated = _mm256_or_si256(
+        _mm256_cmpeq_epi64(high, _mm256_set1_epi64x(NotCalculated)),
+        _mm256_cmpeq_epi64(_mm256_or_si256(high, _mm256_set1_epi64x(saturn_or_busy_bit)), _mm256_set1_epi64x(Busy)));
+    return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(uncalculated)));
+}
+
+SCORE_TARGET("avx2")
+uint64_t Avx2Sum(const __m256i v)
+{
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), v);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+SCORE_TARGET("avx2")
+StateCounts Avx2Count(const double* values, const size_t size)
+{
+    // a compare gives -1 per match: subtract to count
+    __m256i not_calculated = _mm256_setzero_si256();
+    __m256i saturn = _mm256_setzero_si256();
+    __m256i no_avg = _mm256_setzero_si256();
+    __m256i busy = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        const __m256i high = Avx2HighDwords(values + i);
+        not_calculated = _mm256_sub_epi64(not_calculated, _mm256_cmpeq_epi64(high, _mm256_set1_epi64x(NotCalculated)));
+        saturn = _mm256_sub_epi64(saturn, _mm256_cmpeq_epi64(high, _mm256_set1_epi64x(NotCalculatedSaturn)));
+        no_avg = _mm256_sub_epi64(no_avg, _mm256_cmpeq_epi64(high, _mm256_set1_epi64x(NoAvg)));
+        busy = _mm256_sub_epi64(busy, _mm256_cmpeq_epi64(high, _mm256_set1_epi64x(Busy)));
+    }
+
+    StateCounts counts;
+    counts.not_calculated_ = static_cast<size_t>(Avx2Sum(not_calculated));
+    counts.not_calculated_saturn_ = static_cast<size_t>(Avx2Sum(saturn));
+    counts.no_avg_ = static_cast<size_t>(Avx2Sum(no_avg));
+    counts.busy_ = static_cast<size_t>(Avx2Sum(busy));
+    counts.calculated_ = i - counts.not_calculated_ - counts.not_calculated_saturn_ - counts.no_avg_ - counts.busy_;
+    ScalarCount(values + i, size - i, counts);
+    return counts;
+}
+
+SCORE_TARGET("avx2")
+size_t Avx2FindFirstUncalculated(const double* values, const size_t size)
+{
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) { // 2 vectors per branch
+        const unsigned uncalculated = Avx2Uncalculated(values + i) | Avx2Uncalculated(values + i + 4) << 4;
+        if (uncalculated)
+            return i + LowestBit(uncalculated);
+    }
+    return i + ScalarFindFirstUncalculated(values + i, size - i);
+}
+
+SCORE_TARGET("avx2")
+void Avx2CalculatedMask(const double* values, const size_t size, uint64_t* mask)
+{
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        uint64_t uncalculated = 0;
+        for (size_t j = 0; j < 64; j += 4)
+            uncalculated |= static_cast<uint64_t>(Avx2Uncalculated(values + i + j)) << j;
+        mask[i / 64] = ~uncalculated;
+    }
+    ScalarCalculatedMask(values + i, size - i, mask, i);
+}
+
+SCORE_TARGET("avx512f")
+__mmask8 Avx512Uncalculated(const double* values)
+{
+    const __m512i high = _mm512_srli_epi64(_mm512_loadu_si512(values), 32);
+    return static_cast<__mmask8>(
+        _mm512_cmpeq_epi64_mask(high, _mm512_set1_epi64(NotCalculated))
+        | _mm512_cmpeq_epi64_mask(_mm512_or_si512(high, _mm512_set1_epi64(saturn_or_busy_bit)), _mm512_set1_epi64(Busy)));
+}
+
+SCORE_TARGET("avx512f")
+StateCounts Avx512Count(const double* values, const size_t size)
+{
+    const __m512i one = _mm512_set1_epi64(1);
+    __m512i not_calculated = _mm512_setzero_si512();
+    __m512i saturn = _mm512_setzero_si512();
+    __m512i no_avg = _mm512_setzero_si512();
+    __m512i busy = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        const __m512i high = _mm512_srli_epi64(_mm512_loadu_si512(values + i), 32);
+        not_calculated = _mm512_mask_add_epi64(not_calculated, _mm512_cmpeq_epi64_mask(high, _mm512_set1_epi64(NotCalculated)), not_calculated, one);
+        saturn = _mm512_mask_add_epi64(saturn, _mm512_cmpeq_epi64_mask(high, _mm512_set1_epi64(NotCalculatedSaturn)), saturn, one);
+        no_avg = _mm512_mask_add_epi64(no_avg, _mm512_cmpeq_epi64_mask(high, _mm512_set1_epi64(NoAvg)), no_avg, one);
+        busy = _mm512_mask_add_epi64(busy, _mm512_cmpeq_epi64_mask(high, _mm512_set1_epi64(Busy)), busy, one);
+    }
+
+    StateCounts counts;
+    counts.not_calculated_ = static_cast<size_t>(_mm512_reduce_add_epi64(not_calculated));
+    counts.not_calculated_saturn_ = static_cast<size_t>(_mm512_reduce_add_epi64(saturn));
+    counts.no_avg_ = static_cast<size_t>(_mm512_reduce_add_epi64(no_avg));
+    counts.busy_ = static_cast<size_t>(_mm512_reduce_add_epi64(busy));
+    counts.calculated_ = i - counts.not_calculated_ - counts.not_calculated_saturn_ - counts.no_avg_ - counts.busy_;
+    ScalarCount(values + i, size - i, counts);
+    return counts;
+}
+
+SCORE_TARGET("avx512f")
+size_t Avx512FindFirstUncalculated(const double* values, const size_t size)
+{
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const unsigned uncalculated = Avx512Uncalculated(values + i) | static_cast<unsigned>(Avx512Uncalculated(values + i + 8)) << 8;
+        if (uncalculated)
+            return i + LowestBit(uncalculated);
+    }
+    return i + ScalarFindFirstUncalculated(values + i, size - i);
+}
+
+SCORE_TARGET("avx512f")
+void Avx512CalculatedMask(const double* values, const size_t size, uint64_t* mask)
+{
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        uint64_t uncalculated = 0;
+        for (size_t j = 0; j < 64; j += 8)
+            uncalculated |= static_cast<uint64_t>(Avx512Uncalculated(values + i + j)) << j;
+        mask[i / 64] = ~uncalculated;
+    }
+    ScalarCalculatedMask(values + i, size - i, mask, i);
+}
+
+/// the cpu has the instructions, and the os saves the registers
+bool CpuSupports(const Isa isa)
+{
+#if defined(_MSC_VER)
+    int registers[4];
+    __cpuid(registers, 0);
+    if (registers[0] < 7)
+        return false;
+    __cpuid(registers, 1);
+    const bool os_saves_avx = (registers[2] & (1 << 27)) != 0; // OSXSAVE
+    if (!os_saves_avx)
+        return false;
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(registers, 7, 0);
+    const unsigned ebx = static_cast<unsigned>(registers[1]);
+    switch (isa) {
+    case Isa::Avx2:
+        return (xcr0 & 0x6) == 0x6 && (ebx & (1u << 5)) != 0;
+    case Isa::Avx512:
+        return (xcr0 & 0xE6) == 0xE6 && (ebx & (1u << 16)) != 0;
+    default:
+        return true;
+    }
+#else
+    __builtin_cpu_init();
+    switch (isa) {
+    case Isa::Avx2:
+        return __builtin_cpu_supports("avx2");
+    case Isa::Avx512:
+        return __builtin_cpu_supports("avx512f");
+    default:
+        return true;
+    }
+#endif
+}
+}
+
+Isa SCORE_VECTORCALL best_isa()
+{
+    static const Isa best = CpuSupports(Isa::Avx512) ? Isa::Avx512
+        : CpuSupports(Isa::Avx2) ? Isa::Avx2
+        : Isa::Scalar;
+    return best;
+}
+
+bool SCORE_VECTORCALL is_supported(const Isa isa)
+{
+    return CpuSupports(isa);
+}
+
+void SCORE_VECTORCALL fill_pattern(const Isa isa, uint64_t* const values, const size_t size, const uint64_t pattern, const bool non_temporal)
+{
+    switch (isa) {
+    case Isa::Avx512:
+        Avx512Fill(values, size, pattern, non_temporal);
+        break;
+    case Isa::Avx2:
+        Avx2Fill(values, size, pattern, non_temporal);
+        break;
+    default:
+        ScalarFill(values, size, pattern);
+    }
+}
+
+void SCORE_VECTORCALL fill_pattern(uint64_t* const values, const size_t size, const uint64_t pattern)
+{
+    fill_pattern(best_isa(), values, size, pattern, size * sizeof(uint64_t) >= non_temporal_fill_bytes);
+}
+
+StateCounts SCORE_VECTORCALL count_states(const Isa isa, const double* const values, const size_t size)
+{
+    switch (isa) {
+    case Isa::Avx512:
+        return Avx512Count(values, size);
+    case Isa::Avx2:
+        return Avx2Count(values, size);
+    default: {
+        StateCounts counts;
+        ScalarCount(values, size, counts);
+        return counts;
+    }
+    }
+}
+
+size_t SCORE_VECTORCALL find_first_uncalculated(const Isa isa, const double* const values, const size_t size)
+{
+    switch (isa) {
+    case Isa::Avx512:
+        return Avx512FindFirstUncalculated(values, size);
+    case Isa::Avx2:
+        return Avx2FindFirstUncalculated(values, size);
+    default:
+        return ScalarFindFirstUncalculated(values, size);
+    }
+}
+
+void SCORE_VECTORCALL calculated_mask(const Isa isa, const double* const values, const size_t size, uint64_t* const mask)
+{
+    switch (isa) {
+    case Isa::Avx512:
+        Avx512CalculatedMask(values, size, mask);
+        break;
+    case Isa::Avx2:
+        Avx2CalculatedMask(values, size, mask);
+        break;
+    default:
+        ScalarCalculatedMask(values, size, mask, 0);
+    }
+}
+}
+
+BlockSummary::BlockSummary(const size_t size)
+    : size_(size)
+    , all_calculated_((blocks() + 63) / 64)
+    , all_not_calculated_((blocks() + 63) / 64)
+{
+}
+
+BlockSummary::BlockSummary(const double* const values, const size_t size)
+    : BlockSummary(size)
+{
+    rebuild(values);
+}
+
+void BlockSummary::set_block(const size_t block, const Block state)
+{
+    const uint64_t bit = uint64_t(1) << (block % 64);
+    uint64_t& calculated = all_calculated_[block / 64];
+    uint64_t& not_calculated = all_not_calculated_[block / 64];
+    calculated = state == AllCalculated ? calculated | bit : calculated & ~bit;
+    not_calculated = state == AllNotCalculated ? not_calculated | bit : not_calculated & ~bit;
+}
+
+void BlockSummary::set_all(const Block state)
+{
+    std::fill(all_calculated_.begin(), all_calculated_.end(), state == AllCalculated ? ~uint64_t(0) : 0);
+    std::fill(all_not_calculated_.begin(), all_not_calculated_.end(), state == AllNotCalculated ? ~uint64_t(0) : 0);
+}
+
+size_t BlockSummary::next_clear_bit(const std::vector<uint64_t>& bits, const size_t block) const
+{
+    // 64 blocks a word: this is what makes a check O(dirty blocks) rather than O(values)
+    for (size_t word = block / 64; word < bits.size(); ++word) {
+        uint64_t clear = ~bits[word];
+        if (word == block / 64)
+            clear &= ~uint64_t(0) << (block % 64);
+        if (clear) {
+            const size_t found = word * 64 + detail::LowestBit(clear);
+            return found < blocks() ? found : blocks();
+        }
+    }
+    return blocks();
+}
+
+void BlockSummary::refresh(const double* const values, const size_t block)
+{
+    const size_t length = block_length(block);
+    const detail::StateCounts counts = DoubleState::count_states(values + block * block_size, length);
+    if (counts.not_calculated_ == length)
+        set_block(block, AllNotCalculated);
+    else if (counts.calculated_ + counts.no_avg_ == length)
+        set_block(block, AllCalculated);
+    else
+        set_block(block, Mixed);
+}
+
+void BlockSummary::rebuild(const double* const values)
+{
+    for (size_t block = 0; block < blocks(); ++block)
+        refresh(values, block);
+}
+
+void BlockSummary::not_calculated(const size_t first, const size_t count)
+{
+    if (!count)
+        return;
+    const size_t end = first + count;
+    for (size_t block = first / block_size; block * block_size < end; ++block) {
+        const size_t block_first = block * block_size;
+        if (first <= block_first && block_first + block_length(block) <= end)
+            set_block(block, AllNotCalculated);
+        else if (this->block(block) == AllCalculated)
+            set_block(block, Mixed);
+    }
+}
+
+void BlockSummary::set_state(const size_t index, const CalculationState state)
+{
+    const size_t block = index / block_size;
+    switch (state) {
+    case NotCalculated:
+        if (this->block(block) == AllCalculated)
+            set_block(block, Mixed);
+        break;
+    case NoAvg: // counts as calculated
+        calculated(index);
+        break;
+    default:
+        set_block(block, Mixed);
+    }
+}
+
+void BlockSummary::calculated(const size_t index)
+{
+    const size_t block = index / block_size;
+    if (this->block(block) == AllNotCalculated)
+        set_block(block, Mixed);
+}
+
+namespace detail {
+void SCORE_VECTORCALL set_not_calculated(double* const values, BlockSummary& summary, const CalculationState state)
+{
+    if (state != NotCalculated) {
+        DoubleState::set_not_calculated(values, summary.size(), state);
+        summary.set_all(BlockSummary::Mixed);
+        return;
+    }
+
+    // the runs of blocks that need it, a fill each
+    const size_t blocks = summary.blocks();
+    for (size_t block = summary.next_block_to_reset(0); block < blocks;) {
+        size_t end = block + 1;
+        while (end < blocks && summary.block(end) != BlockSummary::AllNotCalculated)
+            ++end;
+        const size_t first = block * BlockSummary::block_size;
+        const size_t size = (end - 1) * BlockSummary::block_size + summary.block_length(end - 1) - first;
+        DoubleState::set_not_calculated(values + first, size, state);
+        summary.not_calculated(first, size);
+        block = end < blocks ? summary.next_block_to_reset(end) : blocks;
+    }
+}
+
+size_t SCORE_VECTORCALL find_first_uncalculated(const double* const values, BlockSummary& summary)
+{
+    for (size_t block = summary.next_dirty_block(0); block < summary.blocks(); block = summary.next_dirty_block(block + 1)) {
+        const size_t first = block * BlockSummary::block_size;
+        if (summary.block(block) == BlockSummary::AllNotCalculated)
+            return first;
+        const size_t length = summary.block_length(block);
+        const size_t found = DoubleState::find_first_uncalculated(values + first, length);
+        if (found < length)
+            return first + found;
+        summary.set_block(block, BlockSummary::AllCalculated);
+    }
+    return summary.size();
+}
+
+void SCORE_VECTORCALL set_not_calculated(WorkerPool& pool, double* const values, const size_t size, const CalculationState state)
+{
+    if (size * sizeof(double) < min_parallel_fill_bytes || pool.size() < 2) {
+        DoubleState::set_not_calculated(values, size, state);
+        return;
+    }
+
+    const uint64_t pattern = DoubleState::fill_pattern_of(state);
+    pool.run([&](const size_t worker) {
+        const WorkerPool::Range part = pool.partition(values, size, worker);
+        const size_t count = part.end_ - part.begin_;
+        fill_pattern(best_isa(), reinterpret_cast<uint64_t*>(values + part.begin_), count, pattern, count * sizeof(double) >= non_temporal_fill_bytes);
+    });
+}
+}
+}
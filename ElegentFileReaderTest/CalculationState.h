@@ -1,7 +1,23 @@
 #pragma once
 
-#include <intrin.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <vector>
+
+// CalculationState has to build with MSVC and with GCC/Clang (the Linux grid)
+#if defined(_MSC_VER)
+#define SCORE_FORCEINLINE __forceinline
+#define SCORE_VECTORCALL __vectorcall
+#define SCORE_TARGET(isa)
+#else
+#define SCORE_FORCEINLINE inline __attribute__((always_inline))
+#define SCORE_VECTORCALL
+#define SCORE_TARGET(isa) __attribute__((target(isa))) // MSVC lets any function use any instruction set
+#endif
+
+#if defined(_WIN64) || defined(__x86_64__)
+#define SCORE_64_BIT
+#endif
 
 namespace score {
 
@@ -15,6 +31,106 @@ enum CalculationState : uint32_t {
 };
 
 
+namespace detail {
+/// The instruction sets the bulk kernels below come in; the best the cpu (and os) support is picked once.
+enum class Isa { Scalar, Avx2, Avx512 };
+
+Isa SCORE_VECTORCALL best_isa();
+bool SCORE_VECTORCALL is_supported(Isa);
+
+/// Filling an array with a 64 bit pattern, for set_not_calculated().
+/// The vector kernels align to the vector size first and finish with a scalar tail;
+/// above non_temporal_fill_bytes they use streaming stores, so a reset of a big column doesn't evict the cache.
+const size_t non_temporal_fill_bytes = 16 * 1024 * 1024;
+
+/// fill with a specific kernel - for the tests and benchmarks; non_temporal is ignored by the scalar kernel
+void SCORE_VECTORCALL fill_pattern(Isa, uint64_t* values, size_t size, uint64_t pattern, bool non_temporal);
+
+/// fill with the best kernel, non-temporal above the threshold
+void SCORE_VECTORCALL fill_pattern(uint64_t* values, size_t size, uint64_t pattern);
+
+/// how many values of a column are in each state; anything that isn't a state (including NoAvg) is calculated
+struct StateCounts {
+	size_t calculated_ = 0;
+	size_t not_calculated_ = 0;
+	size_t not_calculated_saturn_ = 0;
+	size_t no_avg_ = 0;
+	size_t busy_ = 0;
+};
+
+/// Scans over columns, comparing the high dwords of the doubles a vector at a time (as get_state() does one at a time).
+/// Uncalculated means NotCalculated, NotCalculatedSaturn or Busy.
+StateCounts SCORE_VECTORCALL count_states(Isa, const double* values, size_t size);
+/// the index of the 1st uncalculated value; size if they are all calculated
+size_t SCORE_VECTORCALL find_first_uncalculated(Isa, const double* values, size_t size);
+/// bit i % 64 of mask[i / 64] is set if values[i] is calculated; mask has (size + 63) / 64 words, the unused bits are 0
+void SCORE_VECTORCALL calculated_mask(Isa, const double* values, size_t size, uint64_t* mask);
+}
+
+/// An optional side summary of a column: per block of 64 values, all calculated, all NotCalculated, or mixed (which
+/// includes don't know). Kept current by the DoubleState functions that take one, it lets dependency checks skip the
+/// calculated blocks and resets skip the blocks that are still NotCalculated, without touching the doubles.
+/// Writing a calculated value straight into the column has to be told: calculated(index).
+class BlockSummary {
+public:
+	static const size_t block_size = 64;
+	enum Block : uint8_t { Mixed, AllCalculated, AllNotCalculated };
+
+	/// every block Mixed until it's known better
+	explicit BlockSummary(size_t size = 0);
+	/// summarize a column as it is
+	BlockSummary(const double *values, size_t size);
+
+	size_t size() const { return size_; }
+	size_t blocks() const { return (size_ + block_size - 1) / block_size; }
+	/// the last block can be short
+	size_t block_length(size_t block) const {
+		const size_t first = block * block_size;
+		return size_ - first < block_size ? size_ - first : block_size;
+	}
+	Block block(size_t block) const {
+		return bit(all_calculated_, block) ? AllCalculated : bit(all_not_calculated_, block) ? AllNotCalculated : Mixed;
+	}
+	void set_block(size_t block, Block state);
+	void set_all(Block state);
+
+	/// the 1st block from block on that isn't AllCalculated / AllNotCalculated; blocks() if there's none
+	size_t next_dirty_block(size_t block) const { return next_clear_bit(all_calculated_, block); }
+	size_t next_block_to_reset(size_t block) const { return next_clear_bit(all_not_calculated_, block); }
+	bool is_all_calculated() const { return next_dirty_block(0) == blocks(); }
+
+	/// look at the values of a block again (a Mixed block may have become all calculated)
+	void refresh(const double *values, size_t block);
+	void rebuild(const double *values);
+
+	/// what has been stored in the column
+	void not_calculated(size_t first, size_t count);
+	void set_state(size_t index, CalculationState state);
+	void calculated(size_t index);
+
+private:
+	static bool bit(const std::vector<uint64_t>& bits, size_t block) {
+		return (bits[block / 64] >> (block % 64)) & 1;
+	}
+	size_t next_clear_bit(const std::vector<uint64_t>& bits, size_t block) const;
+
+	size_t size_;
+	std::vector<uint64_t> all_calculated_;
+	std::vector<uint64_t> all_not_calculated_;
+};
+
+class WorkerPool;
+
+namespace detail {
+/// the DoubleState functions that keep a BlockSummary
+void SCORE_VECTORCALL set_not_calculated(double* values, BlockSummary& summary, CalculationState state);
+size_t SCORE_VECTORCALL find_first_uncalculated(const double* values, BlockSummary& summary);
+
+/// Below this a reset isn't worth waking the workers for, and isn't big enough for its placement to matter
+const size_t min_parallel_fill_bytes = 4 * 1024 * 1024;
+void SCORE_VECTORCALL set_not_calculated(WorkerPool& pool, double* values, size_t size, CalculationState state);
+}
+
 /// CalculationState bit patterns stored in the 8 bytes of a double.
 /// When the bit pattrn is stored in a double it will have the representation of Nan.
 /// - This union relies on double being 8 bytes.
@@ -22,28 +138,69 @@ union DoubleState {
 public:
 	/// Fill the data with the NotCalculated CalculationState bit pattern.
 	/// The bit pattern goes to the high order dword for 64 bits and to both dwords for 32 bits.
-	static __forceinline void _vectorcall set_not_calculated(double *values, size_t size, CalculationState value) {
-#ifdef _WIN64
-		__stosq(
-			reinterpret_cast<unsigned long long*>(values),
-			DoubleState(value).as_uint64_state_in_high_dword(),
-			sizeof(double) / sizeof(uint64_t) * size);
-#else
-		__stosd(
-			reinterpret_cast<unsigned long*>(values),
-			value,
-			sizeof(double) / sizeof(uint32_t) * size);
-#endif // WIN64
+	/// Short arrays are done inline; longer ones by the widest stores the cpu has (see detail::fill_pattern).
+	static SCORE_FORCEINLINE void SCORE_VECTORCALL set_not_calculated(double *values, size_t size, CalculationState value) {
+		const uint64_t pattern = fill_pattern_of(value);
+		uint64_t* const data = reinterpret_cast<uint64_t*>(values);
+		if (size <= inline_fill_size) {
+			for (size_t i = 0; i < size; ++i)
+				data[i] = pattern;
+			return;
+		}
+		detail::fill_pattern(data, size, pattern);
 	}
-	static inline void _vectorcall set_not_calculated_score(double *values, size_t size) {
+	static inline void SCORE_VECTORCALL set_not_calculated_score(double *values, size_t size) {
 		set_not_calculated(values, size, CalculationState::NotCalculated);
 	}
-	static inline void _vectorcall set_not_calculated_saturn(double *values, size_t size) {
+	static inline void SCORE_VECTORCALL set_not_calculated_saturn(double *values, size_t size) {
 		set_not_calculated(values, size, CalculationState::NotCalculatedSaturn);
 	}
 
+	/// Bulk queries over a column, with the best instruction set the cpu has (see detail::count_states).
+	static detail::StateCounts SCORE_VECTORCALL count_states(const double *values, size_t size) {
+		return detail::count_states(detail::best_isa(), values, size);
+	}
+	static size_t SCORE_VECTORCALL find_first_uncalculated(const double *values, size_t size) {
+		return detail::find_first_uncalculated(detail::best_isa(), values, size);
+	}
+	static bool SCORE_VECTORCALL is_all_calculated(const double *values, size_t size) {
+		return find_first_uncalculated(values, size) == size;
+	}
+	static void SCORE_VECTORCALL calculated_mask(const double *values, size_t size, uint64_t *mask) {
+		detail::calculated_mask(detail::best_isa(), values, size, mask);
+	}
+
+	/// The same split over the workers of a pool, each filling pool.partition(worker) with the best kernel.
+	/// Fill an array that hasn't been touched yet (new double[], not a std::vector) with the pool that will compute on it,
+	/// and each page is first touched - so placed - on the NUMA node of the worker that uses it.
+	static void SCORE_VECTORCALL set_not_calculated_score(WorkerPool& pool, double *values, size_t size) {
+		detail::set_not_calculated(pool, values, size, CalculationState::NotCalculated);
+	}
+	static void SCORE_VECTORCALL set_not_calculated_saturn(WorkerPool& pool, double *values, size_t size) {
+		detail::set_not_calculated(pool, values, size, CalculationState::NotCalculatedSaturn);
+	}
+
+	/// The same over a column with a BlockSummary, keeping it current: a reset only writes the blocks that aren't
+	/// already all NotCalculated, a check only scans the blocks that aren't known to be calculated.
+	static void SCORE_VECTORCALL set_not_calculated(double *values, BlockSummary& summary, CalculationState value) {
+		detail::set_not_calculated(values, summary, value);
+	}
+	static void SCORE_VECTORCALL set_not_calculated_score(double *values, BlockSummary& summary) {
+		detail::set_not_calculated(values, summary, CalculationState::NotCalculated);
+	}
+	static void SCORE_VECTORCALL set_not_calculated_saturn(double *values, BlockSummary& summary) {
+		detail::set_not_calculated(values, summary, CalculationState::NotCalculatedSaturn);
+	}
+	/// a check can find a Mixed block all calculated: it's marked so for next time
+	static size_t SCORE_VECTORCALL find_first_uncalculated(const double *values, BlockSummary& summary) {
+		return detail::find_first_uncalculated(values, summary);
+	}
+	static bool SCORE_VECTORCALL is_all_calculated(const double *values, BlockSummary& summary) {
+		return find_first_uncalculated(values, summary) == summary.size();
+	}
+
 	/// Extract the CalculationState bit pattern from a double.
-	static const CalculationState _vectorcall get_state(const double& value) {
+	static const CalculationState SCORE_VECTORCALL get_state(const double& value) {
 		return reinterpret_cast<const DoubleState*>(&value)->v.state_;
 	}
 
@@ -57,15 +214,29 @@ public:
 
     /// Store a CalculationState in double value as a Nan
 	template<CalculationState State>
-	static void _vectorcall set(double& value) {
+	static void SCORE_VECTORCALL set(double& value) {
 		reinterpret_cast<DoubleState*>(&value)->v.state_ = State;
 	}
+	template<CalculationState State>
+	static void SCORE_VECTORCALL set(double *values, size_t index, BlockSummary& summary) {
+		set<State>(values[index]);
+		summary.set_state(index, State);
+	}
 
     /// Get the CalculationState as a double, with the state in the high order dword of the double.
-    double _vectorcall as_double_state_in_high_dword() { return dValue_; }
+    double SCORE_VECTORCALL as_double_state_in_high_dword() { return dValue_; }
     /// Get the CalculationState as an unsigned 64 bit int, with the state in the high order dword of the uint64.
     uint64_t as_uint64_state_in_high_dword() { return i64Value_; }
 
+    /// What set_not_calculated() stores in each double.
+    static uint64_t fill_pattern_of(CalculationState state) {
+#ifdef SCORE_64_BIT
+		return DoubleState(state).as_uint64_state_in_high_dword();
+#else
+		return static_cast<uint64_t>(state) << 32 | state;
+#endif
+    }
+
     /// Set the CalculationState in the high order dword.
 	DoubleState(CalculationState state) {
 		v.spacer_ = 0;
@@ -73,6 +244,8 @@ public:
 	}
 	
 private:
+	static const size_t inline_fill_size = 16; // not worth the call and the dispatch
+
     /// Remember: DoubleSate a union
     uint64_t i64Value_;
 	double dValue_;
@@ -0,0 +1,295 @@
+#include "pch.h"
+
+#include "ColumnAggregate.h"
+
+#include <immintrin.h>
+
+namespace score {
+using detail::Isa;
+
+namespace {
+
+/// NotCalculatedSaturn, NoAvg and Busy are consecutive: one range check catches the three
+static_assert(NoAvg == NotCalculatedSaturn + 1 && Busy == NoAvg + 1, "the states have moved");
+const uint32_t saturn_states = Busy - NotCalculatedSaturn + 1;
+
+bool IsState(const double& value)
+{
+    const uint32_t state = DoubleState::get_state(value);
+    return NotCalculated == state || state - NotCalculatedSaturn < saturn_states;
+}
+
+void ScalarAdd(const double value, ColumnAggregate& aggregate)
+{
+    if (IsState(value))
+        return;
+    aggregate.sum_ += value;
+    ++aggregate.count_;
+    // not std::min: a NaN on the left is ignored, as by the vector min
+    aggregate.min_ = value < aggregate.min_ ? value : aggregate.min_;
+    aggregate.max_ = value > aggregate.max_ ? value : aggregate.max_;
+}
+
+void ScalarAggregate(const double* values, const size_t size, ColumnAggregate& aggregate)
+{
+    for (size_t i = 0; i < size; ++i)
+        ScalarAdd(values[i], aggregate);
+}
+
+void ScalarAccumulate(const double* values, const size_t size, double* sums, uint64_t* counts)
+{
+    for (size_t i = 0; i < size; ++i) {
+        if (!IsState(values[i])) {
+            sums[i] += values[i];
+            ++counts[i];
+        }
+    }
+}
+
+/// all ones in the 64 bit lanes that hold a state
+SCORE_TARGET("avx2")
+__m256i Avx2States(const __m256d values)
+{
+    // the high dwords are small positive 64 bit ints after the shift, so a signed compare does for the range
+    const __m256i high = _mm256_srli_epi64(_mm256_castpd_si256(values), 32);
+    const __m256i in_saturn_range = _mm256_and_si256(
+        _mm256_cmpgt_epi64(high, _mm256_set1_epi64x(NotCalculatedSaturn - 1)),
+        _mm256_cmpgt_epi64(_mm256_set1_epi64x(Busy + 1), high));
+    return _mm256_or_si256(_mm256_cmpeq_epi64(high, _mm256_set1_epi64x(NotCalculated)), in_saturn_range);
+}
+
+/// one set of accumulators, 4 lanes each
+struct Avx2Lanes {
+    __m256d sum_;
+    __m256i count_;
+    __m256d min_;
+    __m256d max_;
+};
+
+SCORE_TARGET("avx2")
+void Avx2Start(Avx2Lanes& lanes)
+{
+    lanes.sum_ = _mm256_setzero_pd();
+    lanes.count_ = _mm256_setzero_si256();
+    lanes.min_ = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    lanes.max_ = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+}
+
+SCORE_TARGET("avx2")
+void Avx2Add(const double* values, Avx2Lanes& lanes)
+{
+    const __m256d v = _mm256_loadu_pd(values);
+    const __m256i states = Avx2States(v);
+    const __m256d skip = _mm256_castsi256_pd(states);
+    lanes.sum_ = _mm256_add_pd(lanes.sum_, _mm256_andnot_pd(skip, v));
+    lanes.count_ = _mm256_add_epi64(lanes.count_, _mm256_andnot_si256(states, _mm256_set1_epi64x(1)));
+    // the states become infinities that can't win; min/max return the 2nd operand for a NaN, so other NaNs are ignored
+    lanes.min_ = _mm256_min_pd(_mm256_blendv_pd(v, _mm256_set1_pd(std::numeric_limits<double>::infinity()), skip), lanes.min_);
+    lanes.max_ = _mm256_max_pd(_mm256_blendv_pd(v, _mm256_set1_pd(-std::numeric_limits<double>::infinity()), skip), lanes.max_);
+}
+
+SCORE_TARGET("avx2")
+void Avx2Reduce(const Avx2Lanes& lanes, ColumnAggregate& aggregate)
+{
+    alignas(32) double sum[4], min[4], max[4];
+    alignas(32) uint64_t count[4];
+    _mm256_store_pd(sum, lanes.sum_);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(count), lanes.count_);
+    _mm256_store_pd(min, lanes.min_);
+    _mm256_store_pd(max, lanes.max_);
+    for (size_t i = 0; i < 4; ++i) {
+        aggregate.sum_ += sum[i];
+        aggregate.count_ += count[i];
+        aggregate.min_ = min[i] < aggregate.min_ ? min[i] : aggregate.min_;
+        aggregate.max_ = max[i] > aggregate.max_ ? max[i] : aggregate.max_;
+    }
+}
+
+SCORE_TARGET("avx2")
+ColumnAggregate Avx2Aggregate(const double* values, const size_t size)
+{
+    // 2 sets of accumulators hide the latency of the adds, and take 8 of the 16 registers
+    Avx2Lanes even, odd;
+    Avx2Start(even);
+    Avx2Start(odd);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        Avx2Add(values + i, even);
+        Avx2Add(values + i + 4, odd);
+    }
+    if (i + 4 <= size) {
+        Avx2Add(values + i, even);
+        i += 4;
+    }
+
+    ColumnAggregate aggregate;
+    Avx2Reduce(even, aggregate);
+    Avx2Reduce(odd, aggregate);
+    ScalarAggregate(values + i, size - i, aggregate);
+    return aggregate;
+}
+
+SCORE_TARGET("avx2")
+void Avx2Accumulate(const double* values, const size_t size, double* sums, uint64_t* counts)
+{
+    const __m256i one = _mm256_set1_epi64x(1);
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        const __m256d v = _mm256_loadu_pd(values + i);
+        const __m256i states = Avx2States(v);
+        _mm256_storeu_pd(sums + i, _mm256_add_pd(_mm256_loadu_pd(sums + i), _mm256_andnot_pd(_mm256_castsi256_pd(states), v)));
+        __m256i* const count = reinterpret_cast<__m256i*>(counts + i);
+        _mm256_storeu_si256(count, _mm256_add_epi64(_mm256_loadu_si256(count), _mm256_andnot_si256(states, one)));
+    }
+    ScalarAccumulate(values + i, size - i, sums + i, counts + i);
+}
+
+/// set for the lanes that aren't states
+SCORE_TARGET("avx512f")
+__mmask8 Avx512Calculated(const __m512d values)
+{
+    // AVX-512 has the unsigned compare for the range
+    const __m512i high = _mm512_srli_epi64(_mm512_castpd_si512(values), 32);
+    const __mmask8 states = _mm512_cmpeq_epi64_mask(high, _mm512_set1_epi64(NotCalculated))
+        | _mm512_cmplt_epu64_mask(_mm512_sub_epi64(high, _mm512_set1_epi64(NotCalculatedSaturn)), _mm512_set1_epi64(saturn_states));
+    return static_cast<__mmask8>(~states);
+}
+
+/// the lanes left to do at the end
+__mmask8 TailMask(const size_t count)
+{
+    return static_cast<__mmask8>((1u << count) - 1);
+}
+
+struct Avx512Lanes {
+    __m512d sum_;
+    __m512i count_;
+    __m512d min_;
+    __m512d max_;
+};
+
+SCORE_TARGET("avx512f")
+void Avx512Start(Avx512Lanes& lanes)
+{
+    lanes.sum_ = _mm512_setzero_pd();
+    lanes.count_ = _mm512_setzero_si512();
+    lanes.min_ = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+    lanes.max_ = _mm512_set1_pd(-std::numeric_limits<double>::infinity());
+}
+
+/// only the lanes in the mask
+SCORE_TARGET("avx512f")
+void Avx512Add(const __m512d v, const __mmask8 lanes_to_add, Avx512Lanes& lanes)
+{
+    const __mmask8 calculated = static_cast<__mmask8>(Avx512Calculated(v) & lanes_to_add);
+    lanes.sum_ = _mm512_mask_add_pd(lanes.sum_, calculated, lanes.sum_, v);
+    lanes.count_ = _mm512_mask_add_epi64(lanes.count_, calculated, lanes.count_, _mm512_set1_epi64(1));
+    lanes.min_ = _mm512_mask_min_pd(lanes.min_, calculated, v, lanes.min_);
+    lanes.max_ = _mm512_mask_max_pd(lanes.max_, calculated, v, lanes.max_);
+}
+
+SCORE_TARGET("avx512f")
+ColumnAggregate Avx512Aggregate(const double* values, const size_t size)
+{
+    // 4 sets of accumulators: there are 32 registers
+    Avx512Lanes lanes[4];
+    for (auto& l : lanes)
+        Avx512Start(l);
+    const __mmask8 all = 0xff;
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        Avx512Add(_mm512_loadu_pd(values + i), all, lanes[0]);
+        Avx512Add(_mm512_loadu_pd(values + i + 8), all, lanes[1]);
+        Avx512Add(_mm512_loadu_pd(values + i + 16), all, lanes[2]);
+        Avx512Add(_mm512_loadu_pd(values + i + 24), all, lanes[3]);
+    }
+    for (; i + 8 <= size; i += 8)
+        Avx512Add(_mm512_loadu_pd(values + i), all, lanes[0]);
+    if (i < size) {
+        const __mmask8 tail = TailMask(size - i);
+        Avx512Add(_mm512_maskz_loadu_pd(tail, values + i), tail, lanes[1]);
+    }
+
+    for (size_t l = 1; l < 4; ++l) {
+        lanes[0].sum_ = _mm512_add_pd(lanes[0].sum_, lanes[l].sum_);
+        lanes[0].count_ = _mm512_add_epi64(lanes[0].count_, lanes[l].count_);
+        lanes[0].min_ = _mm512_min_pd(lanes[0].min_, lanes[l].min_);
+        lanes[0].max_ = _mm512_max_pd(lanes[0].max_, lanes[l].max_);
+    }
+    ColumnAggregate aggregate;
+    aggregate.sum_ = _mm512_reduce_add_pd(lanes[0].sum_);
+    aggregate.count_ = static_cast<uint64_t>(_mm512_reduce_add_epi64(lanes[0].count_));
+    aggregate.min_ = _mm512_reduce_min_pd(lanes[0].min_);
+    aggregate.max_ = _mm512_reduce_max_pd(lanes[0].max_);
+    return aggregate;
+}
+
+SCORE_TARGET("avx512f")
+void Avx512Accumulate(const double* values, const size_t size, double* sums, uint64_t* counts)
+{
+    // masked adds but whole stores: storing only the calculated lanes was twice as slow out of L2
+    const __m512i one = _mm512_set1_epi64(1);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        const __m512d v = _mm512_loadu_pd(values + i);
+        const __mmask8 calculated = Avx512Calculated(v);
+        const __m512d sum = _mm512_loadu_pd(sums + i);
+        _mm512_storeu_pd(sums + i, _mm512_mask_add_pd(sum, calculated, sum, v));
+        const __m512i count = _mm512_loadu_si512(counts + i);
+        _mm512_storeu_si512(counts + i, _mm512_mask_add_epi64(count, calculated, count, one));
+    }
+    if (i < size) {
+        const __mmask8 tail = TailMask(size - i);
+        const __m512d v = _mm512_maskz_loadu_pd(tail, values + i);
+        const __mmask8 calculated = static_cast<__mmask8>(Avx512Calculated(v) & tail);
+        _mm512_mask_storeu_pd(sums + i, calculated, _mm512_add_pd(_mm512_maskz_loadu_pd(tail, sums + i), v));
+        _mm512_mask_storeu_epi64(counts + i, calculated, _mm512_add_epi64(_mm512_maskz_loadu_epi64(tail, counts + i), one));
+    }
+}
+}
+
+namespace detail {
+ColumnAggregate SCORE_VECTORCALL aggregate(const Isa isa, const double* const values, const size_t size)
+{
+    switch (isa) {
+    case Isa::Avx512:
+        return Avx512Aggregate(values, size);
+    case Isa::Avx2:
+        return Avx2Aggregate(values, size);
+    default: {
+        ColumnAggregate aggregate;
+        ScalarAggregate(values, size, aggregate);
+        return aggregate;
+    }
+    }
+}
+
+void SCORE_VECTORCALL accumulate(const Isa isa, const double* const values, const size_t size, double* const sums, uint64_t* const counts)
+{
+    switch (isa) {
+    case Isa::Avx512:
+        Avx512Accumulate(values, size, sums, counts);
+        break;
+    case Isa::Avx2:
+        Avx2Accumulate(values, size, sums, counts);
+        break;
+    default:
+        ScalarAccumulate(values, size, sums, counts);
+    }
+}
+}
+
+void SCORE_VECTORCALL accumulate(const double* const values, const size_t size, double* const sums, uint64_t* const counts)
+{
+    // 3 streams and hardly any arithmetic: once the columns are out of L2 the AVX-512 kernel is slower than AVX2 (see BM_Accumulate)
+    const Isa best = detail::best_isa();
+    detail::accumulate(best == Isa::Avx512 ? Isa::Avx2 : best, values, size, sums, counts);
+}
+
+void SCORE_VECTORCALL mean(const double* const sums, const uint64_t* const counts, const size_t size, double* const means)
+{
+    const double no_avg = DoubleState(NoAvg).as_double_state_in_high_dword();
+    for (size_t i = 0; i < size; ++i)
+        means[i] = counts[i] ? sums[i] / static_cast<double>(counts[i]) : no_avg;
+}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits>
+
+#include "CalculationState.h"
+
+namespace score {
+
+/// Sum, count, min and max of the calculated values of a column, for the reporting averages.
+/// NoAvg and the other CalculationStates are skipped; a NaN that isn't a state makes the sum NaN, min and max ignore it.
+struct ColumnAggregate {
+    double sum_ = 0;
+    uint64_t count_ = 0;
+    double min_ = std::numeric_limits<double>::infinity(); // until something is counted
+    double max_ = -std::numeric_limits<double>::infinity();
+
+    /// NoAvg if nothing was counted
+    double mean() const {
+        return count_ ? sum_ / static_cast<double>(count_) : DoubleState(NoAvg).as_double_state_in_high_dword();
+    }
+};
+
+namespace detail {
+/// Aggregation kernels with a specific instruction set - for the tests and benchmarks.
+/// The vector kernels keep several accumulators, so the sums come out in a different order to the scalar kernel's.
+ColumnAggregate SCORE_VECTORCALL aggregate(Isa, const double* values, size_t size);
+void SCORE_VECTORCALL accumulate(Isa, const double* values, size_t size, double* sums, uint64_t* counts);
+}
+
+/// One pass over a column, with the best instruction set the cpu has.
+inline ColumnAggregate SCORE_VECTORCALL aggregate(const double* values, size_t size) {
+    return detail::aggregate(detail::best_isa(), values, size);
+}
+
+/// Add a column (a scenario, say) into running sums and counts, element by element:
+///     sums[i] += values[i], ++counts[i] - unless values[i] is NoAvg or another state.
+void SCORE_VECTORCALL accumulate(const double* values, size_t size, double* sums, uint64_t* counts);
+
+/// means[i] = sums[i] / counts[i], NoAvg where nothing was counted (means may be sums)
+void SCORE_VECTORCALL mean(const double* sums, const uint64_t* counts, size_t size, double* means);
+
+}
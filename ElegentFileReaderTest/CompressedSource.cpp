@@ -0,0 +1,479 @@
+#include "pch.h"
+
+#include "CompressedSource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include "Trace.h"
+#include "WorkerPool.h"
+
+#if ELEGENT_READER_GZIP
+#include <zlib.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "zlib.lib")
+#endif
+#endif
+#if ELEGENT_READER_ZSTD
+#include <zstd.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "zstd.lib")
+#endif
+#endif
+
+namespace {
+const size_t chunk_size = 1024 * 1024;           // decompressed, per chunk handed to the reader
+const size_t max_buffered = 8 * chunk_size;      // decompressed ahead of the reader, at most (roughly)
+const size_t compressed_read_size = 256 * 1024;
+const size_t max_bgzf_member = 64 * 1024;
+const size_t bgzf_members_per_worker = 4;        // per batch
+
+uint32_t Read16(const char* const p)
+{
+    return static_cast<uint8_t>(p[0]) | static_cast<uint32_t>(static_cast<uint8_t>(p[1])) << 8;
+}
+
+uint32_t Read32(const char* const p)
+{
+    return Read16(p) | Read16(p + 2) << 16;
+}
+
+bool IsGzip(const char* const p, const size_t size)
+{
+    return size >= 2 && '\x1f' == p[0] && '\x8b' == p[1];
+}
+
+/// a zstd frame, or a skippable frame (which the decompressor skips)
+bool IsZstd(const char* const p, const size_t size)
+{
+    return size >= 4 && (0xFD2FB528 == Read32(p) || 0x184D2A50 == (Read32(p) & 0xFFFFFFF0));
+}
+
+bool IsMemberStart(const CompressedSource::Format format, const char* const p, const size_t size)
+{
+    return CompressedSource::Format::Gzip == format ? IsGzip(p, size) : IsZstd(p, size);
+}
+
+/// the size of the BGZF member at p: from the BC field of its gzip header; 0 if it isn't one, or isn't all there
+size_t BgzfMemberSize(const char* const p, const size_t size)
+{
+    const size_t fixed_header = 12; // up to and including XLEN
+    if (size < fixed_header || !IsGzip(p, size) || 8 != p[2] || !(p[3] & 4)) // deflate, with an extra field
+        return 0;
+    const size_t extra_end = fixed_header + Read16(p + 10);
+    for (size_t field = fixed_header; field + 4 <= extra_end && field + 4 <= size; field += 4 + Read16(p + field + 2)) {
+        if ('B' == p[field] && 'C' == p[field + 1] && 2 == Read16(p + field + 2) && field + 6 <= size) {
+            const size_t member_size = Read16(p + field + 4) + size_t(1);
+            return member_size <= size ? member_size : 0;
+        }
+    }
+    return 0;
+}
+
+[[noreturn]] void Corrupt(const char* const format)
+{
+    throw std::exception((std::string("corrupt ") + format + " data").c_str());
+}
+
+/// one member or frame at a time: reset() for the next
+class Decoder {
+public:
+    virtual ~Decoder() = default;
+    /// as much of in as fits in out; true at the end of the member/frame
+    virtual bool __vectorcall decode(const char* in, size_t in_size, size_t& in_used, char* out, size_t out_size, size_t& out_used) = 0;
+    virtual void __vectorcall reset() = 0;
+};
+
+#if ELEGENT_READER_GZIP
+class GzipDecoder : public Decoder {
+public:
+    GzipDecoder()
+    {
+        if (Z_OK != inflateInit2(&stream_, 15 + 16)) // gzip header and trailer
+            throw std::exception("cannot start zlib");
+    }
+    ~GzipDecoder() override
+    {
+        inflateEnd(&stream_);
+    }
+
+    bool __vectorcall decode(const char* const in, const size_t in_size, size_t& in_used, char* const out, const size_t out_size, size_t& out_used) override
+    {
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+        stream_.avail_in = static_cast<uInt>(in_size);
+        stream_.next_out = reinterpret_cast<Bytef*>(out);
+        stream_.avail_out = static_cast<uInt>(out_size);
+        const int result = inflate(&stream_, Z_NO_FLUSH);
+        if (Z_OK != result && Z_STREAM_END != result && Z_BUF_ERROR != result)
+            Corrupt("gzip");
+        in_used = in_size - stream_.avail_in;
+        out_used = out_size - stream_.avail_out;
+        return Z_STREAM_END == result;
+    }
+
+    void __vectorcall reset() override
+    {
+        inflateReset(&stream_);
+    }
+
+private:
+    z_stream stream_ = {};
+};
+
+/// a whole BGZF member: the trailer gives the size
+std::vector<char> InflateMember(const char* const member, const size_t size)
+{
+    std::vector<char> result(Read32(member + size - 4));
+    z_stream stream = {};
+    if (Z_OK != inflateInit2(&stream, 15 + 16))
+        throw std::exception("cannot start zlib");
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(member));
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = reinterpret_cast<Bytef*>(result.data());
+    stream.avail_out = static_cast<uInt>(result.size());
+    const int status = inflate(&stream, Z_FINISH);
+    const bool complete = Z_STREAM_END == status && 0 == stream.avail_out;
+    inflateEnd(&stream);
+    if (!complete)
+        Corrupt("gzip");
+    return result;
+}
+#endif
+
+#if ELEGENT_READER_ZSTD
+class ZstdDecoder : public Decoder {
+public:
+    ZstdDecoder() : stream_(ZSTD_createDStream())
+    {
+        if (!stream_)
+            throw std::exception("cannot start zstd");
+        ZSTD_initDStream(stream_);
+    }
+    ~ZstdDecoder() override
+    {
+        ZSTD_freeDStream(stream_);
+    }
+
+    bool __vectorcall decode(const char* const in, const size_t in_size, size_t& in_used, char* const out, const size_t out_size, size_t& out_used) override
+    {
+        ZSTD_inBuffer input = {in, in_size, 0};
+        ZSTD_outBuffer output = {out, out_size, 0};
+        const size_t result = ZSTD_decompressStream(stream_, &output, &input);
+        if (ZSTD_isError(result))
+            Corrupt("zstd");
+        in_used = input.pos;
+        out_used = output.pos;
+        return 0 == result;
+    }
+
+    void __vectorcall reset() override
+    {
+        ZSTD_initDStream(stream_);
+    }
+
+private:
+    ZSTD_DStream* stream_;
+};
+#endif
+
+std::unique_ptr<Decoder> MakeDecoder(const CompressedSource::Format format)
+{
+#if ELEGENT_READER_GZIP
+    if (CompressedSource::Format::Gzip == format)
+        return std::make_unique<GzipDecoder>();
+#endif
+#if ELEGENT_READER_ZSTD
+    if (CompressedSource::Format::Zstd == format)
+        return std::make_unique<ZstdDecoder>();
+#endif
+    throw std::exception(CompressedSource::Format::Gzip == format ? "gzip input needs zlib" : "zstd input needs libzstd");
+}
+}
+
+// a chunk can be queued just under max_buffered
+const uint64_t CompressedSource::max_buffer_bytes = max_buffered + 2 * chunk_size + compressed_read_size;
+
+CompressedSource::Format __vectorcall CompressedSource::detect(InputSource& source)
+{
+    char magic[4];
+    const size_t size = source.read(0, magic, sizeof(magic));
+    if (IsGzip(magic, size))
+        return Format::Gzip;
+    if (IsZstd(magic, size))
+        return Format::Zstd;
+    return Format::None;
+}
+
+CompressedSource::CompressedSource(std::unique_ptr<InputSource> compressed, const size_t workers)
+    : compressed_(std::move(compressed)), format_(detect(*compressed_))
+{
+    if (Format::None == format_)
+        throw std::exception("not gzip or zstd");
+    MakeDecoder(format_); // throws if this build can't read the format
+
+    std::vector<char> first_member(max_bgzf_member);
+    bgzf_ = Format::Gzip == format_ && BgzfMemberSize(first_member.data(), compressed_->read(0, first_member.data(), first_member.size()));
+#if ELEGENT_READER_GZIP
+    if (bgzf_ && 1 != workers)
+        pool_ = std::make_unique<score::WorkerPool>(workers);
+#endif
+
+    checkpoints_.push_back(Checkpoint{0, 0});
+    start(checkpoints_.front());
+}
+
+CompressedSource::~CompressedSource()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop(lock);
+}
+
+std::vector<CompressedSource::Checkpoint> CompressedSource::checkpoints() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return checkpoints_;
+}
+
+size_t __vectorcall CompressedSource::read(const uint64_t offset, char* const buffer, const size_t size)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (offset != position_) {
+        if (!chunks_.empty() && offset >= chunks_.front().offset_ && offset < position_) {
+            position_ = offset; // back, but still in the chunk being read
+        } else {
+            // restart at the checkpoint before the offset, unless going on from here is nearer
+            const auto after = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), offset,
+                                                [](const uint64_t o, const Checkpoint& c) { return o < c.offset_; });
+            const Checkpoint checkpoint = *(after - 1);
+            if (offset < position_ || checkpoint.offset_ > position_) {
+                stop(lock);
+                position_ = checkpoint.offset_;
+                start(checkpoint);
+            }
+            // skip what's before the offset
+            while (position_ < offset && waitForData(lock)) {
+                const uint64_t chunk_end = chunks_.front().offset_ + chunks_.front().data_.size();
+                position_ = std::min(offset, chunk_end);
+                if (position_ == chunk_end) {
+                    chunks_.pop_front();
+                    space_ready_.notify_one();
+                }
+            }
+            if (position_ != offset) { // past the end
+                size_ = position_;
+                return 0;
+            }
+        }
+    }
+
+    size_t copied = 0;
+    while (copied < size && waitForData(lock)) {
+        Chunk& chunk = chunks_.front();
+        const size_t from = static_cast<size_t>(position_ - chunk.offset_);
+        const size_t bytes = std::min(size - copied, chunk.data_.size() - from);
+        std::memcpy(buffer + copied, chunk.data_.data() + from, bytes);
+        copied += bytes;
+        position_ += bytes;
+        if (from + bytes == chunk.data_.size()) {
+            chunks_.pop_front();
+            space_ready_.notify_one();
+        }
+    }
+    // the size has to be known by the read that gets the last byte
+    if (!waitForData(lock))
+        size_ = position_;
+    return copied;
+}
+
+/// wait until there's a chunk to read, or there are no more; throws what the background thread threw, once there's nothing before it to read
+bool __vectorcall CompressedSource::waitForData(std::unique_lock<std::mutex>& lock)
+{
+    data_ready_.wait(lock, [this] { return !chunks_.empty() || finished_; });
+    if (chunks_.empty() && error_)
+        std::rethrow_exception(error_);
+    return !chunks_.empty();
+}
+
+void __vectorcall CompressedSource::start(const Checkpoint& from)
+{
+    thread_ = std::thread(&CompressedSource::decompress, this, from);
+}
+
+void __vectorcall CompressedSource::stop(std::unique_lock<std::mutex>& lock)
+{
+    if (!thread_.joinable())
+        return;
+    stopping_ = true;
+    space_ready_.notify_all();
+    lock.unlock();
+    thread_.join();
+    lock.lock();
+    stopping_ = false;
+    finished_ = false;
+    error_ = nullptr;
+    chunks_.clear();
+}
+
+/// the background thread
+void __vectorcall CompressedSource::decompress(const Checkpoint from)
+{
+    std::exception_ptr error;
+    try {
+        if (pool_)
+            decompressBgzf(from);
+        else
+            decompressStream(from);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    error_ = error;
+    finished_ = true;
+    data_ready_.notify_all();
+}
+
+/// false if stopping
+bool __vectorcall CompressedSource::push(Chunk&& chunk)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_ready_.wait(lock, [this] {
+        size_t buffered = 0;
+        for (const auto& queued : chunks_)
+            buffered += queued.data_.size();
+        return stopping_ || buffered < max_buffered;
+    });
+    if (stopping_)
+        return false;
+    chunks_.push_back(std::move(chunk));
+    data_ready_.notify_one();
+    return true;
+}
+
+void __vectorcall CompressedSource::addCheckpoint(const Checkpoint& checkpoint)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (checkpoint.offset_ > checkpoints_.back().offset_)
+        checkpoints_.push_back(checkpoint);
+}
+
+/// a member/frame after another, on the background thread
+void __vectorcall CompressedSource::decompressStream(const Checkpoint from)
+{
+    const std::unique_ptr<Decoder> decoder = MakeDecoder(format_);
+
+    std::vector<char> in(compressed_read_size);
+    uint64_t in_offset = from.compressed_offset_; // of in[0], in the file
+    size_t in_begin = 0;
+    size_t in_end = 0;
+    bool source_ended = false;
+    // keep what's left of in, and read more after it
+    auto refill = [&] {
+        const size_t left = in_end - in_begin;
+        std::memmove(in.data(), in.data() + in_begin, left);
+        in_offset += in_begin;
+        in_begin = 0;
+        const size_t bytes = compressed_->read(in_offset + left, in.data() + left, in.size() - left);
+        in_end = left + bytes;
+        source_ended = bytes < in.size() - left;
+    };
+
+    Chunk chunk{from.offset_, std::vector<char>(chunk_size)};
+    size_t chunk_used = 0;
+    bool member_ended = false;
+    for (;;) {
+        if (in_end - in_begin < 4 && !source_ended) // 4: enough for a magic number
+            refill();
+        if (member_ended) {
+            // another member or frame, or the end (anything after the last one that isn't one, e.g. padding, is ignored)
+            if (!IsMemberStart(format_, in.data() + in_begin, in_end - in_begin))
+                break;
+            decoder->reset();
+            member_ended = false;
+            addCheckpoint(Checkpoint{chunk.offset_ + chunk_used, in_offset + in_begin});
+        }
+
+        trace::Span span("decompress");
+        size_t in_used = 0;
+        size_t out_used = 0;
+        member_ended = decoder->decode(in.data() + in_begin, in_end - in_begin, in_used, chunk.data_.data() + chunk_used,
+                                       chunk_size - chunk_used, out_used);
+        in_begin += in_used;
+        chunk_used += out_used;
+        span.arg("bytes", out_used);
+
+        if (chunk_size == chunk_used) {
+            const uint64_t next = chunk.offset_ + chunk_size;
+            if (!push(std::move(chunk)))
+                return;
+            chunk = Chunk{next, std::vector<char>(chunk_size)};
+            chunk_used = 0;
+        }
+        if (!member_ended && 0 == in_used && 0 == out_used) { // it needs more
+            if (source_ended)
+                Corrupt(Format::Gzip == format_ ? "gzip" : "zstd"); // cut short
+            refill();
+        }
+    }
+    chunk.data_.resize(chunk_used);
+    if (chunk_used)
+        push(std::move(chunk));
+}
+
+/// BGZF: read a batch of members, and decompress them in parallel (each member is a chunk)
+void __vectorcall CompressedSource::decompressBgzf(const Checkpoint from)
+{
+#if ELEGENT_READER_GZIP
+    std::vector<char> in(pool_->size() * bgzf_members_per_worker * max_bgzf_member);
+    uint64_t in_offset = from.compressed_offset_;
+    uint64_t out_offset = from.offset_;
+    struct Member {
+        size_t begin_;
+        size_t size_;
+    };
+    std::vector<Member> members;
+    std::vector<std::vector<char>> outputs;
+    for (;;) {
+        const size_t in_end = compressed_->read(in_offset, in.data(), in.size());
+        members.clear();
+        size_t member_begin = 0;
+        for (size_t size; member_begin < in_end && 0 != (size = BgzfMemberSize(in.data() + member_begin, in_end - member_begin)); member_begin += size)
+            members.push_back(Member{member_begin, size});
+        if (members.empty()) {
+            if (0 == in_end)
+                return;
+            // not BGZF (from here), or cut short: decompress the rest a member at a time
+            decompressStream(Checkpoint{out_offset, in_offset});
+            return;
+        }
+
+        trace::Span span("decompressBatch");
+        span.arg("members", members.size());
+        outputs.assign(members.size(), std::vector<char>());
+        pool_->run([&](const size_t worker) {
+            for (size_t m = worker; m < members.size(); m += pool_->size())
+                outputs[m] = InflateMember(in.data() + members[m].begin_, members[m].size_);
+        });
+
+        for (size_t m = 0; m < members.size(); ++m) {
+            addCheckpoint(Checkpoint{out_offset, in_offset + members[m].begin_});
+            const size_t size = outputs[m].size();
+            if (size && !push(Chunk{out_offset, std::move(outputs[m])}))
+                return;
+            out_offset += size;
+        }
+        in_offset += member_begin;
+    }
+#else
+    decompressStream(from);
+#endif
+}
+
+std::unique_ptr<InputSource> __vectorcall OpenInput(const char* const filename, const size_t workers)
+{
+    auto file = std::make_unique<FileSource>(filename);
+    if (CompressedSource::Format::None == CompressedSource::detect(*file))
+        return file;
+    return std::make_unique<CompressedSource>(std::make_unique<PreadSource>(filename), workers);
+}
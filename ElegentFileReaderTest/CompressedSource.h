@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "InputSource.h"
+
+// gzip needs zlib, zstd needs libzstd: each is built in if its header is found (or define these to 0 or 1)
+#if !defined(ELEGENT_READER_GZIP)
+#if __has_include(<zlib.h>)
+#define ELEGENT_READER_GZIP 1
+#else
+#define ELEGENT_READER_GZIP 0
+#endif
+#endif
+#if !defined(ELEGENT_READER_ZSTD)
+#if __has_include(<zstd.h>)
+#define ELEGENT_READER_ZSTD 1
+#else
+#define ELEGENT_READER_ZSTD 0
+#endif
+#endif
+
+namespace score {
+class WorkerPool;
+}
+
+/// A compressed file read as if it were the file inside: gzip (one or more members) or zstd (one or more frames).
+/// A background thread decompresses ahead of the reader, a chunk at a time, so the reading and the parsing overlap.
+/// BGZF files (bgzip: gzip members of at most 64 KB that each give their own length) are decompressed a batch of
+/// members at a time, in parallel on a WorkerPool.
+/// The size isn't known until the end is reached (like a StreamSource). seek() works anywhere, but isn't free:
+/// it restarts at the last member/frame start before the offset seen so far (the checkpoints), and decompresses from there.
+class CompressedSource : public InputSource {
+public:
+    enum class Format : uint8_t { None, Gzip, Zstd };
+
+    /// the most memory a source holds at once, with workers = 1: the chunks decompressed ahead of the reader, the one
+    /// being filled, and the compressed read buffer (BGZF on more workers adds a batch of members per worker)
+    static const uint64_t max_buffer_bytes;
+
+    /// from the 1st bytes: the magic numbers of gzip and zstd
+    static Format __vectorcall detect(InputSource&);
+
+    /// workers: for BGZF files; 0 is one per logical cpu, 1 decompresses on the background thread only
+    explicit CompressedSource(std::unique_ptr<InputSource> compressed, size_t workers = 0);
+    ~CompressedSource() override;
+    CompressedSource(const CompressedSource&) = delete;
+    CompressedSource& operator=(const CompressedSource&) = delete;
+
+    size_t __vectorcall read(uint64_t offset, char* buffer, size_t size) override;
+    uint64_t size() const override
+    {
+        return size_;
+    }
+
+    Format format() const
+    {
+        return format_;
+    }
+    bool isBgzf() const
+    {
+        return bgzf_;
+    }
+
+    /// where decompression can restart: the start of a member or frame
+    struct Checkpoint {
+        uint64_t offset_;            // in the decompressed data
+        uint64_t compressed_offset_; // in the file
+    };
+    std::vector<Checkpoint> checkpoints() const;
+
+private:
+    struct Chunk {
+        uint64_t offset_; // of data_[0], in the decompressed data
+        std::vector<char> data_;
+    };
+
+    void __vectorcall start(const Checkpoint& from);
+    void __vectorcall stop(std::unique_lock<std::mutex>&);
+    void __vectorcall decompress(Checkpoint from);
+    void __vectorcall decompressStream(Checkpoint from);
+    void __vectorcall decompressBgzf(Checkpoint from);
+    bool __vectorcall push(Chunk&&);
+    void __vectorcall addCheckpoint(const Checkpoint&);
+    bool __vectorcall waitForData(std::unique_lock<std::mutex>&);
+
+    std::unique_ptr<InputSource> compressed_;
+    const Format format_;
+    bool bgzf_ = false;
+    std::unique_ptr<score::WorkerPool> pool_; // BGZF only
+
+    uint64_t position_ = 0; // of the next byte read, in the decompressed data
+    uint64_t size_ = unknown_size;
+
+    // shared with the background thread
+    mutable std::mutex mutex_;
+    std::condition_variable data_ready_;
+    std::condition_variable space_ready_;
+    std::deque<Chunk> chunks_;
+    std::vector<Checkpoint> checkpoints_;
+    bool finished_ = false; // the background thread has decompressed everything
+    bool stopping_ = false;
+    std::exception_ptr error_;
+    std::thread thread_;
+};
+
+/// a file as an InputSource: decompressed if it is gzip or zstd (read with pread), read with std::ifstream if not;
+/// workers as for CompressedSource
+std::unique_ptr<InputSource> __vectorcall OpenInput(const char* filename, size_t workers = 0);
@@ -2,12 +2,19 @@
 
 #include "ElegentFileReader.h"
 
+#include <algorithm>
 #include <exception>
 #include <string>
 #include <Windows.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
+#include "CompressedSource.h"
 #include "Ensure.h"
+#include "Trace.h"
 #include <filesystem>
+#include <memory>
 
 namespace {
 const bool build_record = true;
@@ -31,14 +38,123 @@ const char unicode_signature[] = {'\xEF', '\xBB', '\xBF'};
 const size_t unicode_signature_length = sizeof(unicode_signature) / sizeof(*unicode_signature);
 const char* const unicode_signature_end = unicode_signature + unicode_signature_length;
 
+const uint8_t shift_jis_lowest_trail_byte = 0x40;
+
+bool IsUtf8Continuation(const char c)
+{
+    return (static_cast<uint8_t>(c) & 0xC0) == 0x80;
+}
+
 bool UnicodeSignatureContains(const char c)
 {
     return std::find(unicode_signature, unicode_signature_end, c) != unicode_signature_end;
 }
+
+const char quote = '"';
+const size_t chunk_size = 64;
+
+/// the delimiters and LFs outside quotes in a chunk of up to 64 bytes, as bitmasks
+struct QuotedChunk {
+    uint64_t delimiters_;
+    uint64_t line_feeds_;
+};
+
+#if defined(__AVX2__)
+uint64_t BytesEqual(const __m256i low, const __m256i high, const char c)
+{
+    const __m256i match = _mm256_set1_epi8(c);
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, match)))
+        | static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, match)))) << 32;
+}
+#endif
+
+/// bit i set if bit i of the quotes is preceded by an odd number of quotes (including itself)
+uint64_t PrefixXor(const uint64_t quotes)
+{
+#if defined(__AVX2__) && (defined(_MSC_VER) || defined(__PCLMUL__))
+    // carry-less multiply by all ones: each bit of the product is the XOR of all the lower bits
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_clmulepi64_si128(
+        _mm_set_epi64x(0, static_cast<int64_t>(quotes)), _mm_set1_epi8(-1), 0)));
+#else
+    uint64_t mask = quotes;
+    for (int shift = 1; shift < 64; shift <<= 1)
+        mask ^= mask << shift;
+    return mask;
+#endif
+}
+
+/// in_quotes carries over from the previous chunk: all ones if it ended inside quotes
+QuotedChunk ScanQuotedChunk(const char* const data, const size_t size, const char delimiter, uint64_t& in_quotes)
+{
+    alignas(32) char padded[chunk_size];
+    const char* chunk = data;
+    if (size < chunk_size) { // the end of the buffer: pad with nulls, which are never quotes, delimiters or LFs
+        std::memcpy(padded, data, size);
+        std::memset(padded + size, terminating_null, chunk_size - size);
+        chunk = padded;
+    }
+
+#if defined(__AVX2__)
+    const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chunk));
+    const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chunk + 32));
+    const uint64_t quotes = BytesEqual(low, high, quote);
+    const uint64_t delimiters = BytesEqual(low, high, delimiter);
+    const uint64_t line_feeds = BytesEqual(low, high, LF);
+#else
+    uint64_t quotes = 0, delimiters = 0, line_feeds = 0;
+    for (size_t i = 0; i < chunk_size; ++i) {
+        quotes |= static_cast<uint64_t>(quote == chunk[i]) << i;
+        delimiters |= static_cast<uint64_t>(delimiter == chunk[i]) << i;
+        line_feeds |= static_cast<uint64_t>(LF == chunk[i]) << i;
+    }
+#endif
+
+    const uint64_t inside = PrefixXor(quotes) ^ in_quotes;
+    in_quotes = static_cast<uint64_t>(static_cast<int64_t>(inside) >> 63); // the last byte's state, to all 64 bits
+    return QuotedChunk{delimiters & ~inside, line_feeds & ~inside};
+}
+
+unsigned long LowestBit(const uint64_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return index;
+#else
+    return static_cast<unsigned long>(__builtin_ctzll(mask));
+#endif
+}
+
+/// take the quotes off a quoted field and turn each "" into "; the result is null terminated where it ends
+void UnescapeQuotedField(char* const field, const char* const end)
+{
+    char* out = field;
+    const char* in = field + 1; // after the opening quote
+    while (in < end) {
+        const char* const next_quote = static_cast<const char*>(memchr(in, quote, end - in));
+        const char* const run_end = next_quote ? next_quote : end;
+        std::memmove(out, in, run_end - in);
+        out += run_end - in;
+        in = run_end;
+        if (!next_quote)
+            break;
+        if (in + 1 < end && quote == in[1]) { // a doubled quote
+            *out++ = quote;
+            in += 2;
+        } else { // the closing quote: anything after it (up to the delimiter) is kept as is
+            ++in;
+            std::memmove(out, in, end - in);
+            out += end - in;
+            break;
+        }
+    }
+    *out = terminating_null;
+}
 }
 
 ElegentFileReader::ElegentFileReader(
-    const uint32_t read_size, const char delimiter, const bool as_one, const size_t max_fields)
+    const uint32_t read_size, const char delimiter, const bool as_one, const size_t max_fields, const Encoding encoding,
+    const Quoting quoting)
     : file_size_(0),
       read_size_(read_size),
       pos_(0),
@@ -48,41 +164,115 @@ ElegentFileReader::ElegentFileReader(
       last_actual_character_(0),
       delimiter_(delimiter),
       multiple_delimiters_as_one_(as_one),
-      max_fields_requested_(max_fields)
+      max_fields_requested_(max_fields),
+      encoding_(encoding),
+      buffer_is_ascii_(false),
+      resync_utf8_(false),
+      records_read_(0),
+      quoting_(quoting),
+      line_(0),
+      line_known_(true),
+      expected_fields_(0),
+      split_until_(0),
+      pool_(nullptr),
+      backward_pos_(0),
+      backward_block_pos_(0)
 {
     ENSURE(read_size, >, 0);
     ENSURE(!UnicodeSignatureContains(delimiter));
+    ENSURE(Encoding::ShiftJis != encoding || static_cast<uint8_t>(delimiter) < shift_jis_lowest_trail_byte);
+    ENSURE(Quoting::None == quoting || (quote != delimiter && terminating_null != delimiter));
 }
 
-/// free all memory and call the constructor
+template <> // counting the stats
+void __vectorcall ElegentFileReader::count<true>(uint64_t ReaderStats::* const counter, const uint64_t n)
+{
+    stats_.*counter += n;
+}
+
+ElegentFileReader::~ElegentFileReader()
+{
+    if (pool_ && buffer_.capacity())
+        pool_->give(BufferPool::Buffers{std::move(buffer_), std::move(record_)});
+}
+
+/// call the constructor, and hand back the buffers (emptied, their capacity kept)
 /// done this way to preserve const-ness
-void __vectorcall ElegentFileReader::close()
+BufferPool::Buffers __vectorcall ElegentFileReader::reset()
 {
-    if (ifs_.is_open())
-        ifs_.close();
-    if (!ifs_)
-        throw std::exception("cannot close file");
+    source_.reset();
 
     // reset everything in case we want to open another file
-    Buffer().swap(buffer_);
-    Record().swap(record_);
-    new(this) ElegentFileReader(read_size_, delimiter_, multiple_delimiters_as_one_, max_fields_requested_);
+    BufferPool::Buffers buffers{std::move(buffer_), std::move(record_)};
+    buffers.buffer_.clear();
+    buffers.record_.clear();
+    std::vector<TranscodedField>().swap(transcoded_);
+    std::vector<uint32_t>().swap(separators_);
+    std::vector<char>().swap(backward_block_);
+    // the error policy and log, the filters and the pool outlive the file
+    ErrorLog errors = std::move(errors_);
+    const size_t expected_fields = expected_fields_;
+    std::vector<RowFilter> filters = std::move(filters_);
+    BufferPool* const pool = pool_;
+    new(this) ElegentFileReader(read_size_, delimiter_, multiple_delimiters_as_one_, max_fields_requested_, encoding_, quoting_);
+    errors_ = std::move(errors);
+    expected_fields_ = expected_fields;
+    filters_ = std::move(filters);
+    pool_ = pool;
+    return buffers;
+}
+
+/// free all memory (or give it back to the pool)
+void __vectorcall ElegentFileReader::close()
+{
+    BufferPool::Buffers buffers = reset();
+    if (pool_)
+        pool_->give(std::move(buffers));
+}
+
+void __vectorcall ElegentFileReader::reopen(const char* const filename)
+{
+    reopen(OpenInput(filename));
+}
+
+void __vectorcall ElegentFileReader::reopen(std::unique_ptr<InputSource> source)
+{
+    BufferPool::Buffers buffers = reset();
+    buffer_ = std::move(buffers.buffer_);
+    record_ = std::move(buffers.record_);
+    open(std::move(source));
+}
+
+void __vectorcall ElegentFileReader::setBufferPool(BufferPool* const pool)
+{
+    ENSURE(!isOpen());
+    pool_ = pool;
 }
 
 /// open the file for reading
 void __vectorcall ElegentFileReader::open(const char* const filename)
 {
-    ENSURE(!isOpen());
+    open(OpenInput(filename));
+}
 
-    ifs_.open(std::filesystem::u8path(filename), std::ios::binary);
+/// read from any source: the size may not be known until the last block is read
+void __vectorcall ElegentFileReader::open(std::unique_ptr<InputSource> source)
+{
+    ENSURE(!isOpen());
+    ENSURE(source);
+    trace::Span span("open");
 
-    if (!ifs_ || !isOpen()) {
-        ifs_.clear();
-        throw std::exception((std::string("cannot open ") + filename).c_str());
+    if (pool_ && !buffer_.capacity()) {
+        BufferPool::Buffers buffers = pool_->take();
+        buffer_ = std::move(buffers.buffer_);
+        record_ = std::move(buffers.record_);
     }
-
-    file_size_ = std::filesystem::file_size(filename);
+    source_ = std::move(source);
+    file_size_ = source_->size();
     eof_ = ftell() == file_size_;
+    backward_pos_ = file_size_;
+    errors_.clear();
+    span.arg("file_size", file_size_);
 }
 
 /// remember the end-of-record position by restoring the character that was replaced with a terminating_null back into the buffer
@@ -226,7 +416,10 @@ size_t __vectorcall ElegentFileReader::handlePartialRecord()
         UpdateFieldOffsets<IfBuildingRecord>(record_, pos_of_record_in_buffer_);
 
         pos_of_buffer_in_file_ += buffer_.size() - partial_record_length;
+        count(&ReaderStats::partial_record_bytes_, partial_record_length);
+        count(&ReaderStats::field_pointer_fixups_, record_.size());
     }
+    count(&ReaderStats::partial_records_, 0 != partial_record_length);
 
     pos_of_record_in_buffer_ = 0;
     buffer_.resize(partial_record_length); // resize the buffer smaller
@@ -256,8 +449,10 @@ void __vectorcall ElegentFileReader::resizeBuffer<build_record>(const size_t new
 
     // adjust all the word/field pointers found thus far. if buffer memory was re-allocated,
     // we've got the original buffer begin, so we can safely adjust the pointers :)
-    if (original_buffer_data != buffer_.data())
+    if (original_buffer_data != buffer_.data()) {
         UpdateFieldOffsets(record_, original_buffer_data - buffer_.data());
+        count(&ReaderStats::field_pointer_fixups_, record_.size());
+    }
 }
 
 template <>
@@ -280,28 +475,62 @@ void __vectorcall ElegentFileReader::clearRecordStartedInUnicodeSignature<build_
 template <bool IfBuildingRecord>
 void __vectorcall ElegentFileReader::readBlock()
 {
+    trace::Span span("readBlock");
     const size_t partial_record_length = handlePartialRecord<IfBuildingRecord>();
     // resize the buffer; big enough for everything (+1 for a terminating_null)
+    const size_t capacity = buffer_.capacity();
     resizeBuffer<IfBuildingRecord>(partial_record_length + read_size_ + 1);
+    count(&ReaderStats::buffer_reallocations_, buffer_.capacity() != capacity);
 
-    uint32_t bytes_read = read_size_;
-    if (!ifs_.read(buffer_.data() + partial_record_length, read_size_)) {
-        if (ifs_.rdstate() != (std::ios::failbit | std::ios::eofbit))
-            throw std::exception("error on read");
-        ifs_.clear();
-        bytes_read = static_cast<uint32_t>(ifs_.gcount());
-    }
+    // the block follows on from the end of the buffer
+    const uint32_t bytes_read = static_cast<uint32_t>(source_->read(pos_of_buffer_in_file_ + partial_record_length,
+                                                                    buffer_.data() + partial_record_length, read_size_));
+    // a stream's size becomes known with the read that gets its last byte
+    file_size_ = source_->size();
 
     // in case fewer bytes were read than requested (reached eof), resize buffer to reflect the correct size
     const size_t new_size = partial_record_length + bytes_read;
     buffer_[new_size] = terminating_null;
     buffer_.resize(new_size);
+    count(&ReaderStats::blocks_read_);
+    count(&ReaderStats::bytes_read_, bytes_read);
+    span.arg("bytes", bytes_read);
+
+    checkEncoding(partial_record_length);
 
     if (skippedOverUnicodeSignature())
         // TODO: when read_size_ gets changed to a template parameter, call the next function if read_size_ < unicode_signature_length
         clearRecordStartedInUnicodeSignature<IfBuildingRecord>();
 }
 
+/// for the block just read (from block_begin to the end of the buffer): is it all ASCII, and is it valid utf-8
+/// utf-8 is validated as a stream, so a character can straddle blocks
+void __vectorcall ElegentFileReader::checkEncoding(const size_t block_begin)
+{
+    if (Encoding::Unchecked == encoding_)
+        return;
+
+    const char* block = buffer_.data() + block_begin;
+    size_t block_size = buffer_.size() - block_begin;
+    const bool block_is_ascii = IsAscii(block, block_size);
+    // the rest of the buffer is the partial record from the previous buffer
+    buffer_is_ascii_ = block_is_ascii && (0 == block_begin || buffer_is_ascii_);
+
+    if (Encoding::Utf8 != encoding_)
+        return;
+
+    if (resync_utf8_) {
+        for (size_t i = 0; i < 3 && block_size && IsUtf8Continuation(*block); ++i, ++block, --block_size)
+            ;
+        resync_utf8_ = false;
+    }
+
+    bool valid = block_is_ascii ? (!block_size || utf8_validator_.updateAscii()) : utf8_validator_.update(block, block_size);
+    if (pos_of_buffer_in_file_ + buffer_.size() == file_size_)
+        valid = utf8_validator_.finish() && valid;
+    if (!valid)
+        throw std::exception((std::string("invalid utf-8 in the block at file offset ") + std::to_string(pos_of_buffer_in_file_ + block_begin)).c_str());
+}
 
 /// seek to a block boundary position; pos will be set appropriately whithin the block
 void __vectorcall ElegentFileReader::seek(const uint64_t filepos_requested)
@@ -309,29 +538,39 @@ void __vectorcall ElegentFileReader::seek(const uint64_t filepos_requested)
     ENSURE(filepos_requested, <= , file_size_);
 
     restoreEolCharacter();
+    line_ = 0;
+    line_known_ = 0 == filepos_requested;
+    backward_pos_ = filepos_requested;
 
+    const uint64_t ftell_before_seek = ftell();
     uint64_t new_buffer_pos = filepos_requested / read_size_ * read_size_;  // quotient * read_size_
     pos_ = static_cast<size_t>(filepos_requested - new_buffer_pos);  // remainder
     eof_ = filepos_requested == file_size_;
 
     // check if (filepos_wanted is in the current buffer) ---> no actual reading required
-    if (new_buffer_pos == pos_of_buffer_in_file_) {
+    // (quoted mode unescapes fields in the buffer: the records already read can't be read again)
+    if (new_buffer_pos == pos_of_buffer_in_file_ && (Quoting::None == quoting_ || filepos_requested >= ftell_before_seek)) {
         // skip over unicode signature if at the front of the file, 
         // but whether we do or not doesn't matter - no need to check return value
         skippedOverUnicodeSignature();
+        count(&ReaderStats::seeks_in_buffer_);
+        split_until_ = std::max(split_until_, ftell_before_seek);
 
         // and we don't have to clear out the record here: the buffer is still intact, the record will be too
         return;
     }
 
-    // clearout the buffers and position the file for the next read
+    // clearout the buffers and position the file for the next read (only these seeks are traced: the others are free)
+    trace::Span span("seek");
+    span.arg("offset", new_buffer_pos);
+    count(&ReaderStats::seeks_outside_buffer_);
     buffer_.clear();
     record_.clear();
     pos_of_buffer_in_file_ = new_buffer_pos;
-
-    if (!ifs_.seekg(new_buffer_pos))
-        throw std::exception("error on seek");;
-
+    split_until_ = 0;
+    utf8_validator_.reset();
+    resync_utf8_ = new_buffer_pos > 0;
+    // the next readBlock() reads from new_buffer_pos
 }
 
 /// add the field pointers to the Record
@@ -359,8 +598,9 @@ const ElegentFileReader::Record& __vectorcall ElegentFileReader::getNextRecord()
     if (!isEOF())
         do {
             // fill the buffer if it is getting empty
-            while (pos_ + 1 >= buffer_.size() // leave 1 char to check for CRLF
-                && ftell() + 1 < file_size_) // and there are more blocks to be read
+            while ((pos_ + 1 >= buffer_.size() // leave 1 char to check for CRLF
+                    && ftell() + 1 < file_size_) // and there are more blocks to be read
+                || (pos_ >= buffer_.size() && ftell() < file_size_)) // after a seek() to the last char, read that too
                 readBlock<IfBuildingRecord>();
 
             checkForNewField<IfBuildingRecord>();
@@ -370,14 +610,332 @@ const ElegentFileReader::Record& __vectorcall ElegentFileReader::getNextRecord()
     return record_; // in case of skipRecord, the record will be empty and this result unused
 }
 
+/// quoted mode: find the end of the record a chunk at a time, remembering the delimiters outside quotes on the way;
+/// then (if building the record) split it into fields
+template <bool IfBuildingRecord>
+const ElegentFileReader::Record& __vectorcall ElegentFileReader::getNextQuotedRecord()
+{
+    record_.clear();
+    separators_.clear();
+    if (isEOF())
+        return record_;
+
+    size_t record_begin = pos_;
+    size_t scanned = 0; // from record_begin
+    size_t record_end = 0; // from record_begin: the LF, or the end of the file
+    bool found_line_feed = false;
+    uint64_t in_quotes = 0;
+    while (!found_line_feed) {
+        // after a seek() the buffer is empty, with pos_ (so record_begin) where the record will be once the block is read
+        if (record_begin + scanned >= buffer_.size()) {
+            record_end = scanned;
+            if (pos_of_buffer_in_file_ + buffer_.size() >= file_size_)
+                break; // the last record in the file ended without a LF
+
+            // keep the record so far; it moves to the front of the buffer (or after the unicode signature at the start of the file)
+            pos_ = record_begin;
+            pos_of_record_in_buffer_ = record_begin;
+            readBlock<IfBuildingRecord>();
+            record_begin = pos_;
+            continue;
+        }
+
+        const size_t size = std::min(chunk_size, buffer_.size() - record_begin - scanned);
+        const QuotedChunk chunk = ScanQuotedChunk(buffer_.data() + record_begin + scanned, size, delimiter_, in_quotes);
+        uint64_t delimiters = chunk.delimiters_;
+        if (chunk.line_feeds_) {
+            const unsigned long line_feed = LowestBit(chunk.line_feeds_);
+            delimiters &= (uint64_t(1) << line_feed) - 1; // only the delimiters before it
+            record_end = scanned + line_feed;
+            found_line_feed = true;
+        }
+        // once we have max_fields_requested_, the remaining delimiters are part of the last field
+        // (unless consecutive delimiters count as one: then splitQuotedRecord() can't tell where that is yet)
+        for (; delimiters && (multiple_delimiters_as_one_ || separators_.size() + 1 < max_fields_requested_); delimiters &= delimiters - 1)
+            separators_.push_back(static_cast<uint32_t>(scanned + LowestBit(delimiters)));
+        scanned += size;
+    }
+
+    splitQuotedRecord<IfBuildingRecord>(record_begin, record_end);
+
+    pos_ = record_begin + record_end + (found_line_feed ? 1 : 0);
+    pos_of_record_in_buffer_ = record_begin;
+    eof_ = ftell() == file_size_;
+    return record_;
+}
+
+/// null terminate the fields of the record found by getNextQuotedRecord(), unescaping quoted ones
+/// record_end is the LF (or the end of the file), relative to record_begin
+template <>
+void __vectorcall ElegentFileReader::splitQuotedRecord<build_record>(const size_t record_begin, size_t record_end)
+{
+    char* const record = buffer_.data() + record_begin;
+    if (record_end > 0 && CR == record[record_end - 1])
+        --record_end;
+
+    size_t field_begin = 0;
+    for (size_t i = 0; i <= separators_.size(); ++i) {
+        size_t field_end = i < separators_.size() ? separators_[i] : record_end;
+        // consecutive delimiters count as one: skip the empty field between them (but not an empty quoted one)
+        if (multiple_delimiters_as_one_ && i < separators_.size() && field_begin == field_end) {
+            ++field_begin;
+            continue;
+        }
+        if (record_.size() + 1 == max_fields_requested_) { // the last field we want: it has the rest of the record
+            field_end = record_end;
+            i = separators_.size();
+        }
+
+        char* const field = record + field_begin;
+        if (quote == *field && field_begin < field_end)
+            UnescapeQuotedField(field, record + field_end);
+        else
+            record[field_end] = terminating_null;
+        record_.push_back(field);
+        field_begin = field_end + 1;
+    }
+}
+
 void __vectorcall ElegentFileReader::skipRecord()
 {
-    getNextRecord<!build_record>();
+    count(&ReaderStats::records_skipped_, !isEOF());
+    line_ += !isEOF();
+    if (Quoting::None != quoting_)
+        getNextQuotedRecord<!build_record>();
+    else
+        getNextRecord<!build_record>();
 }
 
 const ElegentFileReader::Record& __vectorcall ElegentFileReader::readRecord()
 {
-    return getNextRecord<build_record>();
+    for (;;) {
+        // filtered out on its bytes: never split into fields
+        const Filtered filtered = filters_.empty() ? Filtered::In : filterRawRecord();
+        if (Filtered::Out == filtered) {
+            ++line_;
+            count(&ReaderStats::records_filtered_);
+            continue;
+        }
+
+        ++records_read_;
+        count(&ReaderStats::records_read_, !isEOF());
+        line_ += !isEOF();
+        const Record& record = Quoting::None != quoting_ ? getNextQuotedRecord<build_record>() : getNextRecord<build_record>();
+        count(&ReaderStats::fields_, record.size());
+        if (Filtered::Unknown == filtered && !record.empty() && !passesFilters(record)) {
+            count(&ReaderStats::records_filtered_);
+            continue;
+        }
+        // at eof the record is empty: that's not a bad row
+        if (!expected_fields_ || record.size() == expected_fields_ || record.empty())
+            return record;
+        // the 1st field missing, or the 1st extra one
+        badRecord(ParseError::Kind::FieldCount, std::min(record.size(), expected_fields_));
+    }
+}
+
+const ElegentFileReader::Record& __vectorcall ElegentFileReader::readPreviousRecord()
+{
+    ENSURE(isOpen());
+    ENSURE(Quoting::None == quoting_);
+    ENSURE(InputSource::unknown_size != file_size_);
+    if (InputSource::unknown_size == backward_pos_) // opened before the size was known
+        backward_pos_ = file_size_;
+
+    for (;;) {
+        if (0 == backward_pos_) {
+            record_.clear();
+            return record_;
+        }
+        const uint64_t record_begin = previousRecordStart(backward_pos_);
+        seek(record_begin); // and the backward position with it
+        ++records_read_;
+        count(&ReaderStats::records_read_);
+        ++line_;
+        const Record& record = getNextRecord<build_record>();
+        count(&ReaderStats::fields_, record.size());
+        if (!filters_.empty() && !passesFilters(record)) {
+            count(&ReaderStats::records_filtered_);
+            continue;
+        }
+        if (!expected_fields_ || record.size() == expected_fields_)
+            return record;
+        badRecord(ParseError::Kind::FieldCount, std::min(record.size(), expected_fields_));
+    }
+}
+
+std::vector<std::vector<std::string>> __vectorcall ElegentFileReader::tail(const size_t n)
+{
+    std::vector<std::vector<std::string>> records;
+    seek(file_size_);
+    while (records.size() < n) {
+        const Record& record = readPreviousRecord();
+        if (record.empty())
+            break;
+        records.emplace_back(record.begin(), record.end());
+    }
+    std::reverse(records.begin(), records.end());
+    return records;
+}
+
+/// backwards: the start of the record with the byte before end in it - just after the LF before that record, or 0
+uint64_t __vectorcall ElegentFileReader::previousRecordStart(uint64_t end)
+{
+    if (end && LF == *backwardBlock(end - 1))
+        --end; // its own line end
+    while (end) {
+        const char* const byte = backwardBlock(end - 1);
+        const char* const block = byte - (end - 1 - backward_block_pos_);
+        for (const char* p = byte + 1; p-- != block;)
+            if (LF == *p)
+                return backward_block_pos_ + (p - block) + 1;
+        end = backward_block_pos_;
+    }
+    return 0;
+}
+
+/// the byte at offset, from the read_size block it is in (kept: going backwards, the next record is likely in it too)
+const char* __vectorcall ElegentFileReader::backwardBlock(const uint64_t offset)
+{
+    if (backward_block_.empty() || offset < backward_block_pos_ || offset >= backward_block_pos_ + backward_block_.size()) {
+        trace::Span span("readBlockBackward");
+        backward_block_pos_ = offset / read_size_ * read_size_;
+        backward_block_.resize(read_size_);
+        backward_block_.resize(source_->read(backward_block_pos_, backward_block_.data(), read_size_));
+        span.arg("bytes", backward_block_.size());
+        count(&ReaderStats::blocks_read_);
+        count(&ReaderStats::bytes_read_, backward_block_.size());
+        if (offset >= backward_block_pos_ + backward_block_.size())
+            throw std::exception("error on read: the file is shorter than its size");
+    }
+    return backward_block_.data() + (offset - backward_block_pos_);
+}
+
+bool __vectorcall ElegentFileReader::RowFilter::passes(const std::string_view field) const
+{
+    switch (kind_) {
+    case Kind::Equals:
+        return field == values_.front();
+    case Kind::StartsWith:
+        return field.substr(0, values_.front().size()) == values_.front();
+    default:
+        return std::binary_search(values_.begin(), values_.end(), field);
+    }
+}
+
+void __vectorcall ElegentFileReader::whereEquals(const size_t field, std::string value)
+{
+    addFilter(RowFilter{field, RowFilter::Kind::Equals, {std::move(value)}});
+}
+
+void __vectorcall ElegentFileReader::whereStartsWith(const size_t field, std::string prefix)
+{
+    addFilter(RowFilter{field, RowFilter::Kind::StartsWith, {std::move(prefix)}});
+}
+
+void __vectorcall ElegentFileReader::whereIn(const size_t field, std::vector<std::string> values)
+{
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    addFilter(RowFilter{field, RowFilter::Kind::In, std::move(values)});
+}
+
+void __vectorcall ElegentFileReader::clearFilters()
+{
+    filters_.clear();
+}
+
+void __vectorcall ElegentFileReader::addFilter(RowFilter&& filter)
+{
+    ENSURE(filter.field_, <, max_fields_requested_);
+    // by field: the raw check finds the fields in one pass along the record
+    const auto at = std::upper_bound(filters_.begin(), filters_.end(), filter.field_,
+                                     [](const size_t field, const RowFilter& f) { return field < f.field_; });
+    filters_.insert(at, std::move(filter));
+}
+
+/// the filters on the bytes of the next record, when it is all in the buffer (up to its LF, or the end of the file):
+/// Out (and skipped over), In, or Unknown (to be split into fields, then checked)
+ElegentFileReader::Filtered __vectorcall ElegentFileReader::filterRawRecord()
+{
+    if (Quoting::None != quoting_ || multiple_delimiters_as_one_ || isEOF() || pos_ >= buffer_.size() || ftell() < split_until_)
+        return Filtered::Unknown;
+
+    const char* const begin = buffer_.data() + pos_;
+    const char* const buffer_end = buffer_.data() + buffer_.size();
+    const char* const lf = static_cast<const char*>(std::memchr(begin, LF, buffer_end - begin));
+    if (!lf && pos_of_buffer_in_file_ + buffer_.size() < file_size_)
+        return Filtered::Unknown; // the rest of it is in the next block
+    const char* const next = lf ? lf + 1 : buffer_end;
+    const char* const end = lf && lf > begin && CR == lf[-1] ? lf - 1 : lf ? lf : buffer_end;
+
+    const char* field_begin = begin;
+    size_t field = 0;
+    for (const RowFilter& filter : filters_) {
+        for (; field < filter.field_; ++field) {
+            const char* const delimiter = static_cast<const char*>(std::memchr(field_begin, delimiter_, end - field_begin));
+            if (!delimiter)
+                goto filtered_out; // not that many fields
+            field_begin = delimiter + 1;
+        }
+        const char* field_end = field + 1 < max_fields_requested_
+            ? static_cast<const char*>(std::memchr(field_begin, delimiter_, end - field_begin)) : nullptr;
+        if (!field_end)
+            field_end = end;
+        if (!filter.passes(std::string_view(field_begin, field_end - field_begin)))
+            goto filtered_out;
+    }
+    return Filtered::In;
+
+filtered_out:
+    restoreEolCharacter(); // of the record before
+    pos_ = next - buffer_.data();
+    pos_of_record_in_buffer_ = pos_;
+    eof_ = ftell() == file_size_;
+    return Filtered::Out;
+}
+
+bool __vectorcall ElegentFileReader::passesFilters(const Record& record) const
+{
+    for (const RowFilter& filter : filters_)
+        if (filter.field_ >= record.size() || !filter.passes(record[filter.field_]))
+            return false;
+    return true;
+}
+
+void __vectorcall ElegentFileReader::setErrorPolicy(const OnError on_error, const size_t expected_fields, const size_t log_capacity)
+{
+    ENSURE(expected_fields, <=, max_fields_requested_);
+    errors_ = ErrorLog(on_error, log_capacity);
+    expected_fields_ = expected_fields;
+}
+
+void __vectorcall ElegentFileReader::badRecord(const ParseError::Kind kind, const size_t field)
+{
+    errors_.add(ParseError{kind, recordOffset(), line_known_ ? line_ : 0, field});
+}
+
+std::string_view __vectorcall ElegentFileReader::utf8Field(const size_t field)
+{
+    ENSURE(field, <, record_.size());
+    const char* const text = record_[field];
+    if (Encoding::ShiftJis != encoding_ || buffer_is_ascii_)
+        return text;
+
+    const size_t length = strlen(text);
+    if (IsAscii(text, length))
+        return std::string_view(text, length);
+
+    // sized for the whole record on its 1st transcoding, so a later field can't move the text of an earlier one
+    if (transcoded_.size() < record_.size())
+        transcoded_.resize(record_.size());
+    TranscodedField& transcoded = transcoded_[field];
+    if (transcoded.record_number_ != records_read_) {
+        transcoded.text_.clear();
+        ShiftJisToUtf8(text, length, transcoded.text_);
+        transcoded.record_number_ = records_read_;
+    }
+    return transcoded.text_;
 }
 
 
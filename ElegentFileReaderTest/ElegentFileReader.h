@@ -1,22 +1,68 @@
 #pragma once
 
-#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include "BufferPool.h"
 #include "Ensure.h"
+#include "InputSource.h"
+#include "ParseErrors.h"
+#include "TextEncoding.h"
 
 inline uint64_t operator"" _Kb(uint64_t size)
 {
     return 1024 * size;
 }
 
+// build with ELEGENT_READER_STATS=1 to count what the readers do (see ReaderStats); off, the counting isn't compiled in
+#if !defined(ELEGENT_READER_STATS)
+#define ELEGENT_READER_STATS 0
+#endif
+
+/// What a reader has done since it was opened - for sizing read_size: how often records straddle blocks, how much is copied.
+/// Only counted when ELEGENT_READER_STATS is 1; otherwise it stays all 0.
+struct ReaderStats {
+    uint64_t bytes_read_ = 0;
+    uint64_t blocks_read_ = 0;           // readBlock() calls
+    uint64_t partial_records_ = 0;       // blocks read to finish a record started in the previous one
+    uint64_t partial_record_bytes_ = 0;  // moved to the front of the buffer for them
+    uint64_t buffer_reallocations_ = 0;
+    uint64_t field_pointer_fixups_ = 0;  // field pointers adjusted after a move or a reallocation
+    uint64_t records_read_ = 0;
+    uint64_t records_skipped_ = 0;
+    uint64_t records_filtered_ = 0;      // left out by the row filters
+    uint64_t fields_ = 0;                // in the records read
+    uint64_t seeks_in_buffer_ = 0;       // no read needed
+    uint64_t seeks_outside_buffer_ = 0;
+};
+
 class ElegentFileReader {
-    using Buffer = std::vector<char>;
+    using Buffer = BufferPool::Buffer;
 
 public:
-    using Record = std::vector<const char*>;
+    using Record = BufferPool::Record;
 
-    explicit ElegentFileReader(uint32_t read_size, char delimiter, bool as_one = false, size_t max_fields = -1);
+    /// what the bytes in the file are
+    ///     Unchecked: taken as they are (the default)
+    ///     Utf8:      every block is validated as it is read; invalid utf-8 throws
+    ///     ShiftJis:  code page 932; utf8Field() transcodes a field when it is asked for, the rest are never touched
+    ///                (a Shift-JIS trail byte can be 0x40 - 0xFC, so the delimiter must be below that)
+    enum class Encoding : uint8_t { Unchecked, Utf8, ShiftJis };
+
+    /// Rfc4180: a field may be in double quotes, and then can have delimiters, line ends and doubled quotes ("") in it.
+    ///     The quotes are taken off and "" becomes "; text after the closing quote is kept as it is.
+    ///     Records are found a 64 byte chunk at a time: bitmasks of the quotes, delimiters and LFs, with a prefix XOR
+    ///     (carry-less multiply) of the quotes giving the bytes inside quotes, carried from chunk to chunk.
+    ///     seek() keeps its meaning, but the position is taken to be outside quotes: seek to the start of a record
+    ///     (from ftell() or a CSVFileIndex) and the read is exact. After a seek to any other position, skipRecord()
+    ///     resyncs on the next LF; if that LF is in a quoted field, the records will be out of step until the
+    ///     quotes balance again. Records already read have been unescaped in the buffer, so a seek back re-reads the block.
+    enum class Quoting : uint8_t { None, Rfc4180 };
+
+    explicit ElegentFileReader(uint32_t read_size, char delimiter, bool as_one = false, size_t max_fields = -1,
+                               Encoding encoding = Encoding::Unchecked, Quoting quoting = Quoting::None);
 
     explicit ElegentFileReader(const char delimiter) : ElegentFileReader(static_cast<uint32_t>(4_Kb), delimiter)
     { }
@@ -29,18 +75,70 @@ public:
         : ElegentFileReader('\t')
     { }
 
-    ~ElegentFileReader() = default;
+    ~ElegentFileReader();
 
+    /// a gzip or zstd file is decompressed as it is read (see CompressedSource)
     void __vectorcall open(const char* filename);
+    /// memory, a pipe, pread, mmap (see InputSource.h); the reader owns the source until close()
+    void __vectorcall open(std::unique_ptr<InputSource> source);
     void __vectorcall close();
+    /// close() and open another file, keeping the buffers and their capacity: for opening small files over and over
+    void __vectorcall reopen(const char* filename);
+    void __vectorcall reopen(std::unique_ptr<InputSource> source);
     void __vectorcall seek(uint64_t filepos_requested);
 
     const Record& __vectorcall readRecord();
     void __vectorcall skipRecord();
 
+    /// Backwards: the record before the backward position, which then moves back to its start. open() puts the
+    /// position at the end of the file, seek() where it seeks to; readRecord() and skipRecord() don't move it.
+    /// Empty at the start of the file. Record starts are found scanning blocks backwards for LFs, and the record is then
+    /// read forwards, so CRLF, a last record without a line end, max_fields and bad rows all go as they do forwards.
+    /// Not in quoted mode (a LF in quotes can't be told from one outside them going backwards), nor on a stream.
+    const Record& __vectorcall readPreviousRecord();
+    /// the last n records (fewer if the file has fewer), in file order; copied, as reading them backwards moves on.
+    /// Afterwards the backward position is at the first of them
+    std::vector<std::vector<std::string>> __vectorcall tail(size_t n);
+
+    /// Bad rows: with expected_fields (not 0), readRecord() checks every record has that many fields (after max_fields),
+    /// and one that doesn't is thrown on, or skipped (and logged), as on_error says. Kept by close(); open() clears the log.
+    void __vectorcall setErrorPolicy(OnError on_error, size_t expected_fields = 0, size_t log_capacity = 1000);
+    const ErrorLog& errors() const
+    {
+        return errors_;
+    }
+    /// Row filters: readRecord() (and readPreviousRecord()) only give records that every filter passes. They are checked
+    /// on the bytes in the buffer before the record is split into fields, so a row filtered out costs a search for its
+    /// LF, and for the delimiters up to the field. A record straddling two blocks, in quoted or as_one mode, or read
+    /// again after a seek() back, is split first and checked after. A record without the field doesn't pass; a row filtered out is never a bad row.
+    /// skipRecord() skips any record. Kept by close().
+    void __vectorcall whereEquals(size_t field, std::string value);
+    void __vectorcall whereStartsWith(size_t field, std::string prefix);
+    void __vectorcall whereIn(size_t field, std::vector<std::string> values);
+    void __vectorcall clearFilters();
+
+    /// for the code using the records (e.g. CSVFileIndex) to report the current record as bad:
+    /// throws, or logs it - the caller should then skip it
+    void __vectorcall badRecord(ParseError::Kind, size_t field);
+
+    /// Share buffers with other readers: open() takes them from the pool (if this reader has none), close() and the
+    /// destructor give them back, so a reader made for each small file doesn't allocate and fault in its buffers each time.
+    /// The pool must outlive the reader; nullptr to stop. Kept by close().
+    void __vectorcall setBufferPool(BufferPool* pool);
+
     bool __vectorcall isOpen() const
     {
-        return ifs_.is_open();
+        return source_ != nullptr;
+    }
+
+    /// a field of the current record as utf-8
+    /// only Shift-JIS fields with non-ASCII characters are transcoded (once per record); the result is valid until the next record
+    std::string_view __vectorcall utf8Field(size_t field);
+
+    /// true if the whole buffer (so the current record) is known to be ASCII; never true for Encoding::Unchecked
+    bool isAsciiBuffer() const
+    {
+        return buffer_is_ascii_;
     }
 
     uint64_t ftell() const
@@ -48,13 +146,52 @@ public:
         return pos_of_buffer_in_file_ + pos_;
     }
 
+    /// where the record last read starts: after any bad rows readRecord() skipped to get to it
+    uint64_t recordOffset() const
+    {
+        return pos_of_buffer_in_file_ + pos_of_record_in_buffer_;
+    }
+
+    /// InputSource::unknown_size for a stream, until its last block is read
+    uint64_t fileSize() const
+    {
+        return file_size_;
+    }
+
     bool isEOF() const
     {
         return eof_;
         //return ftell() == file_size_;
     }
 
+    const ReaderStats& stats() const
+    {
+        return stats_;
+    }
+
 private:
+    static constexpr bool collecting_stats = ELEGENT_READER_STATS != 0;
+
+    template <bool = collecting_stats>
+    void __vectorcall count(uint64_t ReaderStats::*, uint64_t = 1)
+    {} // specialized case in cpp
+
+    BufferPool::Buffers __vectorcall reset();
+
+    struct RowFilter {
+        enum class Kind : uint8_t { Equals, StartsWith, In };
+        size_t field_;
+        Kind kind_;
+        std::vector<std::string> values_; // In: sorted
+
+        bool __vectorcall passes(std::string_view field) const;
+    };
+    enum class Filtered : uint8_t { In, Out, Unknown };
+
+    void __vectorcall addFilter(RowFilter&&);
+    Filtered __vectorcall filterRawRecord();
+    bool __vectorcall passesFilters(const Record&) const;
+
     bool __vectorcall foundDelimiter() const;
     bool __vectorcall foundDelimiterOr_0() const;
     void __vectorcall restoreEolCharacter();
@@ -95,8 +232,19 @@ private:
     template <bool>
     const Record& __vectorcall getNextRecord();
 
+    void __vectorcall checkEncoding(size_t block_begin);
+
+    uint64_t __vectorcall previousRecordStart(uint64_t end);
+    const char* __vectorcall backwardBlock(uint64_t offset);
+
+    template <bool>
+    const Record& __vectorcall getNextQuotedRecord();
+    template <bool>
+    void __vectorcall splitQuotedRecord(size_t, size_t)
+    {} // specialized case in cpp
+
     uint64_t file_size_;
-    std::ifstream ifs_;
+    std::unique_ptr<InputSource> source_;
     const uint32_t read_size_;
 
     Buffer buffer_;
@@ -111,6 +259,36 @@ private:
     const size_t max_fields_requested_;
     Record record_;
 
+    struct TranscodedField {
+        uint64_t record_number_ = 0;
+        std::string text_;
+    };
+
+    const Encoding encoding_;
+    Utf8Validator utf8_validator_;
+    bool buffer_is_ascii_;
+    bool resync_utf8_; // after a seek, the next block may start part way through a character
+    uint64_t records_read_;
+    std::vector<TranscodedField> transcoded_; // by field; the record_number_ says if it is for the current record
+
+    const Quoting quoting_;
+    std::vector<uint32_t> separators_; // quoted mode: the delimiters outside quotes, as offsets into the record
+
+    uint64_t line_;    // of the current record: records read or skipped since the start of the file
+    bool line_known_;  // not after a seek() to the middle of the file
+    size_t expected_fields_;
+    ErrorLog errors_;
+    std::vector<RowFilter> filters_; // by field
+    uint64_t split_until_;           // after a seek() back in the buffer: the records before it are split (delimiters nulled)
+
+    BufferPool* pool_;
+
+    uint64_t backward_pos_;           // where readPreviousRecord() reads back from
+    std::vector<char> backward_block_; // the last block scanned backwards for LFs
+    uint64_t backward_block_pos_;      // in the file, of backward_block_[0]
+
+    ReaderStats stats_;
+
     friend class ElegentFileReader_SmallFile_Test;
     friend class FileReaderTest_TestPrivateInterface_Test;
 
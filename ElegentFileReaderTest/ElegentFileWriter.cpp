@@ -0,0 +1,236 @@
+#include "pch.h"
+
+#include "ElegentFileWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Ensure.h"
+#include "Trace.h"
+
+namespace {
+const char unicode_signature[] = {'\xEF', '\xBB', '\xBF'};
+}
+
+ElegentFileWriter::ElegentFileWriter(const uint32_t block_size, const char delimiter, const LineEnd line_end,
+                                     const bool unicode_signature, const bool write_behind)
+    : block_size_(block_size),
+      delimiter_(delimiter),
+      line_end_(line_end),
+      unicode_signature_(unicode_signature),
+      write_behind_(write_behind)
+{
+    // room for a number and its delimiter, and for a line end, in an empty block
+    ENSURE(block_size, >, max_number_length);
+}
+
+ElegentFileWriter::~ElegentFileWriter()
+{
+    try {
+        if (isOpen())
+            close();
+    } catch (...) {
+    }
+}
+
+void __vectorcall ElegentFileWriter::open(const char* const filename)
+{
+    ENSURE(!isOpen());
+    trace::Span span("openForWriting");
+#if defined(_WIN32)
+    const HANDLE handle = ::CreateFileW(std::filesystem::u8path(filename).c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                                       CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (INVALID_HANDLE_VALUE == handle)
+        throw std::exception((std::string("cannot create ") + filename).c_str());
+    handle_ = reinterpret_cast<intptr_t>(handle);
+#else
+    const int fd = ::open(std::filesystem::u8path(filename).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::exception((std::string("cannot create ") + filename).c_str());
+    handle_ = fd;
+#endif
+
+    block_.resize(block_size_);
+    if (write_behind_)
+        behind_.resize(block_size_);
+    used_ = 0;
+    in_record_ = false;
+    bytes_flushed_ = 0;
+    if (unicode_signature_) {
+        std::memcpy(block_.data(), unicode_signature, sizeof(unicode_signature));
+        used_ = sizeof(unicode_signature);
+    }
+}
+
+void __vectorcall ElegentFileWriter::close()
+{
+    ENSURE(isOpen());
+    trace::Span span("closeForWriting");
+    std::exception_ptr error;
+    try {
+        flush();
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // the last block behind, then the thread
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            to_write_.notify_one();
+        }
+        thread_.join();
+        stopping_ = false;
+    }
+    if (!error)
+        error = error_;
+    error_ = nullptr;
+
+#if defined(_WIN32)
+    ::CloseHandle(reinterpret_cast<HANDLE>(handle_));
+#else
+    ::close(static_cast<int>(handle_));
+#endif
+    handle_ = no_handle;
+    used_ = 0;
+    span.arg("bytes", bytes_flushed_);
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/// a delimiter before the field if it isn't the 1st, and room after it for bytes more: flushes the block if need be
+char* __vectorcall ElegentFileWriter::room(const size_t bytes)
+{
+    CHECK(isOpen());
+    if (block_size_ - used_ < bytes + 1)
+        flush();
+    if (in_record_)
+        block_[used_++] = delimiter_;
+    in_record_ = true;
+    return block_.data() + used_;
+}
+
+void __vectorcall ElegentFileWriter::field(std::string_view value)
+{
+    room(std::min<size_t>(value.size(), block_size_ - 1));
+    // a field longer than a block fills as many as it takes
+    for (;;) {
+        const size_t bytes = std::min(value.size(), block_size_ - used_);
+        std::copy_n(value.data(), bytes, block_.data() + used_); // not memcpy: an empty view's data() may be null
+        used_ += bytes;
+        value.remove_prefix(bytes);
+        if (value.empty())
+            break;
+        flush();
+    }
+}
+
+void __vectorcall ElegentFileWriter::field(const double value)
+{
+    char* const at = room(max_number_length);
+    used_ += std::to_chars(at, at + max_number_length, value).ptr - at;
+}
+
+void __vectorcall ElegentFileWriter::endRecord()
+{
+    CHECK(isOpen());
+    if (block_size_ - used_ < 2)
+        flush();
+    if (LineEnd::CrLf == line_end_)
+        block_[used_++] = '\r';
+    block_[used_++] = '\n';
+    in_record_ = false;
+}
+
+void __vectorcall ElegentFileWriter::writeRecord(const ElegentFileReader::Record& record)
+{
+    for (const char* const value : record)
+        field(value);
+    endRecord();
+}
+
+/// the block to the file: handed to the background thread (once it has written the one before), or written here
+void __vectorcall ElegentFileWriter::flush()
+{
+    if (!used_)
+        return;
+    if (write_behind_) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        waitForWriteBehind(lock);
+        if (!thread_.joinable())
+            thread_ = std::thread(&ElegentFileWriter::writeBehind, this);
+        block_.swap(behind_);
+        behind_size_ = used_;
+        to_write_.notify_one();
+    } else {
+        write(block_.data(), used_);
+    }
+    bytes_flushed_ += used_;
+    used_ = 0;
+}
+
+/// until the background thread has written its block; throws what it threw (and keeps it for close())
+void __vectorcall ElegentFileWriter::waitForWriteBehind(std::unique_lock<std::mutex>& lock)
+{
+    written_.wait(lock, [this] { return !behind_size_; });
+    if (error_)
+        std::rethrow_exception(error_);
+}
+
+/// the background thread
+void __vectorcall ElegentFileWriter::writeBehind()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        to_write_.wait(lock, [this] { return behind_size_ || stopping_; });
+        if (!behind_size_)
+            return;
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            write(behind_.data(), behind_size_);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+        if (!error_)
+            error_ = error;
+        behind_size_ = 0;
+        written_.notify_all();
+    }
+}
+
+void __vectorcall ElegentFileWriter::write(const char* const data, const size_t size)
+{
+    trace::Span span("writeBlock");
+    span.arg("bytes", size);
+    size_t written = 0;
+    // a write can come back short (a signal, a network file): carry on from there
+    while (written < size) {
+#if defined(_WIN32)
+        DWORD bytes = 0;
+        const DWORD wanted = static_cast<DWORD>(std::min<size_t>(size - written, 1u << 30));
+        if (!::WriteFile(reinterpret_cast<HANDLE>(handle_), data + written, wanted, &bytes, nullptr))
+            throw std::exception("error on write");
+#else
+        const ssize_t bytes = ::write(static_cast<int>(handle_), data + written, size - written);
+        if (bytes < 0) {
+            if (EINTR == errno)
+                continue;
+            throw std::exception("error on write");
+        }
+#endif
+        written += static_cast<size_t>(bytes);
+    }
+}
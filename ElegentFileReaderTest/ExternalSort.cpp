@@ -0,0 +1,332 @@
+#include "pch.h"
+
+#include "ExternalSort.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <queue>
+#include <system_error>
+
+#include "CompressedSource.h"
+#include "ElegentFileWriter.h"
+#include "Ensure.h"
+#include "InputSource.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+
+namespace score {
+
+namespace {
+const uint64_t min_memory_budget = 64_Kb;
+const uint64_t min_read_size = 4_Kb;
+const uint64_t max_read_size = 4 * 1024_Kb;
+const uint64_t merge_read_size = 64_Kb;   // at least, per run: for the fan in when it isn't given
+const size_t min_rows_per_part = 4096;     // fewer, and a part isn't worth a worker
+
+uint32_t ReadSize(const uint64_t bytes)
+{
+    return static_cast<uint32_t>(std::min(std::max(bytes, min_read_size), max_read_size));
+}
+
+/// what the output keeps of the input: its line end and its unicode signature, from the start of the file
+struct Conventions {
+    ElegentFileWriter::LineEnd line_end_ = ElegentFileWriter::LineEnd::CrLf;
+    bool unicode_signature_ = false;
+};
+
+Conventions InputConventions(InputSource& source)
+{
+    std::vector<char> start(64_Kb);
+    start.resize(source.read(0, start.data(), start.size()));
+    Conventions conventions;
+    conventions.unicode_signature_ = start.size() >= 3 && !memcmp(start.data(), "\xEF\xBB\xBF", 3);
+    const auto lf = std::find(start.begin(), start.end(), '\n');
+    if (lf != start.end() && (lf == start.begin() || '\r' != lf[-1]))
+        conventions.line_end_ = ElegentFileWriter::LineEnd::Lf;
+    return conventions;
+}
+
+/// names the run files, and deletes them with it (if they're still there)
+class RunFiles {
+public:
+    RunFiles(const char* output, const std::string& directory)
+        : prefix_(((directory.empty() ? std::filesystem::u8path(output).parent_path() : std::filesystem::u8path(directory))
+                   / std::filesystem::u8path(output).filename()).string() + ".run")
+    {
+    }
+    ~RunFiles()
+    {
+        for (const auto& path : made_)
+            Remove(path);
+    }
+    RunFiles(const RunFiles&) = delete;
+    RunFiles& operator=(const RunFiles&) = delete;
+
+    std::string __vectorcall make()
+    {
+        made_.push_back(prefix_ + std::to_string(made_.size()));
+        return made_.back();
+    }
+    static void __vectorcall Remove(const std::string& path)
+    {
+        std::error_code error;
+        std::filesystem::remove(std::filesystem::u8path(path), error);
+    }
+
+private:
+    const std::string prefix_;
+    std::vector<std::string> made_;
+};
+
+/// a budget's worth of records, one after another in an arena: the key fields, each ending in a 0 (so the keys of two
+/// rows compare with a memcmp), then the record, its fields joined by the delimiter
+class Run {
+public:
+    Run(const SortOptions& options, const uint64_t budget)
+        : options_(options),
+          budget_(budget)
+    {
+    }
+
+    bool full() const
+    {
+        return arena_.size() + rows_.size() * sizeof(Row) >= budget_;
+    }
+    bool empty() const
+    {
+        return rows_.empty();
+    }
+    size_t size() const
+    {
+        return rows_.size();
+    }
+
+    void __vectorcall add(const ElegentFileReader::Record& record)
+    {
+        Row row{arena_.size(), 0, 0};
+        for (const size_t key : options_.keys_) {
+            if (key < record.size())
+                arena_.insert(arena_.end(), record[key], record[key] + strlen(record[key]));
+            arena_.push_back(0);
+        }
+        row.key_size_ = static_cast<uint32_t>(arena_.size() - row.offset_);
+        for (size_t field = 0; field < record.size(); ++field) {
+            if (field)
+                arena_.push_back(options_.delimiter_);
+            arena_.insert(arena_.end(), record[field], record[field] + strlen(record[field]));
+        }
+        row.record_size_ = static_cast<uint32_t>(arena_.size() - row.offset_ - row.key_size_);
+        rows_.push_back(row);
+    }
+
+    /// a part of the rows per worker, each sorted on its own; write() merges them
+    void __vectorcall sort(WorkerPool& pool)
+    {
+        trace::Span span("sortRun");
+        span.arg("rows", rows_.size());
+        const size_t parts = std::max<size_t>(1, std::min(pool.size(), rows_.size() / min_rows_per_part));
+        parts_.clear();
+        for (size_t part = 0; part <= parts; ++part)
+            parts_.push_back(rows_.size() * part / parts);
+        const auto less = [this](const Row& a, const Row& b) { return this->less(a, b); };
+        if (1 == parts) {
+            std::stable_sort(rows_.begin(), rows_.end(), less);
+            return;
+        }
+        pool.run([&](const size_t worker) {
+            if (worker < parts)
+                std::stable_sort(rows_.begin() + parts_[worker], rows_.begin() + parts_[worker + 1], less);
+        });
+    }
+
+    /// the records in order, and empties the run
+    void __vectorcall write(ElegentFileWriter& writer)
+    {
+        trace::Span span("writeRun");
+        // the next row of each part; on a tie the earlier part's goes 1st, as in the input
+        std::vector<size_t> next(parts_.begin(), parts_.end() - 1);
+        const auto after = [&](const size_t a, const size_t b) {
+            return less(rows_[next[b]], rows_[next[a]]) || (!less(rows_[next[a]], rows_[next[b]]) && a > b);
+        };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(after)> heap(after);
+        for (size_t part = 0; part < next.size(); ++part)
+            if (next[part] < parts_[part + 1])
+                heap.push(part);
+        while (!heap.empty()) {
+            const size_t part = heap.top();
+            heap.pop();
+            const Row& row = rows_[next[part]];
+            writer.field(std::string_view(arena_.data() + row.offset_ + row.key_size_, row.record_size_));
+            writer.endRecord();
+            if (++next[part] < parts_[part + 1])
+                heap.push(part);
+        }
+        arena_.clear();
+        rows_.clear();
+    }
+
+private:
+    struct Row {
+        uint64_t offset_;
+        uint32_t key_size_;
+        uint32_t record_size_;
+    };
+
+    bool less(const Row& a, const Row& b) const
+    {
+        const int compared = memcmp(arena_.data() + a.offset_, arena_.data() + b.offset_, std::min(a.key_size_, b.key_size_));
+        return compared ? compared < 0 : a.key_size_ < b.key_size_;
+    }
+
+    const SortOptions& options_;
+    const uint64_t budget_;
+    std::vector<char> arena_;
+    std::vector<Row> rows_;
+    std::vector<size_t> parts_; // the rows of part i are [parts_[i], parts_[i + 1])
+};
+
+/// the runs into the writer: a reader per run, with the current record of each in a heap (a record stays good till
+/// its reader reads the next)
+void MergeRuns(const std::vector<std::string>& runs, ElegentFileWriter& writer, const SortOptions& options,
+               const uint32_t read_size, uint64_t& records)
+{
+    trace::Span span("mergeRuns");
+    span.arg("runs", runs.size());
+    std::vector<std::unique_ptr<ElegentFileReader>> readers;
+    std::vector<const ElegentFileReader::Record*> current(runs.size());
+    const auto compare = [&](const size_t a, const size_t b) {
+        for (const size_t key : options.keys_) {
+            const int compared = strcmp(key < current[a]->size() ? (*current[a])[key] : "",
+                                        key < current[b]->size() ? (*current[b])[key] : "");
+            if (compared)
+                return compared;
+        }
+        return 0;
+    };
+    // on a tie the earlier run's record goes 1st, as in the input
+    const auto after = [&](const size_t a, const size_t b) {
+        const int compared = compare(a, b);
+        return compared ? compared > 0 : a > b;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(after)> heap(after);
+    for (size_t run = 0; run < runs.size(); ++run) {
+        readers.push_back(std::make_unique<ElegentFileReader>(read_size, options.delimiter_));
+        readers.back()->open(runs[run].c_str());
+        if (!readers.back()->isEOF()) {
+            current[run] = &readers.back()->readRecord();
+            heap.push(run);
+        }
+    }
+    while (!heap.empty()) {
+        const size_t run = heap.top();
+        heap.pop();
+        writer.writeRecord(*current[run]);
+        ++records;
+        if (!readers[run]->isEOF()) {
+            current[run] = &readers[run]->readRecord();
+            heap.push(run);
+        }
+    }
+}
+}
+
+SortStats __vectorcall SortFile(const char* const input, const char* const output, const SortOptions& options)
+{
+    ENSURE(!options.keys_.empty());
+    ENSURE(options.memory_budget_, >=, min_memory_budget);
+    ENSURE(options.merge_fan_in_ != 1);
+    trace::Span span("sortFile");
+    SortStats stats;
+
+    // a 16th of the budget each for the reader's buffer and the writer's two blocks, the rest for the rows
+    const uint32_t block_size = ReadSize(options.memory_budget_ / 16);
+    std::unique_ptr<InputSource> source = OpenInput(input);
+    const Conventions conventions = InputConventions(*source);
+    ElegentFileReader reader(block_size, options.delimiter_);
+    reader.open(std::move(source));
+    const bool has_header = options.header_ && !reader.isEOF();
+    std::string header;
+    if (has_header) {
+        const auto& record = reader.readRecord();
+        for (size_t field = 0; field < record.size(); ++field)
+            header.append(field ? 1 : 0, options.delimiter_).append(record[field]);
+    }
+    const auto open_output = [&](ElegentFileWriter& writer) {
+        writer.open(output);
+        if (has_header) {
+            writer.field(header);
+            writer.endRecord();
+        }
+    };
+
+    // sorted runs, spilled - unless it all fits
+    WorkerPool pool(options.workers_);
+    Run run(options, options.memory_budget_ - 3 * block_size);
+    RunFiles run_files(output, options.temp_directory_);
+    std::vector<std::string> runs; // in input order
+    while (!reader.isEOF()) {
+        while (!reader.isEOF() && !run.full()) {
+            const auto& record = reader.readRecord();
+            if (!record.empty())
+                run.add(record);
+        }
+        stats.records_ += run.size();
+        run.sort(pool);
+        if (runs.empty() && reader.isEOF()) {
+            ElegentFileWriter writer(block_size, options.delimiter_, conventions.line_end_, conventions.unicode_signature_);
+            open_output(writer);
+            run.write(writer);
+            writer.close();
+            return stats;
+        }
+        ElegentFileWriter writer(block_size, options.delimiter_, ElegentFileWriter::LineEnd::Lf);
+        runs.push_back(run_files.make());
+        writer.open(runs.back().c_str());
+        run.write(writer);
+        writer.close();
+    }
+    stats.runs_ = runs.size();
+    reader.close();
+    if (runs.empty()) { // just the header, if that
+        ElegentFileWriter writer(block_size, options.delimiter_, conventions.line_end_, conventions.unicode_signature_);
+        open_output(writer);
+        writer.close();
+        return stats;
+    }
+
+    // merged a fan in's worth at a time (in order, so the sort stays stable) till one pass will do them all
+    const size_t fan_in = options.merge_fan_in_
+        ? options.merge_fan_in_ : std::max<size_t>(2, (options.memory_budget_ - 2 * block_size) / merge_read_size);
+    for (;;) {
+        ++stats.merge_passes_;
+        const size_t merges = (runs.size() + fan_in - 1) / fan_in;
+        const uint32_t read_size = ReadSize((options.memory_budget_ - 2 * block_size) / std::min(fan_in, runs.size()));
+        uint64_t records = 0;
+        if (merges <= 1) {
+            ElegentFileWriter writer(block_size, options.delimiter_, conventions.line_end_, conventions.unicode_signature_);
+            open_output(writer);
+            MergeRuns(runs, writer, options, read_size, records);
+            writer.close();
+            CHECK(records, ==, stats.records_);
+            return stats;
+        }
+
+        std::vector<std::string> merged;
+        for (size_t first = 0; first < runs.size(); first += fan_in) {
+            const std::vector<std::string> group(runs.begin() + first, runs.begin() + std::min(first + fan_in, runs.size()));
+            merged.push_back(run_files.make());
+            ElegentFileWriter writer(block_size, options.delimiter_, ElegentFileWriter::LineEnd::Lf);
+            writer.open(merged.back().c_str());
+            MergeRuns(group, writer, options, read_size, records);
+            writer.close();
+            for (const auto& path : group)
+                RunFiles::Remove(path);
+        }
+        runs.swap(merged);
+    }
+}
+
+}
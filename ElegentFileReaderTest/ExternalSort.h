@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "ElegentFileReader.h"
+
+namespace score {
+
+/// Sorts a .tbl/.csv by key fields in a fixed amount of memory - e.g. an unsorted extract, before a CSVFileIndex
+/// (which needs all the records of a key together).
+/// The records are read a budget's worth at a time, copied into one arena; the rows are sorted on a WorkerPool (a part
+/// per worker, merged as they're written) and spilled to a run file. The runs are then merged, reading them through
+/// ElegentFileReaders with large buffers, into the output. Input that fits in the budget is sorted straight to the output.
+/// The keys compare as byte strings, field by field (a missing one as empty); the sort is stable. The output keeps the
+/// input's conventions: the header first, the delimiter, CRLF or LF (from the 1st line end), the unicode signature.
+/// Fields aren't quoted (Quoting::None): a record is written back as its fields joined by the delimiter.
+struct SortOptions {
+    std::vector<size_t> keys_;              // the fields to sort by, most significant 1st
+    char delimiter_ = '\t';
+    bool header_ = true;                    // the 1st record is a header: it stays 1st
+    uint64_t memory_budget_ = 256 * 1024_Kb; // bytes, for the rows and the buffers
+    size_t workers_ = 0;                    // sorting a run; 0 is one per logical cpu
+    std::string temp_directory_;            // for the runs; empty: the output's directory
+    size_t merge_fan_in_ = 0;               // the most runs merged at once; 0: as many as the budget allows
+};
+
+struct SortStats {
+    uint64_t records_ = 0; // without the header
+    size_t runs_ = 0;      // spilled: 0 if it all fitted in memory
+    size_t merge_passes_ = 0;
+};
+
+/// input and output must be different files; throws std::exception if one can't be read or written
+SortStats __vectorcall SortFile(const char* input, const char* output, const SortOptions& options);
+
+}
@@ -0,0 +1,237 @@
+#include "pch.h"
+
+#include "FixedWidthFileReader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <utility>
+
+#include "Ensure.h"
+
+namespace {
+const char CR = '\r';
+const char LF = '\n';
+const char comment_character = '*';
+const std::string_view position_suffix("_position");
+const std::string_view length_suffix("_length");
+const std::string_view unicode_signature("\xEF\xBB\xBF");
+
+bool EndsWith(const std::string_view text, const std::string_view suffix)
+{
+    return text.size() > suffix.size() && text.substr(text.size() - suffix.size()) == suffix;
+}
+
+/// a config value; the last field in the line may have trailing spaces
+uint32_t ParseConfigNumber(const std::string_view key, const char* const value)
+{
+    const char* const end = value + strlen(value);
+    uint32_t result = 0;
+    const auto converted = std::from_chars(value, end, result);
+    bool valid = converted.ec == std::errc() && converted.ptr != value;
+    for (auto p = converted.ptr; valid && p != end; ++p)
+        valid = ' ' == *p;
+    if (!valid)
+        throw std::exception((std::string("invalid number for ") + std::string(key) + ": " + value).c_str());
+    return result;
+}
+}
+
+/// the run config has, for each field in the inforce file:
+///     product_position         0
+///     product_length           8
+/// a column is defined by its _position; the _length defaults to 0 (i.e. the field is not in the file)
+FixedWidthFileReader::Layout __vectorcall FixedWidthFileReader::layoutFromConfig(const char* const config_filename)
+{
+    ElegentFileReader config(static_cast<uint32_t>(4_Kb), ' ', true, 2);
+    config.open(config_filename);
+
+    Layout layout;
+    std::vector<std::pair<std::string, uint32_t>> lengths;
+    while (!config.isEOF()) {
+        const auto& record = config.readRecord();
+        if (record.size() < 2 || comment_character == *record[0])
+            continue;
+
+        const std::string_view key(record[0]);
+        if (EndsWith(key, position_suffix)) {
+            Column column;
+            column.name_ = key.substr(0, key.size() - position_suffix.size());
+            column.position_ = ParseConfigNumber(key, record[1]);
+            layout.push_back(column);
+        } else if (EndsWith(key, length_suffix)) {
+            lengths.emplace_back(key.substr(0, key.size() - length_suffix.size()), ParseConfigNumber(key, record[1]));
+        }
+    }
+
+    for (auto& column : layout)
+        for (const auto& length : lengths)
+            if (length.first == column.name_)
+                column.length_ = length.second;
+    return layout;
+}
+
+FixedWidthFileReader::FixedWidthFileReader(Layout layout, const bool fixed_length_records, const uint32_t read_size)
+    : layout_(std::move(layout)),
+      fixed_length_records_(fixed_length_records),
+      read_size_(read_size),
+      file_size_(0),
+      first_record_in_file_(0),
+      record_length_(0),
+      pos_(0),
+      pos_of_buffer_in_file_(0)
+{
+    ENSURE(read_size, >, 0);
+}
+
+void __vectorcall FixedWidthFileReader::open(const char* const filename)
+{
+    ENSURE(!isOpen());
+
+    ifs_.open(std::filesystem::u8path(filename), std::ios::binary);
+    if (!ifs_ || !isOpen()) {
+        ifs_.clear();
+        throw std::exception((std::string("cannot open ") + filename).c_str());
+    }
+    file_size_ = std::filesystem::file_size(std::filesystem::u8path(filename));
+
+    // skip over the unicode signature
+    while (buffer_.size() < unicode_signature.size() && readBlock())
+        ;
+    if (std::string_view(buffer_.data(), buffer_.size()).substr(0, unicode_signature.size()) == unicode_signature)
+        pos_ = unicode_signature.size();
+    first_record_in_file_ = pos_;
+
+    if (fixed_length_records_)
+        detectRecordLength();
+}
+
+void __vectorcall FixedWidthFileReader::close()
+{
+    if (ifs_.is_open())
+        ifs_.close();
+    ifs_.clear();
+
+    Buffer().swap(buffer_);
+    file_size_ = 0;
+    first_record_in_file_ = 0;
+    record_length_ = 0;
+    pos_ = 0;
+    pos_of_buffer_in_file_ = 0;
+    record_ = std::string_view();
+}
+
+/// move the unread part of the buffer to the front and append the next block
+/// returns false at the end of the file
+bool __vectorcall FixedWidthFileReader::readBlock()
+{
+    const size_t unread = buffer_.size() - pos_;
+    if (pos_ > 0)
+        std::memmove(buffer_.data(), buffer_.data() + pos_, unread);
+    pos_of_buffer_in_file_ += pos_;
+    pos_ = 0;
+
+    buffer_.resize(unread + read_size_);
+    size_t bytes_read = read_size_;
+    if (!ifs_.read(buffer_.data() + unread, read_size_)) {
+        if (ifs_.rdstate() != (std::ios::failbit | std::ios::eofbit))
+            throw std::exception("error on read");
+        ifs_.clear();
+        bytes_read = static_cast<size_t>(ifs_.gcount());
+    }
+    buffer_.resize(unread + bytes_read);
+    return bytes_read > 0;
+}
+
+/// the length of the record at pos_, including its line end
+/// fixed length records are just counted out; otherwise look for the LF
+size_t __vectorcall FixedWidthFileReader::findEndOfRecord()
+{
+    if (record_length_) {
+        while (buffer_.size() - pos_ < record_length_ && readBlock())
+            ;
+        return static_cast<size_t>(std::min<uint64_t>(record_length_, buffer_.size() - pos_));
+    }
+
+    size_t searched = 0;
+    for (;;) {
+        const char* const begin = buffer_.data() + pos_;
+        const size_t available = buffer_.size() - pos_;
+        if (const void* lf = memchr(begin + searched, LF, available - searched))
+            return static_cast<const char*>(lf) - begin + 1;
+        searched = available;
+        if (!readBlock())
+            return available; // the last record in the file ended without a LF
+    }
+}
+
+/// all the records are the length of the 1st one
+void __vectorcall FixedWidthFileReader::detectRecordLength()
+{
+    if (isEOF())
+        return;
+    record_length_ = findEndOfRecord();
+}
+
+std::string_view __vectorcall FixedWidthFileReader::readRecord()
+{
+    if (isEOF()) {
+        record_ = std::string_view();
+        return record_;
+    }
+
+    const size_t length = findEndOfRecord();
+    std::string_view record(buffer_.data() + pos_, length);
+    pos_ += length;
+
+    if (!record.empty() && LF == record.back())
+        record.remove_suffix(1);
+    if (!record.empty() && CR == record.back())
+        record.remove_suffix(1);
+    record_ = record;
+    return record_;
+}
+
+size_t __vectorcall FixedWidthFileReader::columnIndex(const std::string_view name) const
+{
+    for (size_t i = 0; i < layout_.size(); ++i)
+        if (layout_[i].name_ == name)
+            return i;
+    throw std::exception((std::string("no column ") + std::string(name) + " in the layout").c_str());
+}
+
+void __vectorcall FixedWidthFileReader::seek(const uint64_t filepos_requested)
+{
+    ENSURE(filepos_requested, <=, file_size_);
+    record_ = std::string_view();
+
+    // still in the buffer: no reading required
+    if (filepos_requested >= pos_of_buffer_in_file_ && filepos_requested <= pos_of_buffer_in_file_ + buffer_.size()) {
+        pos_ = static_cast<size_t>(filepos_requested - pos_of_buffer_in_file_);
+        return;
+    }
+
+    buffer_.clear();
+    pos_ = 0;
+    pos_of_buffer_in_file_ = filepos_requested;
+    ifs_.clear();
+    if (!ifs_.seekg(filepos_requested))
+        throw std::exception("error on seek");
+}
+
+void __vectorcall FixedWidthFileReader::seekToRecord(const uint64_t record_number)
+{
+    ENSURE(record_length_, >, 0);
+    const uint64_t filepos = first_record_in_file_ + record_number * record_length_;
+    ENSURE(filepos, <=, file_size_);
+    seek(filepos);
+}
+
+/// the last record may be short by its line end
+uint64_t FixedWidthFileReader::recordCount() const
+{
+    ENSURE(record_length_, >, 0);
+    return (file_size_ - first_record_in_file_ + record_length_ - 1) / record_length_;
+}
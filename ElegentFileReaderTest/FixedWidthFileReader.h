@@ -0,0 +1,100 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ElegentFileReader.h"
+
+/// Reads fixed width records (legacy inforce extracts) without scanning for delimiters:
+/// each field is a view at a fixed offset and length into the record.
+/// If every record has the same length, records can be addressed directly with seekToRecord().
+class FixedWidthFileReader {
+    using Buffer = std::vector<char>;
+
+public:
+    struct Column {
+        std::string name_;
+        uint32_t position_ = 0; // 0 based offset of the field in the record
+        uint32_t length_ = 0;
+    };
+    using Layout = std::vector<Column>;
+
+    /// build the layout from the <name>_position / <name>_length pairs of a run config
+    static Layout __vectorcall layoutFromConfig(const char* config_filename);
+
+    /// fixed_length_records: every record (including its line end) has the length of the 1st record
+    explicit FixedWidthFileReader(Layout layout, bool fixed_length_records = false, uint32_t read_size = static_cast<uint32_t>(64_Kb));
+
+    void __vectorcall open(const char* filename);
+    void __vectorcall close();
+
+    bool __vectorcall isOpen() const
+    {
+        return ifs_.is_open();
+    }
+
+    /// read the next record; its fields are then available through field()
+    std::string_view __vectorcall readRecord();
+    void __vectorcall skipRecord()
+    {
+        readRecord();
+    }
+
+    /// the field of the current record, by its index in the layout; empty if the record is too short
+    std::string_view __vectorcall field(const size_t column) const
+    {
+        const Column& c = layout_[column];
+        return c.position_ >= record_.size() ? std::string_view() : record_.substr(c.position_, c.length_);
+    }
+
+    /// index into the layout of the named column
+    size_t __vectorcall columnIndex(std::string_view name) const;
+
+    const Layout& layout() const
+    {
+        return layout_;
+    }
+
+    void __vectorcall seek(uint64_t filepos_requested);
+    /// O(1) positioning on the n-th (0 based) record; fixed length records only
+    void __vectorcall seekToRecord(uint64_t record_number);
+
+    /// the length of every record including its line end; 0 if the records are not fixed length
+    uint64_t recordLength() const
+    {
+        return record_length_;
+    }
+
+    uint64_t recordCount() const;
+
+    uint64_t ftell() const
+    {
+        return pos_of_buffer_in_file_ + pos_;
+    }
+
+    bool isEOF() const
+    {
+        return ftell() == file_size_;
+    }
+
+private:
+    bool __vectorcall readBlock();
+    size_t __vectorcall findEndOfRecord();
+    void __vectorcall detectRecordLength();
+
+    const Layout layout_;
+    const bool fixed_length_records_;
+    const uint32_t read_size_;
+
+    std::ifstream ifs_;
+    uint64_t file_size_;
+    uint64_t first_record_in_file_; // after the unicode signature, if there is one
+    uint64_t record_length_;
+
+    Buffer buffer_;
+    size_t pos_;
+    uint64_t pos_of_buffer_in_file_;
+    std::string_view record_;
+};
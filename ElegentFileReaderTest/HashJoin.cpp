@@ -0,0 +1,155 @@
+#include "pch.h"
+
+#include "HashJoin.h"
+
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+
+#include "Ensure.h"
+#include "Trace.h"
+
+namespace score {
+
+namespace {
+uint64_t Hash(const std::string_view key)
+{
+    return std::hash<std::string_view>()(key);
+}
+
+/// a probe record copied out of the reader's buffer: its fields are offsets into the batch's bytes
+struct Pending {
+    uint64_t hash_;
+    uint32_t bytes_;  // where the record is in the batch's bytes
+    uint32_t fields_; // where its field offsets start
+    uint32_t size_;   // fields
+};
+}
+
+HashJoin::HashJoin(const size_t batch)
+    : batch_(batch)
+{
+    ENSURE(batch, >, 0);
+}
+
+void __vectorcall HashJoin::build(ElegentFileReader& small, const size_t key_field, std::vector<size_t> fields)
+{
+    ENSURE(!fields.empty());
+    trace::Span span("hashJoinBuild");
+    fields_ = fields.size();
+    arena_.clear();
+    keys_.clear();
+    field_values_.clear();
+    size_ = 0;
+    duplicates_ = 0;
+
+    // into the arena, as offsets (it moves as it grows) - the pointers once it is all in
+    const size_t needed = std::max(key_field, *std::max_element(fields.begin(), fields.end())) + 1;
+    std::vector<uint32_t> field_offsets;
+    while (!small.isEOF()) {
+        const auto& record = small.readRecord();
+        if (record.size() < needed)
+            continue;
+        keys_.push_back(static_cast<uint32_t>(arena_.size()));
+        arena_.insert(arena_.end(), record[key_field], record[key_field] + strlen(record[key_field]) + 1);
+        for (const size_t field : fields) {
+            field_offsets.push_back(static_cast<uint32_t>(arena_.size()));
+            arena_.insert(arena_.end(), record[field], record[field] + strlen(record[field]) + 1);
+        }
+    }
+    CHECK(arena_.size(), <, uint64_t(no_entry));
+    field_values_.reserve(field_offsets.size());
+    for (const uint32_t offset : field_offsets)
+        field_values_.push_back(arena_.data() + offset);
+
+    size_t slots = 16;
+    while (slots < 2 * keys_.size())
+        slots *= 2;
+    slots_.assign(slots, Slot{0, 0});
+    for (uint32_t entry = 0; entry < keys_.size(); ++entry) {
+        const std::string_view key(arena_.data() + keys_[entry]);
+        const uint64_t hash = Hash(key);
+        if (no_entry != lookup(hash, key)) {
+            ++duplicates_;
+            continue;
+        }
+        size_t slot = hash & (slots_.size() - 1);
+        while (slots_[slot].entry_)
+            slot = (slot + 1) & (slots_.size() - 1);
+        slots_[slot] = Slot{static_cast<uint32_t>(hash >> 32), entry + 1};
+        ++size_;
+    }
+    span.arg("entries", size_);
+}
+
+/// the entry with the key, or no_entry
+uint32_t __vectorcall HashJoin::lookup(const uint64_t hash, const std::string_view key) const
+{
+    const uint32_t tag = static_cast<uint32_t>(hash >> 32);
+    for (size_t slot = hash & (slots_.size() - 1); slots_[slot].entry_; slot = (slot + 1) & (slots_.size() - 1)) {
+        if (tag != slots_[slot].tag_)
+            continue;
+        const uint32_t entry = slots_[slot].entry_ - 1;
+        const char* const candidate = arena_.data() + keys_[entry];
+        if (!memcmp(candidate, key.data(), key.size()) && !candidate[key.size()])
+            return entry;
+    }
+    return no_entry;
+}
+
+const char* const* __vectorcall HashJoin::find(const std::string_view key) const
+{
+    ENSURE(!slots_.empty()); // built
+    const uint32_t entry = lookup(Hash(key), key);
+    return no_entry == entry ? nullptr : field_values_.data() + size_t(entry) * fields_;
+}
+
+uint64_t __vectorcall HashJoin::probe(ElegentFileReader& large, const size_t key_field, const Emit& emit) const
+{
+    ENSURE(!slots_.empty()); // built
+    trace::Span span("hashJoinProbe");
+    uint64_t emitted = 0;
+    std::vector<char> bytes;
+    std::vector<uint32_t> field_offsets;
+    std::vector<Pending> batch;
+    batch.reserve(batch_);
+    ElegentFileReader::Record record;
+    while (!large.isEOF()) {
+        // copy a batch of records (a record's fields are all in one run of the buffer), hash their keys and prefetch
+        // the slots; the next readRecord() can overwrite the buffer
+        bytes.clear();
+        field_offsets.clear();
+        batch.clear();
+        while (batch.size() < batch_ && !large.isEOF()) {
+            const auto& probe_record = large.readRecord();
+            if (probe_record.size() <= key_field)
+                continue;
+            const char* const begin = probe_record.front();
+            const char* const end = probe_record.back() + strlen(probe_record.back()) + 1;
+            const uint64_t hash = Hash(probe_record[key_field]);
+            _mm_prefetch(reinterpret_cast<const char*>(slots_.data() + (hash & (slots_.size() - 1))), _MM_HINT_T0);
+            batch.push_back(Pending{hash, static_cast<uint32_t>(bytes.size()), static_cast<uint32_t>(field_offsets.size()),
+                                    static_cast<uint32_t>(probe_record.size())});
+            bytes.insert(bytes.end(), begin, end);
+            for (const char* const field : probe_record)
+                field_offsets.push_back(static_cast<uint32_t>(field - begin));
+        }
+
+        // then look them up, the slots in the cache by now
+        for (const Pending& pending : batch) {
+            const char* const record_bytes = bytes.data() + pending.bytes_;
+            const uint32_t entry = lookup(pending.hash_, record_bytes + field_offsets[pending.fields_ + key_field]);
+            if (no_entry == entry)
+                continue;
+            record.clear();
+            for (uint32_t field = 0; field < pending.size_; ++field)
+                record.push_back(record_bytes + field_offsets[pending.fields_ + field]);
+            emit(record, field_values_.data() + size_t(entry) * fields_);
+            ++emitted;
+        }
+    }
+    span.arg("emitted", emitted);
+    return emitted;
+}
+
+}
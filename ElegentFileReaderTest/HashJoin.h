@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "ElegentFileReader.h"
+
+namespace score {
+
+/// An inner join of a big delimited file (the inforce, say) to a small table keyed on one of its fields (prod_code.tbl:
+/// OriginalProdCode -> ProdCode, IsVA), for the data preparation.
+/// build() loads the small table: its keys and the fields wanted are copied into one arena, with an open addressing
+/// table of (hash, entry) slots over them - no std::string or map node per row. probe() then streams the big file
+/// through its reader a batch of records at a time: the keys of the batch are hashed and their slots prefetched, then
+/// looked up, so the cache misses of a batch overlap. Only the batch is copied out of the reader's buffer, never the file.
+///     HashJoin products;
+///     products.build(prod_code, 0, {2, 3}); // ProdCode, IsVA
+///     products.probe(inforce, 5, [&](const ElegentFileReader::Record& policy, const char* const* product) { ... });
+/// A key that comes twice on the build side keeps its 1st record (duplicates() counts the others). A record without
+/// the key field, or on the build side without one of the fields, is left out.
+class HashJoin {
+public:
+    /// the probe record - its fields are copies, so not for the reader's utf8Field() - and the build fields wanted
+    using Emit = std::function<void(const ElegentFileReader::Record& probe, const char* const* build)>;
+
+    /// batch: the probe records looked up together
+    explicit HashJoin(size_t batch = 16);
+
+    /// reads the small table from where the reader is (skip its header first) to the end; fields: at least one.
+    /// A build again starts over
+    void __vectorcall build(ElegentFileReader& small, size_t key_field, std::vector<size_t> fields);
+    /// emit for each record with a match, from where the reader is to the end; returns the records emitted
+    uint64_t __vectorcall probe(ElegentFileReader& large, size_t key_field, const Emit& emit) const;
+    /// the build fields for a key, or nullptr
+    const char* const* __vectorcall find(std::string_view key) const;
+
+    size_t size() const
+    {
+        return size_;
+    }
+    size_t duplicates() const
+    {
+        return duplicates_;
+    }
+
+private:
+    struct Slot {
+        uint32_t tag_;   // the high half of the key's hash
+        uint32_t entry_; // + 1: 0 is an empty slot
+    };
+    static const uint32_t no_entry = ~0u;
+
+    uint32_t __vectorcall lookup(uint64_t hash, std::string_view key) const;
+
+    const size_t batch_;
+    size_t fields_ = 0;                     // wanted, per entry
+    std::vector<char> arena_;               // by entry: the key, then the fields, each null terminated
+    std::vector<uint32_t> keys_;            // by entry: where its key is in the arena
+    std::vector<const char*> field_values_; // by entry: fields_ pointers into the arena
+    std::vector<Slot> slots_;               // a power of 2 of them, at most half full
+    size_t size_ = 0;
+    size_t duplicates_ = 0;
+};
+
+}
@@ -0,0 +1,215 @@
+#include "pch.h"
+
+#include "InputSource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <string>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+[[noreturn]] void CannotOpen(const char* const filename)
+{
+    throw std::exception((std::string("cannot open ") + filename).c_str());
+}
+
+#if defined(_WIN32)
+HANDLE OpenForReading(const char* const filename, uint64_t& size)
+{
+    const HANDLE handle = ::CreateFileW(std::filesystem::u8path(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (INVALID_HANDLE_VALUE == handle)
+        CannotOpen(filename);
+    LARGE_INTEGER file_size;
+    if (!::GetFileSizeEx(handle, &file_size)) {
+        ::CloseHandle(handle);
+        CannotOpen(filename);
+    }
+    size = static_cast<uint64_t>(file_size.QuadPart);
+    return handle;
+}
+#else
+int OpenForReading(const char* const filename, uint64_t& size)
+{
+    const int fd = ::open(std::filesystem::u8path(filename).c_str(), O_RDONLY);
+    if (fd < 0)
+        CannotOpen(filename);
+    struct stat status;
+    if (::fstat(fd, &status) != 0) {
+        ::close(fd);
+        CannotOpen(filename);
+    }
+    size = static_cast<uint64_t>(status.st_size);
+    return fd;
+}
+#endif
+
+/// the bytes of [data, data + data_size) from offset
+size_t CopyOut(const char* const data, const uint64_t data_size, const uint64_t offset, char* const buffer, const size_t size)
+{
+    if (offset >= data_size)
+        return 0;
+    const size_t bytes = static_cast<size_t>(std::min<uint64_t>(size, data_size - offset));
+    std::memcpy(buffer, data + offset, bytes);
+    return bytes;
+}
+}
+
+FileSource::FileSource(const char* const filename)
+    : ifs_(std::filesystem::u8path(filename), std::ios::binary)
+{
+    if (!ifs_)
+        CannotOpen(filename);
+    size_ = std::filesystem::file_size(std::filesystem::u8path(filename));
+}
+
+size_t __vectorcall FileSource::read(const uint64_t offset, char* const buffer, const size_t size)
+{
+    if (offset != position_ && !ifs_.seekg(offset))
+        throw std::exception("error on seek");
+
+    size_t bytes_read = size;
+    if (!ifs_.read(buffer, size)) {
+        if (ifs_.rdstate() != (std::ios::failbit | std::ios::eofbit))
+            throw std::exception("error on read");
+        ifs_.clear();
+        bytes_read = static_cast<size_t>(ifs_.gcount());
+    }
+    position_ = offset + bytes_read;
+    return bytes_read;
+}
+
+PreadSource::PreadSource(const char* const filename)
+{
+#if defined(_WIN32)
+    handle_ = reinterpret_cast<intptr_t>(OpenForReading(filename, size_));
+#else
+    handle_ = OpenForReading(filename, size_);
+#endif
+}
+
+PreadSource::~PreadSource()
+{
+#if defined(_WIN32)
+    ::CloseHandle(reinterpret_cast<HANDLE>(handle_));
+#else
+    ::close(static_cast<int>(handle_));
+#endif
+}
+
+size_t __vectorcall PreadSource::read(const uint64_t offset, char* const buffer, const size_t size)
+{
+    size_t bytes_read = 0;
+    // a read can come back short before the end (a signal, a network file): carry on from there
+    while (bytes_read < size && offset + bytes_read < size_) {
+#if defined(_WIN32)
+        OVERLAPPED at = {};
+        at.Offset = static_cast<DWORD>(offset + bytes_read);
+        at.OffsetHigh = static_cast<DWORD>((offset + bytes_read) >> 32);
+        DWORD bytes = 0;
+        const DWORD wanted = static_cast<DWORD>(std::min<size_t>(size - bytes_read, 1u << 30));
+        if (!::ReadFile(reinterpret_cast<HANDLE>(handle_), buffer + bytes_read, wanted, &bytes, &at)
+            && ::GetLastError() != ERROR_HANDLE_EOF)
+            throw std::exception("error on read");
+#else
+        const ssize_t bytes = ::pread(static_cast<int>(handle_), buffer + bytes_read, size - bytes_read, static_cast<off_t>(offset + bytes_read));
+        if (bytes < 0) {
+            if (EINTR == errno)
+                continue;
+            throw std::exception("error on read");
+        }
+#endif
+        if (0 == bytes)
+            break;
+        bytes_read += static_cast<size_t>(bytes);
+    }
+    return bytes_read;
+}
+
+MappedSource::MappedSource(const char* const filename)
+{
+#if defined(_WIN32)
+    const HANDLE file = OpenForReading(filename, size_);
+    if (size_) { // an empty file can't be mapped
+        const HANDLE mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            data_ = static_cast<const char*>(::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            ::CloseHandle(mapping); // the view keeps it
+        }
+    }
+    ::CloseHandle(file);
+#else
+    const int file = OpenForReading(filename, size_);
+    if (size_) {
+        void* const data = ::mmap(nullptr, static_cast<size_t>(size_), PROT_READ, MAP_PRIVATE, file, 0);
+        if (MAP_FAILED != data) {
+            data_ = static_cast<const char*>(data);
+            ::madvise(data, static_cast<size_t>(size_), MADV_SEQUENTIAL);
+        }
+    }
+    ::close(file);
+#endif
+    if (size_ && !data_)
+        CannotOpen(filename);
+}
+
+MappedSource::~MappedSource()
+{
+    if (!data_)
+        return;
+#if defined(_WIN32)
+    ::UnmapViewOfFile(data_);
+#else
+    ::munmap(const_cast<char*>(data_), static_cast<size_t>(size_));
+#endif
+}
+
+size_t __vectorcall MappedSource::read(const uint64_t offset, char* const buffer, const size_t size)
+{
+    return CopyOut(data_, size_, offset, buffer, size);
+}
+
+size_t __vectorcall MemorySource::read(const uint64_t offset, char* const buffer, const size_t size)
+{
+    return CopyOut(data_, size_, offset, buffer, size);
+}
+
+StreamSource::StreamSource(std::istream& is)
+    : is_(is)
+{
+    checkForEnd(); // an empty stream is known to be empty straight away
+}
+
+size_t __vectorcall StreamSource::read(const uint64_t offset, char* const buffer, const size_t size)
+{
+    if (offset != position_)
+        throw std::exception((std::string("cannot seek a stream to ") + std::to_string(offset)).c_str());
+    if (size_ != unknown_size)
+        return 0;
+
+    is_.read(buffer, size);
+    const size_t bytes_read = static_cast<size_t>(is_.gcount());
+    if (is_.bad())
+        throw std::exception("error on read");
+    position_ += bytes_read;
+    checkForEnd();
+    return bytes_read;
+}
+
+/// is there any more? (a pipe waits here for the writer)
+void __vectorcall StreamSource::checkForEnd()
+{
+    if (is_.eof() || std::istream::traits_type::eof() == is_.peek())
+        size_ = position_;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <fstream>
+#include <istream>
+
+/// Where ElegentFileReader's bytes come from; the parsing is the same whatever the source.
+class InputSource {
+public:
+    /// size() of a stream, until the read that gets its last byte
+    static constexpr uint64_t unknown_size = UINT64_MAX;
+
+    virtual ~InputSource() = default;
+
+    /// up to size bytes from offset; fewer only at the end. Throws std::exception on an error.
+    virtual size_t __vectorcall read(uint64_t offset, char* buffer, size_t size) = 0;
+
+    /// the size in bytes, or unknown_size. A source that doesn't know up front must find out by the read that
+    /// gets the last byte (not the one after), so the reader can tell that a record at the end of a block is the last one.
+    virtual uint64_t size() const = 0;
+};
+
+/// a file through std::ifstream; the default for ElegentFileReader::open(filename)
+class FileSource : public InputSource {
+public:
+    explicit FileSource(const char* filename);
+
+    size_t __vectorcall read(uint64_t offset, char* buffer, size_t size) override;
+    uint64_t size() const override
+    {
+        return size_;
+    }
+
+private:
+    std::ifstream ifs_;
+    uint64_t size_;
+    uint64_t position_ = 0; // of ifs_: only seek when the read isn't where the last one ended
+};
+
+/// a file read with pread (ReadFile at an offset on Windows): no file position to seek or to share, so a read
+/// at any offset is one call, and readers on other threads can have the same file open without getting in each other's way
+class PreadSource : public InputSource {
+public:
+    explicit PreadSource(const char* filename);
+    ~PreadSource() override;
+    PreadSource(const PreadSource&) = delete;
+    PreadSource& operator=(const PreadSource&) = delete;
+
+    size_t __vectorcall read(uint64_t offset, char* buffer, size_t size) override;
+    uint64_t size() const override
+    {
+        return size_;
+    }
+
+private:
+    intptr_t handle_; // a HANDLE, or the file descriptor
+    uint64_t size_;
+};
+
+/// a file mapped into memory: a read is a memcpy, the os pages the file in (and caches it for the next reader)
+class MappedSource : public InputSource {
+public:
+    explicit MappedSource(const char* filename);
+    ~MappedSource() override;
+    MappedSource(const MappedSource&) = delete;
+    MappedSource& operator=(const MappedSource&) = delete;
+
+    size_t __vectorcall read(uint64_t offset, char* buffer, size_t size) override;
+    uint64_t size() const override
+    {
+        return size_;
+    }
+
+private:
+    const char* data_ = nullptr;
+    uint64_t size_ = 0;
+};
+
+/// bytes already in memory, e.g. a download: not copied, so they must outlive the reader
+class MemorySource : public InputSource {
+public:
+    MemorySource(const char* data, size_t size) : data_(data), size_(size) {}
+
+    size_t __vectorcall read(uint64_t offset, char* buffer, size_t size) override;
+    uint64_t size() const override
+    {
+        return size_;
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+};
+
+/// a stream of unknown size: a pipe, stdin (in binary mode), a socket wrapped in a std::istream.
+/// It can only be read forwards: a seek() within the buffer works, after one anywhere else the next read throws.
+/// The stream isn't owned, and must outlive the reader.
+class StreamSource : public InputSource {
+public:
+    explicit StreamSource(std::istream& is);
+
+    size_t __vectorcall read(uint64_t offset, char* buffer, size_t size) override;
+    uint64_t size() const override
+    {
+        return size_;
+    }
+
+private:
+    void __vectorcall checkForEnd();
+
+    std::istream& is_;
+    uint64_t position_ = 0;
+    uint64_t size_ = unknown_size;
+};
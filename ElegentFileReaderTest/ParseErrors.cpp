@@ -0,0 +1,40 @@
+#include "pch.h"
+
+#include "ParseErrors.h"
+
+#include <exception>
+
+namespace {
+const char* Describe(const ParseError::Kind kind)
+{
+    switch (kind) {
+    case ParseError::Kind::FieldCount:
+        return "wrong number of fields";
+    case ParseError::Kind::MissingField:
+        return "missing field";
+    case ParseError::Kind::DuplicateKey:
+        return "duplicate key";
+    }
+    return "bad row";
+}
+}
+
+std::string __vectorcall ToString(const ParseError& error)
+{
+    std::string text = Describe(error.kind_);
+    text += " at file offset " + std::to_string(error.offset_);
+    if (error.line_)
+        text += ", line " + std::to_string(error.line_);
+    text += ", field " + std::to_string(error.field_);
+    return text;
+}
+
+void __vectorcall ErrorLog::add(const ParseError& error)
+{
+    if (OnError::Throw == on_error_)
+        throw std::exception(ToString(error).c_str());
+
+    ++count_;
+    if (OnError::Collect == on_error_ && errors_.size() < capacity_)
+        errors_.push_back(error);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// A bad row in a file: where it is, and what's wrong with it
+struct ParseError {
+    enum class Kind : uint8_t {
+        FieldCount,   // not the number of fields expected; field_ is the 1st missing or extra one
+        MissingField, // too short to have the field asked for (e.g. an index key); field_ is that field
+        DuplicateKey, // an index key seen before, in another block of records; field_ is the key field
+    };
+
+    Kind kind_;
+    uint64_t offset_; // of the start of the row in the file
+    uint64_t line_;   // record number, the 1st (header) is 1; 0 if not known (after a seek() other than to 0)
+    size_t field_;
+};
+
+/// "wrong number of fields at file offset 1234, line 5, field 7"
+std::string __vectorcall ToString(const ParseError&);
+
+/// what a reader does with a bad row
+///     Throw:   throws std::exception with ToString() of it - no CHECK/ENSURE, so no symbol lookup
+///     SkipRow: leaves it out and counts it
+///     Collect: leaves it out, counts it, and keeps it in the ErrorLog (the first capacity of them)
+enum class OnError : uint8_t { Throw, SkipRow, Collect };
+
+/// The bad rows found, bounded: a file full of them costs a count each once the log is full.
+class ErrorLog {
+public:
+    explicit ErrorLog(const OnError on_error = OnError::Throw, const size_t capacity = 1000)
+        : on_error_(on_error), capacity_(capacity)
+    {}
+
+    OnError onError() const
+    {
+        return on_error_;
+    }
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    /// a bad row: throws, or counts it (and keeps it, if collecting and there's room)
+    void __vectorcall add(const ParseError&);
+
+    /// all the bad rows, kept or not
+    uint64_t count() const
+    {
+        return count_;
+    }
+
+    /// the ones kept, in the order found
+    const std::vector<ParseError>& errors() const
+    {
+        return errors_;
+    }
+
+    void clear()
+    {
+        count_ = 0;
+        errors_.clear();
+    }
+
+private:
+    OnError on_error_;
+    size_t capacity_;
+    uint64_t count_ = 0;
+    std::vector<ParseError> errors_;
+};
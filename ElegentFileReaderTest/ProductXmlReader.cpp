@@ -0,0 +1,310 @@
+#include "pch.h"
+
+#include "ProductXmlReader.h"
+
+#include <charconv>
+#include <exception>
+#include <unordered_map>
+
+#include "Ensure.h"
+#include "XmlPullReader.h"
+
+namespace {
+using Fallback = AssumptionSet::Fallback;
+using ValueSource = AssumptionSet::ValueSource;
+
+[[noreturn]] void ThrowInvalidAttribute(const char* what, const std::string_view name, const std::string_view value)
+{
+    throw std::exception((std::string("invalid ") + what + " \"" + std::string(value) + "\" for attribute " + std::string(name)).c_str());
+}
+
+int32_t IntegerAttribute(const XmlPullReader& xml, const std::string_view name, const int32_t default_value)
+{
+    if (!xml.hasAttribute(name))
+        return default_value;
+
+    const std::string_view value = xml.attribute(name);
+    int32_t result = 0;
+    const auto converted = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (value.empty() || converted.ec != std::errc() || converted.ptr != value.data() + value.size())
+        ThrowInvalidAttribute("integer", name, value);
+    return result;
+}
+
+bool EqualsIgnoringCase(const std::string_view a, const std::string_view b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i])))
+            return false;
+    return true;
+}
+
+/// the xml has both "true" and "True"
+bool BooleanAttribute(const XmlPullReader& xml, const std::string_view name)
+{
+    const std::string_view value = xml.attribute(name);
+    if (value.empty() || EqualsIgnoringCase(value, "false"))
+        return false;
+    if (EqualsIgnoringCase(value, "true"))
+        return true;
+    ThrowInvalidAttribute("boolean", name, value);
+}
+
+Fallback FallbackAttribute(const XmlPullReader& xml, const std::string_view name)
+{
+    static const std::pair<std::string_view, Fallback> fallbacks[] = {
+        {"Error", Fallback::Error},
+        {"ValueOf", Fallback::ValueOf},
+        {"RetryWith", Fallback::RetryWith},
+        {"Previous", Fallback::Previous},
+        {"Next", Fallback::Next},
+        {"Default", Fallback::Default},
+        {"First", Fallback::First},
+        {"Last", Fallback::Last},
+        {"Interpolate", Fallback::Interpolate},
+        {"AddExcess", Fallback::AddExcess}
+    };
+
+    const std::string_view value = xml.attribute(name);
+    if (value.empty())
+        return Fallback::Error;
+    for (const auto& fallback : fallbacks)
+        if (fallback.first == value)
+            return fallback.second;
+    ThrowInvalidAttribute("fallback", name, value);
+}
+
+AssumptionSet::KeyType KeyTypeAttribute(const XmlPullReader& xml)
+{
+    const std::string_view value = xml.attribute("keyType");
+    if (value == "Row")
+        return AssumptionSet::KeyType::Row;
+    if (value == "Column")
+        return AssumptionSet::KeyType::Column;
+    ThrowInvalidAttribute("key type", "keyType", value);
+}
+}
+
+AssumptionSet::Text __vectorcall AssumptionSet::intern(const std::string_view text)
+{
+    Text result;
+    result.offset_ = static_cast<uint32_t>(strings_.size());
+    result.length_ = static_cast<uint32_t>(text.size());
+    strings_.append(text.data(), text.size());
+    return result;
+}
+
+void __vectorcall ProductXmlReader::read(const char* const filename, AssumptionSet& result)
+{
+    result = AssumptionSet();
+    result_ = &result;
+    value_ = nullptr;
+    text_ = nullptr;
+    open_input_variables_.clear();
+    in_index_ = false;
+    in_key_ = false;
+
+    XmlPullReader xml(read_size_);
+    xml.open(filename);
+
+    for (auto token = xml.next(); token != XmlPullReader::Token::EndOfDocument; token = xml.next()) {
+        switch (token) {
+        case XmlPullReader::Token::StartElement:
+            startElement(xml);
+            break;
+        case XmlPullReader::Token::EndElement:
+            endElement(xml);
+            break;
+        case XmlPullReader::Token::Text:
+            text(xml);
+            break;
+        default: ;
+        }
+    }
+
+    resolveExternalSources();
+    result_ = nullptr;
+}
+
+void __vectorcall ProductXmlReader::startElement(const XmlPullReader& xml)
+{
+    AssumptionSet& result = *result_;
+    const std::string_view name = xml.name();
+
+    if (name == "externalSource") {
+        AssumptionSet::ExternalSource source;
+        source.name_ = result.intern(xml.attribute("name"));
+        source.display_name_ = result.intern(xml.attribute("displayname"));
+        source.location_ = result.intern(xml.attribute("location"));
+        source.original_location_ = result.intern(xml.attribute("originalLocation"));
+        source.is_composite_ = BooleanAttribute(xml, "isComposite");
+        result.external_sources_.push_back(source);
+
+    } else if (name == "externalSourceStructure") {
+        ENSURE(!result.external_sources_.empty());
+        auto& source = result.external_sources_.back();
+        source.has_structure_ = true;
+        source.column_key_names_column_ = IntegerAttribute(xml, "columnKeyNamesColumn", -1);
+        source.row_key_names_row_ = IntegerAttribute(xml, "rowKeyNamesRow", -1);
+        source.num_column_keys_ = IntegerAttribute(xml, "numColumnKeys", 0);
+        source.num_row_keys_ = IntegerAttribute(xml, "numRowKeys", 0);
+        source.column_key_values_start_column_ = IntegerAttribute(xml, "columnKeyValuesStartColumn", 0);
+        source.row_key_values_start_row_ = IntegerAttribute(xml, "rowKeyValuesStartRow", 0);
+        source.values_start_column_ = IntegerAttribute(xml, "valuesStartColumn", 0);
+        source.values_start_row_ = IntegerAttribute(xml, "valuesStartRow", 0);
+
+    } else if (name == "inputVariable") {
+        if (value_) { // a value taken from another input variable
+            value_->source_ = ValueSource::InputVariable;
+            value_->text_ = result.intern(xml.attribute("name"));
+        } else if (!in_index_) { // the definition of an input variable, or of one value of an indexed input variable
+            AssumptionSet::InputVariable variable;
+            variable.name_ = result.intern(xml.attribute("name"));
+            variable.type_ = IntegerAttribute(xml, "type", 0);
+            if (!open_input_variables_.empty()) {
+                variable.parent_ = open_input_variables_.back();
+                variable.type_ = result.input_variables_[variable.parent_].type_;
+            }
+            open_input_variables_.push_back(static_cast<uint32_t>(result.input_variables_.size()));
+            result.input_variables_.push_back(variable);
+        }
+
+    } else if (name == "index") {
+        in_index_ = true; // the variables an input variable is indexed by - not definitions
+
+    } else if (name == "value") {
+        if (in_key_)
+            value_ = &result.keys_.back().value_;
+        else if (!open_input_variables_.empty())
+            value_ = &result.input_variables_[open_input_variables_.back()].value_;
+
+    } else if (name == "missingFallbackValue") {
+        if (in_key_)
+            value_ = &result.keys_.back().missing_fallback_;
+    } else if (name == "beforeFirstFallbackValue") {
+        if (in_key_)
+            value_ = &result.keys_.back().before_first_fallback_;
+    } else if (name == "afterLastFallbackValue") {
+        if (in_key_)
+            value_ = &result.keys_.back().after_last_fallback_;
+
+    } else if (name == "default") {
+        if (value_)
+            value_->source_ = ValueSource::Default;
+    } else if (name == "constant") {
+        if (value_) {
+            value_->source_ = ValueSource::Constant;
+            text_ = &value_->text_;
+        }
+    } else if (name == "modelVariable") {
+        if (value_) {
+            value_->source_ = ValueSource::ModelVariable;
+            value_->text_ = result.intern(xml.attribute("variable"));
+            value_->model_object_ = result.intern(xml.attribute("modelObject"));
+        }
+    } else if (name == "modelScalar") {
+        if (value_) {
+            value_->source_ = ValueSource::ModelScalar;
+            value_->text_ = result.intern(xml.attribute("scalar"));
+            value_->model_object_ = result.intern(xml.attribute("modelObject"));
+        }
+    } else if (name == "modelColumn") {
+        if (value_) {
+            value_->source_ = ValueSource::ModelColumn;
+            value_->text_ = result.intern(xml.attribute("column"));
+            value_->model_object_ = result.intern(xml.attribute("modelObject"));
+        }
+    } else if (name == "systemVariable") {
+        if (value_) {
+            value_->source_ = ValueSource::SystemVariable;
+            value_->text_ = result.intern(xml.attribute("name"));
+        }
+
+    } else if (name == "lookup") {
+        if (value_ && !in_key_) {
+            value_->source_ = ValueSource::Lookup;
+            AssumptionSet::Lookup lookup;
+            lookup.external_source_name_ = result.intern(xml.attribute("externalSource"));
+            lookup.has_column_key_names_ = BooleanAttribute(xml, "hasColumnKeyNames");
+            lookup.has_row_key_names_ = BooleanAttribute(xml, "hasRowKeyNames");
+            lookup.first_key_ = static_cast<uint32_t>(result.keys_.size());
+            result.input_variables_[open_input_variables_.back()].lookup_ = static_cast<uint32_t>(result.lookups_.size());
+            result.lookups_.push_back(lookup);
+        }
+
+    } else if (name == "key") {
+        if (!result.lookups_.empty() && !open_input_variables_.empty()) {
+            AssumptionSet::LookupKey key;
+            key.key_type_ = KeyTypeAttribute(xml);
+            key.use_position_ = BooleanAttribute(xml, "usePosition");
+            key.type_ = IntegerAttribute(xml, "type", 0);
+            key.external_source_key_ = result.intern(xml.attribute("externalSourceKey"));
+            key.missing_ = FallbackAttribute(xml, "missing");
+            key.before_first_ = FallbackAttribute(xml, "beforeFirst");
+            key.after_last_ = FallbackAttribute(xml, "afterLast");
+            key.first_transformation_ = static_cast<uint32_t>(result.transformations_.size());
+            result.keys_.push_back(key);
+            ++result.lookups_.back().key_count_;
+            in_key_ = true;
+        }
+
+    } else if (name == "transformation") {
+        if (in_key_) {
+            AssumptionSet::Transformation transformation;
+            transformation.input_value_ = result.intern(xml.attribute("inputValue"));
+            transformation.transformed_value_ = result.intern(xml.attribute("transformedValue"));
+            result.transformations_.push_back(transformation);
+            ++result.keys_.back().transformation_count_;
+        }
+    }
+}
+
+void __vectorcall ProductXmlReader::endElement(const XmlPullReader& xml)
+{
+    const std::string_view name = xml.name();
+
+    if (name == "inputVariable") {
+        if (!value_ && !in_index_) // the end of the definition, not of a value taken from an input variable
+            open_input_variables_.pop_back();
+    } else if (name == "index") {
+        in_index_ = false;
+    } else if (name == "value" || name == "missingFallbackValue" || name == "beforeFirstFallbackValue" || name == "afterLastFallbackValue") {
+        value_ = nullptr;
+    } else if (name == "constant") {
+        text_ = nullptr;
+    } else if (name == "key") {
+        in_key_ = false;
+    }
+}
+
+void __vectorcall ProductXmlReader::text(const XmlPullReader& xml)
+{
+    if (!text_)
+        return;
+
+    // character data split by a comment continues the same text
+    if (text_->length_ && text_->offset_ + text_->length_ == result_->strings_.size()) {
+        result_->strings_.append(xml.text().data(), xml.text().size());
+        text_->length_ += static_cast<uint32_t>(xml.text().size());
+    } else {
+        *text_ = result_->intern(xml.text());
+    }
+}
+
+/// lookups name their external source; point them at it
+void __vectorcall ProductXmlReader::resolveExternalSources()
+{
+    AssumptionSet& result = *result_;
+
+    std::unordered_map<std::string_view, uint32_t> sources;
+    for (uint32_t i = 0; i < result.external_sources_.size(); ++i)
+        sources.emplace(result.str(result.external_sources_[i].name_), i);
+
+    for (auto& lookup : result.lookups_) {
+        const auto found = sources.find(result.str(lookup.external_source_name_));
+        if (found != sources.end())
+            lookup.external_source_ = found->second;
+    }
+}
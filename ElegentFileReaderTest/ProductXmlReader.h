@@ -0,0 +1,135 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ElegentFileReader.h"
+
+class XmlPullReader;
+
+/// The parts of a product assumption set xml that the projection needs: the external sources,
+/// the input variables and their lookups. Built in a single forward pass over the xml by ProductXmlReader.
+/// All the text lives in one string pool; the structs refer to it with (offset, length) pairs,
+/// and the keys and transformations of all lookups are stored contiguously, with each lookup/key owning a range.
+class AssumptionSet {
+public:
+    static constexpr uint32_t none = static_cast<uint32_t>(-1);
+
+    /// a slice of the string pool
+    struct Text {
+        uint32_t offset_ = 0;
+        uint32_t length_ = 0;
+    };
+
+    enum class KeyType : uint8_t { Row, Column };
+
+    /// what to do when a lookup key is missing, before the first or after the last key value
+    enum class Fallback : uint8_t { Error, ValueOf, RetryWith, Previous, Next, Default, First, Last, Interpolate, AddExcess };
+
+    /// where a value comes from
+    enum class ValueSource : uint8_t {
+        None, Default, Constant, InputVariable, ModelVariable, ModelScalar, ModelColumn, SystemVariable, Lookup
+    };
+
+    struct Value {
+        ValueSource source_ = ValueSource::None;
+        Text text_;          // the constant, or the name of the variable/scalar/column
+        Text model_object_;  // for model variables, scalars and columns
+    };
+
+    struct ExternalSource {
+        Text name_;
+        Text display_name_;
+        Text location_;
+        Text original_location_;
+        bool is_composite_ = false;
+        bool has_structure_ = false;
+        int32_t column_key_names_column_ = -1;
+        int32_t row_key_names_row_ = -1;
+        int32_t num_column_keys_ = 0;
+        int32_t num_row_keys_ = 0;
+        int32_t column_key_values_start_column_ = 0;
+        int32_t row_key_values_start_row_ = 0;
+        int32_t values_start_column_ = 0;
+        int32_t values_start_row_ = 0;
+    };
+
+    struct Transformation {
+        Text input_value_;
+        Text transformed_value_;
+    };
+
+    struct LookupKey {
+        KeyType key_type_ = KeyType::Row;
+        bool use_position_ = false;
+        int32_t type_ = 0;
+        Text external_source_key_;
+        Fallback missing_ = Fallback::Error;
+        Fallback before_first_ = Fallback::Error;
+        Fallback after_last_ = Fallback::Error;
+        Value value_;
+        Value missing_fallback_;
+        Value before_first_fallback_;
+        Value after_last_fallback_;
+        uint32_t first_transformation_ = 0;
+        uint32_t transformation_count_ = 0;
+    };
+
+    struct Lookup {
+        Text external_source_name_;
+        uint32_t external_source_ = none; // index into external_sources_, if the source is in this assumption set
+        bool has_column_key_names_ = false;
+        bool has_row_key_names_ = false;
+        uint32_t first_key_ = 0;
+        uint32_t key_count_ = 0;
+    };
+
+    struct InputVariable {
+        Text name_;
+        int32_t type_ = 0;
+        Value value_;
+        uint32_t lookup_ = none; // index into lookups_ if the value is a lookup
+        uint32_t parent_ = none; // for the values of an indexed input variable: the index of the indexed variable
+    };
+
+    std::string_view str(const Text text) const
+    {
+        return std::string_view(strings_.data() + text.offset_, text.length_);
+    }
+
+    Text __vectorcall intern(std::string_view);
+
+    std::string strings_;
+    std::vector<ExternalSource> external_sources_;
+    std::vector<InputVariable> input_variables_;
+    std::vector<Lookup> lookups_;
+    std::vector<LookupKey> keys_;
+    std::vector<Transformation> transformations_;
+};
+
+/// Single pass reader of product assumption set xml into an AssumptionSet
+class ProductXmlReader {
+public:
+    explicit ProductXmlReader(uint32_t read_size = static_cast<uint32_t>(64_Kb))
+        : read_size_(read_size)
+    {}
+
+    void __vectorcall read(const char* filename, AssumptionSet&);
+
+private:
+    void __vectorcall startElement(const XmlPullReader&);
+    void __vectorcall endElement(const XmlPullReader&);
+    void __vectorcall text(const XmlPullReader&);
+    void __vectorcall resolveExternalSources();
+
+    const uint32_t read_size_;
+
+    // parse state, only valid during read()
+    AssumptionSet* result_ = nullptr;
+    AssumptionSet::Value* value_ = nullptr; // the value we're currently filling in
+    AssumptionSet::Text* text_ = nullptr;   // the text we're currently collecting
+    std::vector<uint32_t> open_input_variables_; // indexed input variables contain the definitions of their values
+    bool in_index_ = false;
+    bool in_key_ = false;
+};
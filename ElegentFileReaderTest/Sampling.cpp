@@ -0,0 +1,104 @@
+#include "pch.h"
+
+#include "Sampling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+
+#include "ElegentFileReader.h"
+#include "Ensure.h"
+#include "Trace.h"
+
+namespace {
+/// where the records after the header start
+uint64_t DataBegin(ElegentFileReader& efr, const bool header)
+{
+    efr.seek(0);
+    if (header && !efr.isEOF())
+        efr.skipRecord();
+    return efr.ftell();
+}
+}
+
+std::vector<SampledRecord> __vectorcall Sample(ElegentFileReader& efr, const size_t k, const bool header, const uint64_t seed)
+{
+    ENSURE(efr.isOpen());
+    ENSURE(InputSource::unknown_size != efr.fileSize());
+    trace::Span span("sample");
+    span.arg("k", k);
+    const uint64_t position = efr.ftell();
+
+    std::vector<SampledRecord> records;
+    const uint64_t data_begin = DataBegin(efr, header);
+    const uint64_t file_size = efr.fileSize();
+    if (data_begin < file_size && k) {
+        // in file order, so the reads go forwards
+        std::mt19937_64 random(seed);
+        std::uniform_int_distribution<uint64_t> offsets(data_begin, file_size - 1);
+        std::vector<uint64_t> picks(k);
+        for (auto& pick : picks)
+            pick = offsets(random);
+        std::sort(picks.begin(), picks.end());
+
+        records.reserve(k);
+        for (const uint64_t pick : picks) {
+            // the record after the one the offset is in; after the last record, round to the 1st
+            efr.seek(pick);
+            efr.skipRecord();
+            if (efr.isEOF())
+                efr.seek(data_begin);
+
+            SampledRecord sampled;
+            sampled.offset_ = efr.ftell();
+            const auto& record = efr.readRecord();
+            sampled.length_ = efr.ftell() - sampled.offset_;
+            sampled.fields_.assign(record.begin(), record.end());
+            records.push_back(std::move(sampled));
+        }
+        std::stable_sort(records.begin(), records.end(),
+                         [](const SampledRecord& a, const SampledRecord& b) { return a.offset_ < b.offset_; });
+    }
+
+    efr.seek(position);
+    return records;
+}
+
+FileEstimate __vectorcall EstimateStats(ElegentFileReader& efr, const size_t k, const bool header, const uint64_t seed)
+{
+    FileEstimate estimate;
+    const std::vector<SampledRecord> sample = Sample(efr, k, header, seed);
+    estimate.sampled_ = sample.size();
+    if (sample.empty())
+        return estimate;
+
+    uint64_t bytes = 0;
+    std::map<size_t, size_t> field_counts;
+    for (const auto& record : sample) {
+        bytes += record.length_;
+        ++field_counts[record.fields_.size()];
+    }
+    estimate.average_record_length_ = double(bytes) / double(sample.size());
+    const uint64_t position = efr.ftell();
+    const uint64_t data_bytes = efr.fileSize() - DataBegin(efr, header);
+    efr.seek(position);
+    estimate.records_ = static_cast<uint64_t>(std::llround(double(data_bytes) / estimate.average_record_length_));
+
+    estimate.fields_ = std::max_element(field_counts.begin(), field_counts.end(),
+                                        [](const auto& a, const auto& b) { return a.second < b.second; })->first;
+    std::vector<uint64_t> width_totals(estimate.fields_);
+    std::vector<size_t> width_counts(estimate.fields_);
+    estimate.max_field_widths_.resize(estimate.fields_);
+    for (const auto& record : sample)
+        for (size_t field = 0; field < std::min(record.fields_.size(), estimate.fields_); ++field) {
+            const size_t width = record.fields_[field].size();
+            width_totals[field] += width;
+            ++width_counts[field];
+            estimate.max_field_widths_[field] = std::max(estimate.max_field_widths_[field], width);
+        }
+    estimate.field_widths_.resize(estimate.fields_);
+    for (size_t field = 0; field < estimate.fields_; ++field)
+        estimate.field_widths_[field] = width_counts[field] ? double(width_totals[field]) / double(width_counts[field]) : 0;
+    return estimate;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class ElegentFileReader;
+
+/// A look at a big file without reading it all: seek to random offsets, skipRecord() to the next record start, and read
+/// the record there. Each record after the header is about equally likely to be picked (a record is picked with
+/// the length of the one before it, so as long as a record's length doesn't depend on its neighbour's).
+/// Picks are independent, so a record can come up twice. The file's size must be known (not a StreamSource), and
+/// the reader is left where it was, but with the line numbers in its errors unknown (as after any seek()).
+/// Quoted mode: a seek into a quoted field with a LF in it resyncs wrong (see ElegentFileReader::Quoting).
+
+struct SampledRecord {
+    uint64_t offset_ = 0;
+    uint64_t length_ = 0; // bytes, with the line end
+    std::vector<std::string> fields_;
+};
+
+/// k records at random, in file order; header: the 1st record is a header, never picked.
+/// The same seed picks the same records
+std::vector<SampledRecord> __vectorcall Sample(ElegentFileReader&, size_t k, bool header = true, uint64_t seed = 0);
+
+/// what a file is likely to hold, from a Sample - to presize arrays and hash tables before reading it all
+struct FileEstimate {
+    uint64_t records_ = 0;              // after the header
+    double average_record_length_ = 0;  // bytes, with the line end
+    size_t fields_ = 0;                 // the most common field count in the sample
+    std::vector<double> field_widths_;  // the average length of each field, for the first fields_ fields
+    std::vector<size_t> max_field_widths_;
+    size_t sampled_ = 0;                // records it is based on: 0 for an empty file
+};
+
+FileEstimate __vectorcall EstimateStats(ElegentFileReader&, size_t k = 256, bool header = true, uint64_t seed = 0);
@@ -0,0 +1,173 @@
+#include "pch.h"
+
+#include "ScenarioFileReader.h"
+
+#include <charconv>
+#include <exception>
+#include <string>
+
+#include "Ensure.h"
+
+namespace {
+const char comment_character = '*';
+
+/// parse an unsigned number, ignoring the space padding around it ("        51")
+/// returns false if the field is not a number
+bool ParseMarkerField(const char* field, uint64_t& value)
+{
+    while (' ' == *field)
+        ++field;
+    const char* const end = field + strlen(field);
+    const auto result = std::from_chars(field, end, value);
+    if (result.ec != std::errc() || result.ptr == field)
+        return false;
+    for (auto p = result.ptr; p != end; ++p)
+        if (' ' != *p)
+            return false;
+    return true;
+}
+
+double ParseValue(const char* const field)
+{
+    double value = 0;
+    const char* const end = field + strlen(field);
+    const auto result = std::from_chars(field, end, value);
+    if (result.ec != std::errc() || result.ptr != end)
+        throw std::exception((std::string("invalid value in scenario file: ") + field).c_str());
+    return value;
+}
+}
+
+ScenarioFileReader::ScenarioFileReader(const uint32_t read_size, const char delimiter, const size_t key_fields)
+    : key_fields_(key_fields),
+      reader_(read_size, delimiter),
+      prefetch_reader_(read_size, delimiter)
+{}
+
+ScenarioFileReader::~ScenarioFileReader()
+{
+    waitForPrefetch();
+}
+
+void __vectorcall ScenarioFileReader::open(const char* const marker_filename, const char* const scenario_filename)
+{
+    ENSURE(!reader_.isOpen());
+
+    reader_.open(scenario_filename);
+    prefetch_reader_.open(scenario_filename);
+    loadMarkers(marker_filename);
+}
+
+void __vectorcall ScenarioFileReader::close()
+{
+    waitForPrefetch();
+
+    reader_.close();
+    prefetch_reader_.close();
+    markers_.clear();
+    current_ = Scenario();
+    next_ = Scenario();
+}
+
+/// read the table of byte markers:
+///     * comment lines
+///     Scenario    Byte        <- column headings
+///     scenario       0        <- the heading row of the scenario file
+///     1             51        <- the first row of scenario 1
+///     ...
+void __vectorcall ScenarioFileReader::loadMarkers(const char* const marker_filename)
+{
+    ElegentFileReader marker_reader('\t');
+    marker_reader.open(marker_filename);
+
+    markers_.assign(1, 0); // the heading row; at the front of the file unless the table says otherwise
+    while (!marker_reader.isEOF()) {
+        const auto& record = marker_reader.readRecord();
+        if (record.size() < 2 || comment_character == *record[0])
+            continue;
+
+        uint64_t offset = 0;
+        if (!ParseMarkerField(record[1], offset))
+            continue; // the column headings
+
+        uint64_t scenario = 0;
+        if (!ParseMarkerField(record[0], scenario)) {
+            markers_[0] = offset;
+            continue;
+        }
+
+        // scenarios are numbered from 1, without gaps, in file order
+        ENSURE(scenario, ==, markers_.size());
+        ENSURE(offset, >, markers_.back());
+        markers_.push_back(offset);
+    }
+
+    ENSURE(markers_.back(), <=, reader_.fileSize());
+    markers_.push_back(reader_.fileSize()); // the end of the last scenario
+}
+
+/// seek to the 1st row of the scenario and parse rows until we reach the start of the next scenario
+/// the Scenario's vector keeps its capacity, so once warmed up this does not allocate
+void __vectorcall ScenarioFileReader::parseScenario(ElegentFileReader& reader, const size_t scenario, Scenario& result) const
+{
+    const uint64_t end = markers_[scenario + 1];
+
+    result.number_ = scenario;
+    result.months_ = 0;
+    result.variables_ = 0;
+    result.values_.clear();
+
+    reader.seek(markers_[scenario]);
+    while (reader.ftell() < end && !reader.isEOF()) {
+        const auto& record = reader.readRecord();
+        if (record.size() <= key_fields_)
+            continue; // blank line
+
+        const size_t variables = record.size() - key_fields_;
+        if (0 == result.months_)
+            result.variables_ = variables;
+        ENSURE(variables, ==, result.variables_);
+
+        for (size_t field = key_fields_; field < record.size(); ++field)
+            result.values_.push_back(ParseValue(record[field]));
+        ++result.months_;
+    }
+}
+
+void __vectorcall ScenarioFileReader::prefetch(const size_t scenario)
+{
+    next_.number_ = 0; // not valid until the background parse has finished
+    prefetched_ = std::async(std::launch::async, [this, scenario] {
+        parseScenario(prefetch_reader_, scenario, next_);
+    });
+}
+
+/// the prefetch is only a guess: if it failed, forget about it and let the
+/// foreground parse report the error if that scenario is actually requested
+void __vectorcall ScenarioFileReader::waitForPrefetch()
+{
+    if (!prefetched_.valid())
+        return;
+    try {
+        prefetched_.get();
+    } catch (...) {
+        next_.number_ = 0;
+    }
+}
+
+const ScenarioFileReader::Scenario& __vectorcall ScenarioFileReader::readScenario(const size_t scenario)
+{
+    ENSURE(scenario, >, 0);
+    ENSURE(scenario, <=, scenarioCount());
+
+    waitForPrefetch();
+    if (next_.number_ == scenario)
+        std::swap(current_, next_);
+    else
+        parseScenario(reader_, scenario, current_);
+
+    if (scenario < scenarioCount())
+        prefetch(scenario + 1);
+
+    return current_;
+}
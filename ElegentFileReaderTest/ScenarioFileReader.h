@@ -0,0 +1,62 @@
+#pragma once
+
+#include <future>
+#include <vector>
+
+#include "ElegentFileReader.h"
+
+/// Random access to the scenarios of an economic scenario file, driven by its "table of byte markers".
+/// The marker table gives the byte offset of the first row of every scenario, so a scenario is read
+/// by seeking straight to it rather than by skipping through all the scenarios in front of it.
+/// While one scenario is being consumed, the next one is parsed on a background thread.
+class ScenarioFileReader {
+public:
+    /// the monthly rows of one scenario, stored contiguously as [month][variable]
+    struct Scenario {
+        size_t number_ = 0;
+        size_t months_ = 0;
+        size_t variables_ = 0;
+        std::vector<double> values_;
+
+        const double* row(const size_t month) const { return values_.data() + month * variables_; }
+    };
+
+    /// key_fields: the number of leading fields in each row that are not values (the scenario number and the month)
+    explicit ScenarioFileReader(uint32_t read_size = static_cast<uint32_t>(64_Kb), char delimiter = ',', size_t key_fields = 2);
+    ~ScenarioFileReader();
+
+    void __vectorcall open(const char* marker_filename, const char* scenario_filename);
+    void __vectorcall close();
+
+    /// parse scenario number `scenario` (1 based), and start prefetching the one after it.
+    /// the result stays valid until the next call to readScenario() or close()
+    const Scenario& __vectorcall readScenario(size_t scenario);
+
+    size_t scenarioCount() const
+    {
+        return markers_.empty() ? 0 : markers_.size() - 2;
+    }
+
+    uint64_t scenarioOffset(const size_t scenario) const
+    {
+        return markers_[scenario];
+    }
+
+private:
+    void __vectorcall loadMarkers(const char* marker_filename);
+    void __vectorcall parseScenario(ElegentFileReader&, size_t scenario, Scenario&) const;
+    void __vectorcall prefetch(size_t scenario);
+    void __vectorcall waitForPrefetch();
+
+    // markers_[0] is the header row, markers_[s] is the first row of scenario s and markers_.back() is the end of the file
+    std::vector<uint64_t> markers_;
+    const size_t key_fields_;
+
+    ElegentFileReader reader_;
+    ElegentFileReader prefetch_reader_; // a reader is not thread safe: the background parse gets its own
+    Scenario current_;
+    Scenario next_;
+    std::future<void> prefetched_;
+
+    friend class ScenarioFileReader_Markers_Test;
+};
@@ -0,0 +1,114 @@
+#include "pch.h"
+
+#include "TableLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <numeric>
+#include <system_error>
+
+#include "CompressedSource.h"
+#include "Ensure.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+
+namespace score {
+
+TableLoader::TableLoader(const size_t workers, const uint64_t buffer_budget, const uint32_t max_read_size)
+    : workers_(workers ? workers : std::max(std::thread::hardware_concurrency(), 1u)),
+      buffer_budget_(buffer_budget),
+      max_read_size_(max_read_size)
+{
+    ENSURE(buffer_budget, >, 0);
+    ENSURE(max_read_size, >, 0);
+}
+
+void __vectorcall TableLoader::add(std::string filename, Parse parse, const char delimiter,
+                                   const ElegentFileReader::Quoting quoting)
+{
+    tables_.emplace_back(std::move(filename), std::move(parse), delimiter, quoting);
+}
+
+void __vectorcall TableLoader::load()
+{
+    std::vector<Table> tables;
+    tables.swap(tables_);
+    peak_buffer_bytes_ = 0;
+    if (tables.empty())
+        return;
+
+    // biggest first: the last tables to start are then the quick ones, and the workers finish together
+    for (auto& table : tables) {
+        std::error_code error; // a missing file is reported by its open()
+        const auto file_size = std::filesystem::file_size(std::filesystem::u8path(table.filename_), error);
+        table.file_size_ = error ? 0 : file_size;
+    }
+    std::vector<size_t> order(tables.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](const size_t a, const size_t b) { return tables[a].file_size_ > tables[b].file_size_; });
+
+    WorkerPool pool(std::min(workers_, tables.size()));
+    std::atomic<size_t> next(0);
+    pool.run([&](size_t) {
+        for (size_t i; (i = next.fetch_add(1)) < order.size();)
+            loadTable(tables[order[i]]);
+    });
+
+    for (const auto& table : tables)
+        if (!table.error_.empty())
+            throw std::exception((table.filename_ + ": " + table.error_).c_str());
+}
+
+void __vectorcall TableLoader::loadTable(Table& table)
+{
+    trace::Span span("loadTable");
+    span.arg("bytes", table.file_size_);
+    uint64_t reserved = 0;
+    try {
+        // the loader's workers are the parallelism: a compressed table decompresses on its own thread only
+        std::unique_ptr<InputSource> source = OpenInput(table.filename_.c_str(), 1);
+
+        // a small table doesn't need a big buffer; a compressed one is bigger than its file, so gets the full size
+        const uint64_t size = source->size();
+        const uint32_t read_size = InputSource::unknown_size == size
+            ? max_read_size_
+            : static_cast<uint32_t>(std::clamp<uint64_t>(size, 1, max_read_size_));
+        const bool compressed = nullptr != dynamic_cast<const CompressedSource*>(source.get());
+        reserved = reserve(2 * uint64_t(read_size) + 1 + (compressed ? CompressedSource::max_buffer_bytes : 0));
+
+        ElegentFileReader efr(read_size, table.delimiter_, false, -1, ElegentFileReader::Encoding::Unchecked, table.quoting_);
+        efr.open(std::move(source));
+        table.parse_(efr);
+    } catch (const std::exception& e) {
+        table.error_ = e.what();
+    }
+    release(reserved);
+}
+
+/// wait until there is room for bytes (or all of the budget, if bytes is more than that), and take it
+uint64_t __vectorcall TableLoader::reserve(uint64_t bytes)
+{
+    bytes = std::min(bytes, buffer_budget_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    budget_freed_.wait(lock, [&] { return buffer_bytes_ + bytes <= buffer_budget_; });
+    buffer_bytes_ += bytes;
+    peak_buffer_bytes_ = std::max(peak_buffer_bytes_, buffer_bytes_);
+    return bytes;
+}
+
+void __vectorcall TableLoader::release(const uint64_t bytes)
+{
+    if (!bytes)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffer_bytes_ -= bytes;
+    }
+    budget_freed_.notify_all();
+}
+
+}
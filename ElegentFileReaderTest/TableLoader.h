@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ElegentFileReader.h"
+
+namespace score {
+
+/// Loads many tables at once (the input variables, product info, risk benefit definitions, ...) on a WorkerPool, so
+/// the startup isn't dozens of small reads one after another. Each table gets its own reader, opened on the file and
+/// handed to the table's parse function; the workers take the biggest files first, so one big table isn't left till last.
+/// The readers' buffers share a budget: a reader gets a read_size of at most the file size (small tables, small buffers),
+/// and a worker waits for budget to be freed before opening its next table. A reader is charged 2 read_sizes (what its
+/// buffer grows to for a record across blocks); a compressed table also what its CompressedSource decompresses ahead,
+/// on its one background thread (no BGZF pool per table). Only a record longer than the read_size grows the buffer
+/// past what was budgeted, as it would for any reader.
+///     TableLoader loader;
+///     loader.add("input_variable\\age.tbl", [&](ElegentFileReader& efr) { ... efr.readRecord() ... });
+///     ...
+///     loader.load();
+class TableLoader {
+public:
+    /// the reader is open on the table's file; called on a worker thread, so it must only touch that table's data
+    using Parse = std::function<void(ElegentFileReader&)>;
+
+    /// workers: 0 is one per logical cpu; buffer_budget: bytes, for all the readers' buffers at once
+    explicit TableLoader(size_t workers = 0, uint64_t buffer_budget = 16 * 1024_Kb,
+                         uint32_t max_read_size = static_cast<uint32_t>(64_Kb));
+
+    void __vectorcall add(std::string filename, Parse parse, char delimiter = '\t',
+                          ElegentFileReader::Quoting quoting = ElegentFileReader::Quoting::None);
+
+    /// parse all the tables added, and wait for them. Every table is tried; then the 1st that failed (in the order
+    /// added) is thrown, with its filename. The tables are dropped afterwards, so the loader can be used again.
+    void __vectorcall load();
+
+    size_t size() const
+    {
+        return tables_.size();
+    }
+    /// the most the buffers took at once, in the last load(): never over the budget
+    uint64_t peakBufferBytes() const
+    {
+        return peak_buffer_bytes_;
+    }
+
+private:
+    struct Table {
+        std::string filename_;
+        Parse parse_;
+        char delimiter_;
+        ElegentFileReader::Quoting quoting_;
+        uint64_t file_size_;
+        std::string error_;
+
+        Table(std::string filename, Parse parse, const char delimiter, const ElegentFileReader::Quoting quoting)
+            : filename_(std::move(filename)), parse_(std::move(parse)), delimiter_(delimiter), quoting_(quoting), file_size_(0)
+        {
+        }
+    };
+
+    void __vectorcall loadTable(Table&);
+    uint64_t __vectorcall reserve(uint64_t bytes);
+    void __vectorcall release(uint64_t bytes);
+
+    const size_t workers_;
+    const uint64_t buffer_budget_;
+    const uint32_t max_read_size_;
+    std::vector<Table> tables_;
+
+    std::mutex mutex_;
+    std::condition_variable budget_freed_;
+    uint64_t buffer_bytes_ = 0;
+    uint64_t peak_buffer_bytes_ = 0;
+};
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "CalculationState.h"
+#include "ElegentFileReader.h"
+
+/// what more than one *_test.cpp needs; a helper used by one test file stays in that file
+namespace test {
+
+using Records = std::vector<std::vector<std::string>>;
+
+/// the records from where the reader is to the end of the file (not the empty one that signals the end);
+/// offsets, if given, gets where each starts
+inline Records ReadAll(ElegentFileReader& efr, std::vector<uint64_t>* const offsets = nullptr)
+{
+    Records records;
+    while (!efr.isEOF()) {
+        const auto& record = efr.readRecord();
+        if (record.empty())
+            continue;
+        records.emplace_back(record.begin(), record.end());
+        if (offsets)
+            offsets->push_back(efr.recordOffset());
+    }
+    return records;
+}
+
+/// the records of a file, read with the default reader
+inline Records ReadAll(const char* const filename)
+{
+    ElegentFileReader efr;
+    efr.open(filename);
+    return ReadAll(efr);
+}
+
+/// name, in the temp directory
+inline std::string TempPath(const std::string& name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+inline std::string Contents(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+/// returns path
+inline std::string WriteFile(const std::string& path, const std::string& contents)
+{
+    std::ofstream(path, std::ios::binary) << contents;
+    return path;
+}
+
+inline double StateValue(const score::CalculationState state)
+{
+    return score::DoubleState(state).as_double_state_in_high_dword();
+}
+
+/// a column of calculated values and states (about a quarter, all four kinds). The calculated values are whole numbers,
+/// so any order of adding gives the same sum; with special_values some are 0, -1.25, 1e300, infinity or a NaN that
+/// isn't a state
+inline std::vector<double> MixedColumn(const size_t size, unsigned random, const bool special_values = false)
+{
+    using score::CalculationState;
+    const double specials[] = {0.0, -1.25, 1e300, std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN()};
+    std::vector<double> column(size);
+    for (auto& value : column) {
+        random = random * 1103515245 + 12345;
+        const unsigned pick = (random >> 16) % 16;
+        switch (pick) {
+        case 0: value = StateValue(CalculationState::NoAvg); break;
+        case 1: value = StateValue(CalculationState::NotCalculated); break;
+        case 2: value = StateValue(CalculationState::NotCalculatedSaturn); break;
+        case 3: value = StateValue(CalculationState::Busy); break;
+        default:
+            value = special_values && pick < 9 ? specials[pick - 4] : static_cast<double>(static_cast<int>(random >> 20) % 2000 - 1000);
+        }
+    }
+    return column;
+}
+
+}
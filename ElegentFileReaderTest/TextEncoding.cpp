@@ -0,0 +1,292 @@
+#include "pch.h"
+
+#include "TextEncoding.h"
+
+#include <cstring>
+#include <exception>
+#include <Windows.h>
+
+namespace {
+const unsigned code_page_shift_jis = 932;
+}
+
+bool __vectorcall IsAscii(const char* data, size_t size)
+{
+#if defined(__AVX2__)
+    __m256i high_bits = _mm256_setzero_si256();
+    for (; size >= 32; data += 32, size -= 32)
+        high_bits = _mm256_or_si256(high_bits, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)));
+    if (_mm256_movemask_epi8(high_bits))
+        return false;
+#endif
+    uint64_t high_bits_64 = 0;
+    for (; size >= 8; data += 8, size -= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        high_bits_64 |= word;
+    }
+    for (; size; ++data, --size)
+        high_bits_64 |= static_cast<uint8_t>(*data);
+    return !(high_bits_64 & 0x8080808080808080ull);
+}
+
+#if defined(__AVX2__)
+namespace {
+// the error classes of the lookup algorithm: each table gives, for a nibble, the errors it could be part of;
+// a byte pair is in error if all three lookups agree on at least one error
+const uint8_t TOO_SHORT = 1 << 0;      // a lead byte followed by a lead byte or ASCII
+const uint8_t TOO_LONG = 1 << 1;       // ASCII followed by a continuation byte
+const uint8_t OVERLONG_3 = 1 << 2;     // E0 80..9F
+const uint8_t TOO_LARGE = 1 << 3;      // F4 90..BF, F5..FF
+const uint8_t SURROGATE = 1 << 4;      // ED A0..BF
+const uint8_t OVERLONG_2 = 1 << 5;     // C0, C1
+const uint8_t TOO_LARGE_1000 = 1 << 6; // F5..FF 80..8F
+const uint8_t OVERLONG_4 = 1 << 6;     // F0 80..8F
+const uint8_t TWO_CONTS = 1 << 7;      // two continuation bytes: fine only in a 3 or 4 byte character
+const uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+__m256i Table(const uint8_t (&t)[16])
+{
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(t)));
+}
+
+__m256i HighNibbles(const __m256i v)
+{
+    return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+/// the input shifted right by N bytes, with the end of the previous input shifted in
+template <int N>
+__m256i Previous(const __m256i input, const __m256i previous_input)
+{
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous_input, input, 0x21), 16 - N);
+}
+
+__m256i CheckSpecialCases(const __m256i input, const __m256i previous_1)
+{
+    static const uint8_t byte_1_high[16] = {
+        // 0_______ ASCII
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        // 10______ continuation
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        // 1100____ 1101____ two byte lead
+        TOO_SHORT | OVERLONG_2, TOO_SHORT,
+        // 1110____ three byte lead
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        // 1111____ four byte lead
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4};
+    static const uint8_t byte_1_low[16] = {
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, // ____0000
+        CARRY | OVERLONG_2,                           // ____0001
+        CARRY, CARRY,                                 // ____001_
+        CARRY | TOO_LARGE,                            // ____0100
+        CARRY | TOO_LARGE | TOO_LARGE_1000,           // ____0101
+        CARRY | TOO_LARGE | TOO_LARGE_1000,           // ____011_
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,           // ____1___
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE, // ____1101
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000};
+    static const uint8_t byte_2_high[16] = {
+        // ________ 0_______ ASCII
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        // ________ 1000____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        // ________ 1001____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        // ________ 101_____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        // ________ 11______ lead
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT};
+
+    const __m256i low_nibbles = _mm256_and_si256(previous_1, _mm256_set1_epi8(0x0F));
+    return _mm256_and_si256(
+        _mm256_and_si256(_mm256_shuffle_epi8(Table(byte_1_high), HighNibbles(previous_1)),
+                         _mm256_shuffle_epi8(Table(byte_1_low), low_nibbles)),
+        _mm256_shuffle_epi8(Table(byte_2_high), HighNibbles(input)));
+}
+
+/// the 2nd and 3rd continuation bytes aren't covered by the special cases: they must follow 3 and 4 byte leads
+__m256i CheckMultibyteLengths(const __m256i input, const __m256i previous_input, const __m256i special_cases)
+{
+    const __m256i previous_2 = Previous<2>(input, previous_input);
+    const __m256i previous_3 = Previous<3>(input, previous_input);
+    const __m256i is_third_byte = _mm256_subs_epu8(previous_2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    const __m256i is_fourth_byte = _mm256_subs_epu8(previous_3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    const __m256i must_be_continuation = _mm256_and_si256(_mm256_or_si256(is_third_byte, is_fourth_byte), _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(must_be_continuation, special_cases);
+}
+
+/// non-zero if the input ends part way through a character
+__m256i IsIncomplete(const __m256i input)
+{
+    static const uint8_t max_value[32] = {
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        0b11110000u - 1, 0b11100000u - 1, 0b11000000u - 1};
+    return _mm256_subs_epu8(input, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(max_value)));
+}
+}
+
+void __vectorcall Utf8Validator::reset()
+{
+    error_ = _mm256_setzero_si256();
+    previous_input_ = _mm256_setzero_si256();
+    previous_incomplete_ = _mm256_setzero_si256();
+    tail_size_ = 0;
+}
+
+void __vectorcall Utf8Validator::checkChunk(const __m256i input)
+{
+    if (!_mm256_movemask_epi8(input)) { // ASCII: only a character left open by the previous chunk can be wrong
+        error_ = _mm256_or_si256(error_, previous_incomplete_);
+        previous_incomplete_ = _mm256_setzero_si256();
+        previous_input_ = _mm256_setzero_si256();
+        return;
+    }
+
+    const __m256i previous_1 = Previous<1>(input, previous_input_);
+    const __m256i special_cases = CheckSpecialCases(input, previous_1);
+    error_ = _mm256_or_si256(error_, CheckMultibyteLengths(input, previous_input_, special_cases));
+    previous_incomplete_ = IsIncomplete(input);
+    previous_input_ = input;
+}
+
+bool __vectorcall Utf8Validator::update(const char* data, size_t size)
+{
+    // complete the chunk started by the previous block
+    if (tail_size_) {
+        const size_t n = std::min(size, sizeof(tail_) - tail_size_);
+        std::memcpy(tail_ + tail_size_, data, n);
+        tail_size_ += n;
+        data += n;
+        size -= n;
+        if (tail_size_ < sizeof(tail_))
+            return isValid();
+        checkChunk(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(tail_)));
+        tail_size_ = 0;
+    }
+
+    for (; size >= 32; data += 32, size -= 32)
+        checkChunk(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)));
+
+    std::memcpy(tail_, data, size);
+    tail_size_ = size;
+    return isValid();
+}
+
+bool __vectorcall Utf8Validator::updateAscii()
+{
+    // ASCII padding in the middle of the stream doesn't change whether it is valid
+    if (tail_size_) {
+        std::memset(tail_ + tail_size_, 0, sizeof(tail_) - tail_size_);
+        checkChunk(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(tail_)));
+        tail_size_ = 0;
+    }
+    error_ = _mm256_or_si256(error_, previous_incomplete_);
+    previous_incomplete_ = _mm256_setzero_si256();
+    previous_input_ = _mm256_setzero_si256();
+    return isValid();
+}
+
+bool __vectorcall Utf8Validator::finish()
+{
+    // pad the last chunk with ASCII: a character cut short will show up as TOO_SHORT
+    std::memset(tail_ + tail_size_, 0, sizeof(tail_) - tail_size_);
+    checkChunk(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(tail_)));
+    tail_size_ = 0;
+    error_ = _mm256_or_si256(error_, previous_incomplete_);
+    previous_incomplete_ = _mm256_setzero_si256();
+    return isValid();
+}
+
+bool Utf8Validator::isValid() const
+{
+    return _mm256_testz_si256(error_, error_);
+}
+
+#else
+
+void __vectorcall Utf8Validator::reset()
+{
+    continuation_bytes_ = 0;
+    next_low_ = 0x80;
+    next_high_ = 0xBF;
+    error_ = false;
+}
+
+/// the state machine of the unicode standard (table 3-7, well-formed utf-8 byte sequences)
+bool __vectorcall Utf8Validator::update(const char* const data, const size_t size)
+{
+    for (size_t i = 0; i < size && !error_; ++i) {
+        const uint8_t c = static_cast<uint8_t>(data[i]);
+        if (continuation_bytes_) {
+            error_ = c < next_low_ || c > next_high_;
+            next_low_ = 0x80;
+            next_high_ = 0xBF;
+            --continuation_bytes_;
+        } else if (c >= 0x80) {
+            if (c >= 0xC2 && c <= 0xDF)
+                continuation_bytes_ = 1;
+            else if (c >= 0xE0 && c <= 0xEF) {
+                continuation_bytes_ = 2;
+                if (0xE0 == c)
+                    next_low_ = 0xA0; // overlong
+                else if (0xED == c)
+                    next_high_ = 0x9F; // surrogates
+            } else if (c >= 0xF0 && c <= 0xF4) {
+                continuation_bytes_ = 3;
+                if (0xF0 == c)
+                    next_low_ = 0x90; // overlong
+                else if (0xF4 == c)
+                    next_high_ = 0x8F; // above U+10FFFF
+            } else
+                error_ = true;
+        }
+    }
+    return !error_;
+}
+
+bool __vectorcall Utf8Validator::updateAscii()
+{
+    return finish();
+}
+
+bool __vectorcall Utf8Validator::finish()
+{
+    error_ = error_ || continuation_bytes_;
+    continuation_bytes_ = 0;
+    return !error_;
+}
+
+bool Utf8Validator::isValid() const
+{
+    return !error_;
+}
+
+#endif
+
+/// via utf-16, with the code page tables of Windows
+void __vectorcall ShiftJisToUtf8(const char* const data, const size_t size, std::string& result)
+{
+    if (!size)
+        return;
+
+    thread_local std::wstring wide;
+    wide.resize(size); // never more utf-16 units than bytes
+    const int wide_length = MultiByteToWideChar(code_page_shift_jis, MB_ERR_INVALID_CHARS, data, static_cast<int>(size), wide.data(), static_cast<int>(wide.size()));
+    if (wide_length <= 0)
+        throw std::exception("invalid Shift-JIS text");
+
+    const size_t offset = result.size();
+    result.resize(offset + 3 * static_cast<size_t>(wide_length)); // at most 3 bytes per utf-16 unit
+    const int length = WideCharToMultiByte(CP_UTF8, 0, wide.data(), wide_length, result.data() + offset, static_cast<int>(result.size() - offset), nullptr, nullptr);
+    if (length <= 0)
+        throw std::exception("cannot convert Shift-JIS text to utf-8");
+    result.resize(offset + static_cast<size_t>(length));
+}
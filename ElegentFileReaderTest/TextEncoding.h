@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/// true if none of the bytes have the high bit set
+bool __vectorcall IsAscii(const char* data, size_t size);
+
+/// Streaming utf-8 validation: bytes can be fed in blocks of any size, and a character may straddle blocks.
+/// With AVX2 this is the lookup table algorithm of Keiser & Lemire ("Validating UTF-8 In Less Than One
+/// Instruction Per Byte"), 32 bytes at a time, with an ASCII fast path; otherwise a scalar state machine.
+/// Overlong encodings, surrogates, code points above U+10FFFF and truncated sequences are all invalid.
+class Utf8Validator {
+public:
+    Utf8Validator()
+    {
+        reset();
+    }
+
+    void __vectorcall reset();
+
+    /// validate the next bytes of the stream
+    /// returns false as soon as an error is found; the error stays until reset()
+    bool __vectorcall update(const char* data, size_t size);
+
+    /// the next bytes of the stream are all ASCII (see IsAscii): nothing to look at but the end of the previous bytes
+    bool __vectorcall updateAscii();
+
+    /// the end of the stream: it must not end part way through a character
+    bool __vectorcall finish();
+
+    bool isValid() const;
+
+private:
+#if defined(__AVX2__)
+    void __vectorcall checkChunk(__m256i input);
+
+    __m256i error_;
+    __m256i previous_input_;
+    __m256i previous_incomplete_;
+    char tail_[32];     // bytes that don't make up a whole chunk yet
+    size_t tail_size_;
+#else
+    uint32_t continuation_bytes_; // still expected in the current character
+    uint8_t next_low_;            // the range of the next continuation byte (narrower after some lead bytes)
+    uint8_t next_high_;
+    bool error_;
+#endif
+};
+
+/// Code page 932 (Shift-JIS as written by Windows) to utf-8
+/// appends to result; throws if the text is not valid Shift-JIS
+void __vectorcall ShiftJisToUtf8(const char* data, size_t size, std::string& result);
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+/// Which time slots of a projection fall inside a column's window.
+/// Slot i is time t_low + i; it is in the window if from <= t_low + i <= to, for i < capacity.
+/// That's one range of slots [first(), end()), worked out up front rather than testing each slot:
+/// iterate the window for the valid slots, or fill() a row index (the slot, or NA outside the window).
+class TimeWindow {
+public:
+    static constexpr size_t NA = std::numeric_limits<size_t>::max();
+
+    TimeWindow(const int t_low, const int from, const int to, const size_t capacity) : capacity_(capacity) {
+        // in 64 bits: from - t_low can overflow an int
+        const int64_t first = std::max<int64_t>(int64_t(from) - t_low, 0);
+        const int64_t end = std::min<int64_t>(int64_t(to) - t_low + 1, static_cast<int64_t>(std::min<size_t>(capacity, INT64_MAX)));
+        if (first < end) {
+            first_ = static_cast<size_t>(first);
+            end_ = static_cast<size_t>(end);
+        }
+    }
+
+    size_t first() const { return first_; }
+    /// one past the last slot in the window
+    size_t end_slot() const { return end_; }
+    size_t size() const { return end_ - first_; }
+    bool empty() const { return first_ == end_; }
+    size_t capacity() const { return capacity_; }
+
+    bool contains(const size_t slot) const { return slot - first_ < end_ - first_; }
+    /// the row index of a slot: the slot itself, or NA outside the window
+    size_t operator[](const size_t slot) const { return contains(slot) ? slot : NA; }
+
+    /// the row indices of all capacity() slots: NA, the window's slots, NA
+    void fill(size_t* result) const {
+        std::fill(result, result + first_, NA);
+        std::iota(result + first_, result + end_, first_);
+        std::fill(result + end_, result + capacity_, NA);
+    }
+    std::vector<size_t> row_indices() const {
+        std::vector<size_t> result(capacity_);
+        fill(result.data());
+        return result;
+    }
+
+    /// the slots in the window, for (size_t slot : window)
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = size_t;
+        using difference_type = ptrdiff_t;
+        using pointer = const size_t*;
+        using reference = size_t;
+
+        explicit iterator(const size_t slot) : slot_(slot) {}
+        size_t operator*() const { return slot_; }
+        iterator& operator++() { ++slot_; return *this; }
+        iterator operator++(int) { iterator before = *this; ++slot_; return before; }
+        bool operator==(const iterator& other) const { return slot_ == other.slot_; }
+        bool operator!=(const iterator& other) const { return slot_ != other.slot_; }
+
+    private:
+        size_t slot_;
+    };
+    iterator begin() const { return iterator(first_); }
+    iterator end() const { return iterator(end_); }
+
+private:
+    size_t capacity_;
+    size_t first_ = 0;
+    size_t end_ = 0;
+};
@@ -0,0 +1,201 @@
+#include "pch.h"
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace trace {
+namespace detail {
+std::atomic<bool> enabled(false);
+}
+
+namespace {
+struct Event {
+    const char* name_;
+    const char* arg_name_;
+    uint64_t begin_;
+    uint64_t end_;
+    uint64_t arg_;
+};
+
+/// an event, with the index it holds + 1 (0 while it's being written): the export keeps a copy only if that's the same
+/// before and after copying it, so it never keeps an event the writer was overwriting
+struct Slot {
+    std::atomic<uint64_t> sequence_{0};
+    Event event_;
+};
+
+/// one writer (its thread), read by the export: the writer fills the slot, then publishes it by moving head_ on.
+/// The export copies [tail_, head_), slot by slot.
+struct ThreadBuffer {
+    Slot slots_[events_per_thread];
+    std::atomic<uint64_t> head_{0}; // events written, ever
+    std::atomic<uint64_t> tail_{0}; // events before this were cleared
+    std::atomic<const char*> name_{nullptr};
+    uint32_t tid_ = 0;
+};
+
+/// the buffers of every thread that has traced; a thread's buffer is kept after the thread ends, for the export
+struct Registry {
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+};
+
+Registry& GetRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+thread_local ThreadBuffer* this_thread_buffer = nullptr;
+
+/// only the 1st span on a thread takes the lock
+ThreadBuffer& ThisThreadBuffer()
+{
+    if (!this_thread_buffer) {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex_);
+        registry.buffers_.push_back(std::make_unique<ThreadBuffer>());
+        registry.buffers_.back()->tid_ = static_cast<uint32_t>(registry.buffers_.size());
+        this_thread_buffer = registry.buffers_.back().get();
+    }
+    return *this_thread_buffer;
+}
+
+struct Copied {
+    uint32_t tid_;
+    Event event_;
+};
+
+void CopyEvents(const ThreadBuffer& buffer, std::vector<Copied>& events)
+{
+    const uint64_t head = buffer.head_.load(std::memory_order_acquire);
+    const uint64_t oldest = head > events_per_thread ? head - events_per_thread : 0;
+    for (uint64_t i = std::max(buffer.tail_.load(std::memory_order_relaxed), oldest); i < head; ++i) {
+        // the writer may have lapped us, and be writing this slot
+        const Slot& slot = buffer.slots_[i % events_per_thread];
+        if (slot.sequence_.load(std::memory_order_acquire) != i + 1)
+            continue;
+        const Event event = slot.event_;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence_.load(std::memory_order_relaxed) == i + 1)
+            events.push_back(Copied{buffer.tid_, event});
+    }
+}
+
+void WriteString(std::ostream& os, const char* s)
+{
+    os << '"';
+    for (; *s; ++s) {
+        if ('"' == *s || '\\' == *s)
+            os << '\\' << *s;
+        else if (static_cast<unsigned char>(*s) >= ' ')
+            os << *s;
+    }
+    os << '"';
+}
+}
+
+namespace detail {
+void __vectorcall record(const char* const name, const uint64_t begin, const char* const arg_name, const uint64_t arg)
+{
+    const uint64_t end = now();
+    ThreadBuffer& buffer = ThisThreadBuffer();
+    const uint64_t head = buffer.head_.load(std::memory_order_relaxed);
+    Slot& slot = buffer.slots_[head % events_per_thread];
+    slot.sequence_.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.event_ = Event{name, arg_name, begin, end, arg};
+    slot.sequence_.store(head + 1, std::memory_order_release);
+    buffer.head_.store(head + 1, std::memory_order_release);
+}
+}
+
+void enable(const bool on)
+{
+    detail::enabled.store(on, std::memory_order_relaxed);
+}
+
+void clear()
+{
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex_);
+    for (auto& buffer : registry.buffers_)
+        buffer->tail_.store(buffer->head_.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+void name_thread(const char* const name)
+{
+    ThisThreadBuffer().name_.store(name, std::memory_order_release);
+}
+
+void __vectorcall write_chrome_json(std::ostream& os)
+{
+    std::vector<Copied> events;
+    std::vector<std::pair<uint32_t, const char*>> names;
+    {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex_);
+        for (const auto& buffer : registry.buffers_) {
+            CopyEvents(*buffer, events);
+            if (const char* name = buffer->name_.load(std::memory_order_acquire))
+                names.emplace_back(buffer->tid_, name);
+        }
+    }
+
+    uint64_t origin = UINT64_MAX;
+    for (const auto& copied : events)
+        origin = std::min(origin, copied.event_.begin_);
+
+    const std::ios::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os.setf(std::ios::fixed, std::ios::floatfield);
+    os.precision(3);
+
+    os << "{\"traceEvents\":[";
+    const char* separator = "\n";
+    for (const auto& name : names) {
+        os << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << name.first << ",\"args\":{\"name\":";
+        WriteString(os, name.second);
+        os << "}}";
+        separator = ",\n";
+    }
+    for (const auto& copied : events) {
+        const Event& event = copied.event_;
+        os << separator << "{\"name\":";
+        WriteString(os, event.name_);
+        os << ",\"cat\":\"efr\",\"ph\":\"X\",\"pid\":1,\"tid\":" << copied.tid_
+           << ",\"ts\":" << (event.begin_ - origin) / 1000.0 << ",\"dur\":" << (event.end_ - event.begin_) / 1000.0;
+        if (event.arg_name_) {
+            os << ",\"args\":{";
+            WriteString(os, event.arg_name_);
+            os << ':' << event.arg_ << '}';
+        }
+        os << '}';
+        separator = ",\n";
+    }
+    os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void __vectorcall save(const char* const filename)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+        throw std::exception((std::string("cannot open ") + filename).c_str());
+    write_chrome_json(file);
+    if (!file.flush())
+        throw std::exception((std::string("error writing ") + filename).c_str());
+}
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+
+/// A timeline of what the readers and index builds spend their time on, to open in chrome://tracing or ui.perfetto.dev.
+/// A Span times a scope; each thread writes its spans to its own ring buffer, so tracing takes no locks and the last
+/// events_per_thread spans per thread are kept. Off, a span costs a relaxed load and a branch, so it can stay compiled in:
+///     trace::enable();
+///     ... read, index ...
+///     trace::save("efr.json");
+namespace trace {
+
+/// per thread; older spans get overwritten
+const size_t events_per_thread = 8192;
+
+namespace detail {
+extern std::atomic<bool> enabled;
+
+inline uint64_t now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void __vectorcall record(const char* name, uint64_t begin, const char* arg_name, uint64_t arg);
+}
+
+inline bool enabled()
+{
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+void enable(bool on = true);
+
+/// drop the spans recorded so far, on every thread
+void clear();
+
+/// shown instead of the thread id; name must outlive the trace (a string literal)
+void name_thread(const char* name);
+
+/// the spans recorded so far as Chrome trace event JSON: complete ("X") events, in µs
+void __vectorcall write_chrome_json(std::ostream&);
+void __vectorcall save(const char* filename);
+
+/// times its scope, if tracing is on when it starts; name (and arg_name) must be string literals
+class Span {
+public:
+    explicit Span(const char* name) : name_(name), begin_(enabled() ? detail::now() : 0) {}
+    ~Span()
+    {
+        if (begin_)
+            detail::record(name_, begin_, arg_name_, arg_);
+    }
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    /// one number to show with the span, e.g. the bytes read
+    void arg(const char* name, const uint64_t value)
+    {
+        arg_name_ = name;
+        arg_ = value;
+    }
+
+private:
+    const char* name_;
+    uint64_t begin_;
+    const char* arg_name_ = nullptr;
+    uint64_t arg_ = 0;
+};
+
+}
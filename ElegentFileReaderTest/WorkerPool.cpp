@@ -0,0 +1,116 @@
+#include "pch.h"
+
+#include "WorkerPool.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace score {
+namespace {
+const size_t page_size = 4096;
+
+void PinToCpu(std::thread& thread, const size_t cpu)
+{
+#if defined(_WIN32)
+    // the 1st processor group: up to 64 logical cpus
+    SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << (cpu % 64));
+#else
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu % CPU_SETSIZE, &cpus);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+#endif
+}
+}
+
+WorkerPool::WorkerPool(size_t workers, const bool pin)
+{
+    const size_t cpus = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+    if (!workers)
+        workers = cpus;
+    threads_.reserve(workers);
+    for (size_t worker = 0; worker < workers; ++worker) {
+        threads_.emplace_back(&WorkerPool::work, this, worker);
+        if (pin)
+            PinToCpu(threads_.back(), worker % cpus);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    start_.notify_all();
+    for (auto& thread : threads_)
+        thread.join();
+}
+
+void WorkerPool::run(const std::function<void(size_t worker)>& task)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = &task;
+    running_ = threads_.size();
+    error_ = nullptr;
+    ++generation_;
+    start_.notify_all();
+    done_.wait(lock, [this] { return 0 == running_; });
+    task_ = nullptr;
+    if (error_)
+        std::rethrow_exception(error_);
+}
+
+void WorkerPool::work(const size_t worker)
+{
+    uint64_t done_generation = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        start_.wait(lock, [&] { return stopping_ || generation_ != done_generation; });
+        if (stopping_)
+            return;
+        done_generation = generation_;
+        const std::function<void(size_t)>& task = *task_;
+
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            task(worker);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        if (error && !error_)
+            error_ = error;
+        if (0 == --running_)
+            done_.notify_all();
+    }
+}
+
+/// where worker's part starts: an even share, rounded up to the next page
+size_t WorkerPool::boundary(const double* const values, const size_t size, const size_t worker) const
+{
+    if (0 == worker)
+        return 0;
+    if (worker >= threads_.size())
+        return size;
+    const size_t share = (size + threads_.size() - 1) / threads_.size();
+    if (worker * share >= size)
+        return size;
+    const uintptr_t address = reinterpret_cast<uintptr_t>(values + worker * share);
+    const uintptr_t page = (address + page_size - 1) & ~uintptr_t(page_size - 1);
+    const size_t index = static_cast<size_t>(page - reinterpret_cast<uintptr_t>(values)) / sizeof(double);
+    return index < size ? index : size;
+}
+
+WorkerPool::Range WorkerPool::partition(const double* const values, const size_t size, const size_t worker) const
+{
+    return Range{boundary(values, size, worker), boundary(values, size, worker + 1)};
+}
+
+}
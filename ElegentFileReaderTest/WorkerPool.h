@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace score {
+
+/// A fixed set of worker threads that all run the same task, each on its own part of the data.
+/// The threads live as long as the pool, so worker i can first-touch (initialize) part i of a big array and compute
+/// on it later: the pages get placed on worker i's NUMA node, and stay local to the thread using them.
+/// pin = true ties worker i to logical cpu i, so the os can't move it to the other socket in between.
+class WorkerPool {
+public:
+    /// 0 workers: one per logical cpu
+    explicit WorkerPool(size_t workers = 0, bool pin = false);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t size() const { return threads_.size(); }
+
+    /// task(worker) on every worker, and wait for them all. The 1st exception a task throws is rethrown here.
+    /// Not reentrant: one run at a time.
+    void run(const std::function<void(size_t worker)>& task);
+
+    /// The part [begin_, end_) of an array of doubles that a worker does: contiguous, and split on page boundaries
+    /// so no page is touched by two workers. The same array and size always split the same way.
+    struct Range {
+        size_t begin_;
+        size_t end_;
+    };
+    Range partition(const double* values, size_t size, size_t worker) const;
+
+private:
+    void work(size_t worker);
+    size_t boundary(const double* values, size_t size, size_t worker) const;
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    const std::function<void(size_t)>* task_ = nullptr;
+    uint64_t generation_ = 0; // a new run for the workers to pick up
+    size_t running_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+};
+
+}
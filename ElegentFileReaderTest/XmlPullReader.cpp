@@ -0,0 +1,387 @@
+#include "pch.h"
+
+#include "XmlPullReader.h"
+
+#include <exception>
+#include <filesystem>
+#include <string>
+
+#include "Ensure.h"
+
+namespace {
+const std::string_view unicode_signature("\xEF\xBB\xBF");
+const std::string_view processing_instruction_begin("<?");
+const std::string_view processing_instruction_end("?>");
+const std::string_view comment_begin("<!--");
+const std::string_view comment_end("-->");
+const std::string_view cdata_begin("<![CDATA[");
+const std::string_view cdata_end("]]>");
+const std::string_view declaration_begin("<!");
+const std::string_view end_element_begin("</");
+
+bool IsWhitespace(const char c)
+{
+    return ' ' == c || '\t' == c || '\r' == c || '\n' == c;
+}
+
+bool IsWhitespace(const std::string_view text)
+{
+    for (const char c : text)
+        if (!IsWhitespace(c))
+            return false;
+    return true;
+}
+
+std::string_view TrimWhitespace(std::string_view text)
+{
+    while (!text.empty() && IsWhitespace(text.front()))
+        text.remove_prefix(1);
+    while (!text.empty() && IsWhitespace(text.back()))
+        text.remove_suffix(1);
+    return text;
+}
+
+/// encode a code point as utf-8; returns the number of bytes written (at most 4)
+size_t EncodeUtf8(uint32_t code_point, char* out)
+{
+    if (code_point < 0x80) {
+        out[0] = static_cast<char>(code_point);
+        return 1;
+    }
+    if (code_point < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (code_point >> 6));
+        out[1] = static_cast<char>(0x80 | (code_point & 0x3F));
+        return 2;
+    }
+    if (code_point < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (code_point >> 12));
+        out[1] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (code_point & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (code_point >> 18));
+    out[1] = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (code_point & 0x3F));
+    return 4;
+}
+
+/// decode one entity reference (without the '&' and ';') into out; returns 0 if it is not one we know
+size_t DecodeEntity(const std::string_view entity, char* out)
+{
+    if (entity == "lt") { *out = '<'; return 1; }
+    if (entity == "gt") { *out = '>'; return 1; }
+    if (entity == "amp") { *out = '&'; return 1; }
+    if (entity == "quot") { *out = '"'; return 1; }
+    if (entity == "apos") { *out = '\''; return 1; }
+
+    if (entity.size() < 2 || '#' != entity[0])
+        return 0;
+    const bool hex = 'x' == entity[1];
+    uint32_t code_point = 0;
+    for (size_t i = hex ? 2 : 1; i < entity.size(); ++i) {
+        const char c = entity[i];
+        uint32_t digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (hex && c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (hex && c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            return 0;
+        code_point = code_point * (hex ? 16 : 10) + digit;
+        if (code_point > 0x10FFFF)
+            return 0;
+    }
+    return EncodeUtf8(code_point, out);
+}
+
+/// decode entity references in place - the decoded text is never longer than the encoded text
+std::string_view DecodeEntities(const std::string_view text)
+{
+    size_t ampersand = text.find('&');
+    if (std::string_view::npos == ampersand)
+        return text;
+
+    char* const begin = const_cast<char*>(text.data());
+    char* out = begin + ampersand;
+    size_t in = ampersand;
+    while (in < text.size()) {
+        if ('&' == text[in]) {
+            const size_t semicolon = text.find(';', in);
+            if (std::string_view::npos != semicolon) {
+                const size_t decoded = DecodeEntity(text.substr(in + 1, semicolon - in - 1), out);
+                if (decoded) {
+                    out += decoded;
+                    in = semicolon + 1;
+                    continue;
+                }
+            }
+        }
+        *out++ = text[in++];
+    }
+    return std::string_view(begin, out - begin);
+}
+}
+
+XmlPullReader::XmlPullReader(const uint32_t read_size)
+    : read_size_(read_size),
+      begin_(0),
+      at_start_of_file_(true),
+      depth_(0),
+      pending_end_element_(false)
+{
+    ENSURE(read_size, >, 0);
+}
+
+void __vectorcall XmlPullReader::open(const char* const filename)
+{
+    ENSURE(!isOpen());
+
+    ifs_.open(std::filesystem::u8path(filename), std::ios::binary);
+    if (!ifs_ || !isOpen()) {
+        ifs_.clear();
+        throw std::exception((std::string("cannot open ") + filename).c_str());
+    }
+}
+
+void __vectorcall XmlPullReader::close()
+{
+    if (ifs_.is_open())
+        ifs_.close();
+    ifs_.clear();
+
+    Buffer().swap(buffer_);
+    Attributes().swap(attributes_);
+    begin_ = 0;
+    at_start_of_file_ = true;
+    name_ = std::string_view();
+    text_ = std::string_view();
+    depth_ = 0;
+    pending_end_element_ = false;
+}
+
+/// move the unconsumed data to the front of the buffer and append the next block
+/// returns false at the end of the file
+bool __vectorcall XmlPullReader::readMore()
+{
+    if (!ifs_.is_open() || ifs_.eof())
+        return false;
+
+    const size_t unconsumed = buffer_.size() - begin_;
+    if (begin_ > 0)
+        std::memmove(buffer_.data(), buffer_.data() + begin_, unconsumed);
+    begin_ = 0;
+
+    buffer_.resize(unconsumed + read_size_);
+    size_t bytes_read = read_size_;
+    if (!ifs_.read(buffer_.data() + unconsumed, read_size_)) {
+        if (ifs_.rdstate() != (std::ios::failbit | std::ios::eofbit))
+            throw std::exception("error on read");
+        bytes_read = static_cast<size_t>(ifs_.gcount());
+    }
+    buffer_.resize(unconsumed + bytes_read);
+    return bytes_read > 0;
+}
+
+/// make sure there are at least `length` unconsumed characters in the buffer
+bool __vectorcall XmlPullReader::available(const size_t length)
+{
+    while (buffer_.size() - begin_ < length)
+        if (!readMore())
+            return false;
+    return true;
+}
+
+bool __vectorcall XmlPullReader::startsWith(const std::string_view prefix)
+{
+    return available(prefix.size()) && 0 == memcmp(buffer_.data() + begin_, prefix.data(), prefix.size());
+}
+
+/// find the pattern at or after `from` (relative to begin_), reading more blocks if necessary
+/// returns npos if the file ends first
+size_t __vectorcall XmlPullReader::find(size_t from, const std::string_view pattern)
+{
+    for (;;) {
+        const std::string_view unconsumed(buffer_.data() + begin_, buffer_.size() - begin_);
+        const size_t found = unconsumed.find(pattern, from);
+        if (std::string_view::npos != found)
+            return found;
+        // the pattern may straddle the block boundary: rescan its possible start
+        if (unconsumed.size() >= pattern.size())
+            from = unconsumed.size() - pattern.size() + 1;
+        if (!readMore())
+            return std::string_view::npos;
+    }
+}
+
+void __vectorcall XmlPullReader::skipPast(const size_t from, const std::string_view pattern)
+{
+    const size_t found = find(from, pattern);
+    if (std::string_view::npos == found)
+        throw std::exception((std::string("unexpected end of document looking for ") + std::string(pattern)).c_str());
+    begin_ += found + pattern.size();
+}
+
+/// find the '>' closing the tag at begin_, ignoring any '>' inside quoted attribute values
+size_t __vectorcall XmlPullReader::findEndOfTag()
+{
+    char quote = 0;
+    for (size_t i = 1;; ++i) {
+        if (begin_ + i >= buffer_.size() && !readMore())
+            throw std::exception("unexpected end of document in a tag");
+
+        const char c = buffer_[begin_ + i];
+        if (quote) {
+            if (c == quote)
+                quote = 0;
+        } else if ('"' == c || '\'' == c) {
+            quote = c;
+        } else if ('>' == c) {
+            return i;
+        }
+    }
+}
+
+/// <name attribute="value" ...> or <name attribute="value" ... />
+XmlPullReader::Token __vectorcall XmlPullReader::readStartElement()
+{
+    const size_t end = findEndOfTag();
+    std::string_view tag(buffer_.data() + begin_ + 1, end - 1);
+    begin_ += end + 1;
+
+    if (!tag.empty() && '/' == tag.back()) {
+        tag.remove_suffix(1);
+        pending_end_element_ = true;
+    }
+
+    size_t i = 0;
+    while (i < tag.size() && !IsWhitespace(tag[i]))
+        ++i;
+    name_ = tag.substr(0, i);
+    if (name_.empty())
+        throw std::exception("element without a name");
+
+    while (i < tag.size()) {
+        while (i < tag.size() && IsWhitespace(tag[i]))
+            ++i;
+        if (i == tag.size())
+            break;
+
+        const size_t equals = tag.find('=', i);
+        if (std::string_view::npos == equals)
+            throw std::exception((std::string("attribute without a value in element ") + std::string(name_)).c_str());
+        const std::string_view attribute_name = TrimWhitespace(tag.substr(i, equals - i));
+
+        size_t quote = equals + 1;
+        while (quote < tag.size() && IsWhitespace(tag[quote]))
+            ++quote;
+        if (quote == tag.size() || ('"' != tag[quote] && '\'' != tag[quote]))
+            throw std::exception((std::string("unquoted attribute value in element ") + std::string(name_)).c_str());
+        const size_t closing_quote = tag.find(tag[quote], quote + 1);
+        if (std::string_view::npos == closing_quote)
+            throw std::exception((std::string("unterminated attribute value in element ") + std::string(name_)).c_str());
+
+        attributes_.push_back({attribute_name, DecodeEntities(tag.substr(quote + 1, closing_quote - quote - 1))});
+        i = closing_quote + 1;
+    }
+
+    ++depth_;
+    return Token::StartElement;
+}
+
+/// </name>
+XmlPullReader::Token __vectorcall XmlPullReader::readEndElement()
+{
+    const size_t end = find(end_element_begin.size(), ">");
+    if (std::string_view::npos == end)
+        throw std::exception("unexpected end of document in an end tag");
+
+    name_ = TrimWhitespace(std::string_view(buffer_.data() + begin_ + end_element_begin.size(), end - end_element_begin.size()));
+    begin_ += end + 1;
+
+    ENSURE(depth_, >, 0);
+    --depth_;
+    return Token::EndElement;
+}
+
+/// character data up to the next markup
+XmlPullReader::Token __vectorcall XmlPullReader::readText(const size_t length)
+{
+    text_ = std::string_view(buffer_.data() + begin_, length);
+    begin_ += length;
+    text_ = DecodeEntities(text_);
+    return Token::Text;
+}
+
+/// <![CDATA[ ... ]]> - returned as is, without decoding
+XmlPullReader::Token __vectorcall XmlPullReader::readCData()
+{
+    const size_t end = find(cdata_begin.size(), cdata_end);
+    if (std::string_view::npos == end)
+        throw std::exception("unexpected end of document in CDATA");
+
+    text_ = std::string_view(buffer_.data() + begin_ + cdata_begin.size(), end - cdata_begin.size());
+    begin_ += end + cdata_end.size();
+    return Token::Text;
+}
+
+XmlPullReader::Token __vectorcall XmlPullReader::next()
+{
+    attributes_.clear();
+
+    if (pending_end_element_) { // the end of <name />: name_ is still valid; we haven't touched the buffer since
+        pending_end_element_ = false;
+        --depth_;
+        return Token::EndElement;
+    }
+
+    if (at_start_of_file_) {
+        at_start_of_file_ = false;
+        if (startsWith(unicode_signature))
+            begin_ += unicode_signature.size();
+    }
+
+    for (;;) {
+        // character data up to the next '<'
+        const size_t markup = find(0, "<");
+        const size_t text_length = std::string_view::npos == markup ? buffer_.size() - begin_ : markup;
+        if (text_length > 0) {
+            if (!IsWhitespace(std::string_view(buffer_.data() + begin_, text_length)))
+                return readText(text_length);
+            begin_ += text_length;
+        }
+        if (std::string_view::npos == markup)
+            return Token::EndOfDocument;
+
+        if (startsWith(end_element_begin))
+            return readEndElement();
+        if (startsWith(processing_instruction_begin))
+            skipPast(processing_instruction_begin.size(), processing_instruction_end);
+        else if (startsWith(comment_begin))
+            skipPast(comment_begin.size(), comment_end);
+        else if (startsWith(cdata_begin))
+            return readCData();
+        else if (startsWith(declaration_begin))
+            skipPast(declaration_begin.size(), ">");
+        else
+            return readStartElement();
+    }
+}
+
+std::string_view __vectorcall XmlPullReader::attribute(const std::string_view name) const
+{
+    for (const auto& attribute : attributes_)
+        if (attribute.name_ == name)
+            return attribute.value_;
+    return std::string_view();
+}
+
+bool __vectorcall XmlPullReader::hasAttribute(const std::string_view name) const
+{
+    for (const auto& attribute : attributes_)
+        if (attribute.name_ == name)
+            return true;
+    return false;
+}
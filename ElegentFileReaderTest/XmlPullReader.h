@@ -0,0 +1,97 @@
+#pragma once
+
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+#include "ElegentFileReader.h"
+
+/// A forward only, pull style XML tokenizer in the spirit of ElegentFileReader:
+/// the file is read in read_size blocks, and names, attribute values and text are returned as
+/// string_views into the block buffer. Entities are decoded in place, there is no DOM and no copying.
+/// Every view is invalidated by the next call to next().
+/// Processing instructions, comments and DOCTYPEs are skipped; CDATA is returned as Text.
+class XmlPullReader {
+    using Buffer = std::vector<char>;
+
+public:
+    enum class Token {
+        StartElement,
+        EndElement,   // also returned straight after the StartElement of an empty element (<name />)
+        Text,         // character data that is not just whitespace
+        EndOfDocument
+    };
+
+    struct Attribute {
+        std::string_view name_;
+        std::string_view value_;
+    };
+    using Attributes = std::vector<Attribute>;
+
+    explicit XmlPullReader(uint32_t read_size = static_cast<uint32_t>(64_Kb));
+
+    void __vectorcall open(const char* filename);
+    void __vectorcall close();
+
+    bool __vectorcall isOpen() const
+    {
+        return ifs_.is_open();
+    }
+
+    Token __vectorcall next();
+
+    /// the element name of the current StartElement or EndElement
+    std::string_view name() const
+    {
+        return name_;
+    }
+
+    /// the attributes of the current StartElement
+    const Attributes& attributes() const
+    {
+        return attributes_;
+    }
+
+    /// the value of the named attribute of the current StartElement; empty if there is no such attribute
+    std::string_view __vectorcall attribute(std::string_view name) const;
+
+    bool __vectorcall hasAttribute(std::string_view name) const;
+
+    /// the character data of the current Text
+    std::string_view text() const
+    {
+        return text_;
+    }
+
+    /// the number of elements we are currently inside
+    size_t depth() const
+    {
+        return depth_;
+    }
+
+private:
+    bool __vectorcall readMore();
+    bool __vectorcall available(size_t length);
+    size_t __vectorcall find(size_t from, std::string_view pattern);
+    void __vectorcall skipPast(size_t from, std::string_view pattern);
+    size_t __vectorcall findEndOfTag();
+    bool __vectorcall startsWith(std::string_view prefix);
+
+    Token __vectorcall readStartElement();
+    Token __vectorcall readEndElement();
+    Token __vectorcall readText(size_t length);
+    Token __vectorcall readCData();
+
+    std::ifstream ifs_;
+    const uint32_t read_size_;
+
+    Buffer buffer_;
+    size_t begin_;      // the start of the unconsumed data in buffer_; every offset used while scanning is relative to this
+    bool at_start_of_file_;
+
+    std::string_view name_;
+    std::string_view text_;
+    Attributes attributes_;
+    size_t depth_;
+    bool pending_end_element_;
+};
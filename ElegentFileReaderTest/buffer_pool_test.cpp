@@ -0,0 +1,102 @@
+#include "pch.h"
+
+#include <cstring>
+
+#include "BufferPool.h"
+#include "ElegentFileReader.h"
+#include "TestHelpers.h"
+
+using test::ReadAll;
+
+namespace {
+const char* const small_file = "TestFiles\\fr_records.tbl";
+const char* const other_file = "TestFiles\\input_variable\\CASHFLOWS_INFO_5b60b791-33be-4b80-ac8b-0562ac731092.tbl";
+}
+
+TEST(BufferPool, ReopenKeepsTheBuffer)
+{
+    ElegentFileReader efr(4_Kb, '\t');
+    efr.open(small_file);
+    const char* const first_field = efr.readRecord()[0];
+    efr.reopen(other_file);
+    EXPECT_EQ(first_field, efr.readRecord()[0]);
+    efr.reopen(small_file);
+    EXPECT_EQ(first_field, efr.readRecord()[0]);
+    efr.seek(0);
+    EXPECT_EQ(ReadAll(small_file), ReadAll(efr));
+
+    // as if newly opened
+    efr.setErrorPolicy(OnError::Collect, 7);
+    efr.reopen(other_file);
+    EXPECT_EQ(0U, efr.ftell());
+    EXPECT_EQ(OnError::Collect, efr.errors().onError());
+    ReadAll(efr);
+    EXPECT_LT(0U, efr.errors().count());
+}
+
+TEST(BufferPool, SharedByReaders)
+{
+    BufferPool pool;
+    const char* first_field = nullptr;
+    {
+        ElegentFileReader efr(4_Kb, '\t');
+        efr.setBufferPool(&pool);
+        efr.open(small_file);
+        first_field = efr.readRecord()[0];
+        efr.close(); // gives them back
+        EXPECT_EQ(1U, pool.size());
+        efr.open(small_file);
+        EXPECT_EQ(0U, pool.size());
+        EXPECT_EQ(first_field, efr.readRecord()[0]);
+    } // so does the destructor
+    EXPECT_EQ(1U, pool.size());
+
+    for (int i = 0; i < 3; ++i) {
+        ElegentFileReader efr(4_Kb, '\t');
+        efr.setBufferPool(&pool);
+        efr.open(other_file);
+        EXPECT_EQ(first_field, efr.readRecord()[0]);
+        efr.seek(0);
+        EXPECT_EQ(ReadAll(other_file), ReadAll(efr));
+    }
+    EXPECT_EQ(4U, pool.reused());
+
+    // two at once: the 2nd gets new buffers, and both are kept afterwards
+    {
+        ElegentFileReader efr1(4_Kb, '\t');
+        ElegentFileReader efr2(4_Kb, '\t');
+        efr1.setBufferPool(&pool);
+        efr2.setBufferPool(&pool);
+        efr1.open(small_file);
+        efr2.open(other_file);
+        EXPECT_EQ(0U, pool.size());
+        EXPECT_EQ(ReadAll(other_file), ReadAll(efr2));
+        EXPECT_EQ(ReadAll(small_file), ReadAll(efr1));
+    }
+    EXPECT_EQ(2U, pool.size());
+
+    BufferPool small_pool(std::pmr::new_delete_resource(), 1);
+    small_pool.give(BufferPool::Buffers{BufferPool::Buffer(100), {}});
+    small_pool.give(BufferPool::Buffers{BufferPool::Buffer(100), {}});
+    EXPECT_EQ(1U, small_pool.size());
+    EXPECT_EQ(0U, small_pool.take().buffer_.size());
+}
+
+TEST(BufferPool, HugePages)
+{
+    HugePageResource huge_pages;
+    for (const size_t size : {size_t(100), HugePageResource::huge_page_size + 1}) {
+        void* const p = huge_pages.allocate(size);
+        std::memset(p, 'x', size);
+        huge_pages.deallocate(p, size);
+    }
+
+    // a 4 MB read_size: the buffer is in huge pages
+    BufferPool pool(&huge_pages);
+    ElegentFileReader efr(4 * 1024_Kb, '\t');
+    efr.setBufferPool(&pool);
+    efr.open("TestFiles\\Meritz.tbl");
+    EXPECT_EQ(ReadAll("TestFiles\\Meritz.tbl"), ReadAll(efr));
+    efr.close();
+    EXPECT_EQ(1U, pool.size());
+}
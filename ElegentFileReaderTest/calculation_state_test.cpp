@@ -0,0 +1,227 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "CalculationState.h"
+#include "TestHelpers.h"
+
+using score::CalculationState;
+using score::DoubleState;
+using score::detail::Isa;
+using test::MixedColumn;
+using test::StateValue;
+
+namespace {
+const uint64_t guard = 0x0123456789abcdefull;
+
+/// every size up to a few vectors, at every alignment of a double, with guards either side
+void CheckFill(const Isa isa, const bool non_temporal)
+{
+    const uint64_t pattern = DoubleState::fill_pattern_of(CalculationState::NotCalculated);
+    std::vector<uint64_t> buffer(200);
+    for (size_t offset = 0; offset < 8; ++offset) {
+        for (size_t size = 0; size < 150; ++size) {
+            std::fill(buffer.begin(), buffer.end(), guard);
+            score::detail::fill_pattern(isa, buffer.data() + 1 + offset, size, pattern, non_temporal);
+            for (size_t i = 0; i < buffer.size(); ++i) {
+                const bool filled = i >= 1 + offset && i < 1 + offset + size;
+                ASSERT_EQ(filled ? pattern : guard, buffer[i])
+                    << "isa " << static_cast<int>(isa) << " offset " << offset << " size " << size << " at " << i;
+            }
+        }
+    }
+}
+}
+
+TEST(CalculationState, FillKernels)
+{
+    for (const auto isa : {Isa::Scalar, Isa::Avx2, Isa::Avx512}) {
+        if (!score::detail::is_supported(isa))
+            continue;
+        CheckFill(isa, false);
+        CheckFill(isa, true);
+    }
+    EXPECT_TRUE(score::detail::is_supported(score::detail::best_isa()));
+}
+
+TEST(CalculationState, SetNotCalculated)
+{
+    // inline, dispatched, and big enough for streaming stores
+    for (const size_t size : {size_t(1), size_t(16), size_t(17), size_t(240), score::detail::non_temporal_fill_bytes / sizeof(double) + 3}) {
+        std::vector<double> values(size + 1, 1.5);
+        DoubleState::set_not_calculated_score(values.data(), size);
+        EXPECT_TRUE(DoubleState::is<CalculationState::NotCalculated>(values.front()));
+        EXPECT_TRUE(DoubleState::is<CalculationState::NotCalculated>(values[size - 1]));
+        EXPECT_EQ(1.5, values[size]);
+        EXPECT_NE(values[size / 2], values[size / 2]); // a NaN
+
+        DoubleState::set_not_calculated_saturn(values.data(), size);
+        for (size_t i = 0; i < size; ++i)
+            ASSERT_EQ(CalculationState::NotCalculatedSaturn, DoubleState::get_state(values[i])) << size << " at " << i;
+    }
+}
+
+namespace {
+bool IsUncalculated(const double value)
+{
+    const CalculationState state = DoubleState::get_state(value);
+    return state == CalculationState::NotCalculated || state == CalculationState::NotCalculatedSaturn || state == CalculationState::Busy;
+}
+}
+
+TEST(CalculationState, ScanKernels)
+{
+    for (const auto isa : {Isa::Scalar, Isa::Avx2, Isa::Avx512}) {
+        if (!score::detail::is_supported(isa))
+            continue;
+
+        for (size_t size = 0; size < 300; size += 1 + size / 16) {
+            const std::vector<double> column = MixedColumn(size + 1, static_cast<unsigned>(size), true);
+            const double* const values = column.data() + 1; // not vector aligned
+
+            score::detail::StateCounts expected;
+            size_t first_uncalculated = size;
+            std::vector<uint64_t> expected_mask((size + 63) / 64);
+            for (size_t i = 0; i < size; ++i) {
+                switch (DoubleState::get_state(values[i])) {
+                case CalculationState::NotCalculated: ++expected.not_calculated_; break;
+                case CalculationState::NotCalculatedSaturn: ++expected.not_calculated_saturn_; break;
+                case CalculationState::NoAvg: ++expected.no_avg_; break;
+                case CalculationState::Busy: ++expected.busy_; break;
+                default: ++expected.calculated_;
+                }
+                if (IsUncalculated(values[i]))
+                    first_uncalculated = std::min(first_uncalculated, i);
+                else
+                    expected_mask[i / 64] |= uint64_t(1) << (i % 64);
+            }
+
+            const auto counts = score::detail::count_states(isa, values, size);
+            EXPECT_EQ(expected.calculated_, counts.calculated_) << static_cast<int>(isa) << " size " << size;
+            EXPECT_EQ(expected.not_calculated_, counts.not_calculated_) << static_cast<int>(isa) << " size " << size;
+            EXPECT_EQ(expected.not_calculated_saturn_, counts.not_calculated_saturn_) << static_cast<int>(isa) << " size " << size;
+            EXPECT_EQ(expected.no_avg_, counts.no_avg_) << static_cast<int>(isa) << " size " << size;
+            EXPECT_EQ(expected.busy_, counts.busy_) << static_cast<int>(isa) << " size " << size;
+
+            EXPECT_EQ(first_uncalculated, score::detail::find_first_uncalculated(isa, values, size)) << static_cast<int>(isa) << " size " << size;
+
+            std::vector<uint64_t> mask(expected_mask.size(), ~uint64_t(0));
+            score::detail::calculated_mask(isa, values, size, mask.data());
+            EXPECT_EQ(expected_mask, mask) << static_cast<int>(isa) << " size " << size;
+        }
+
+        // a single uncalculated value anywhere in a calculated column
+        std::vector<double> column(130, 2.5);
+        for (size_t at = 0; at < column.size(); ++at) {
+            column[at] = StateValue(CalculationState::Busy);
+            ASSERT_EQ(at, score::detail::find_first_uncalculated(isa, column.data(), column.size())) << static_cast<int>(isa);
+            column[at] = 2.5;
+        }
+        EXPECT_EQ(column.size(), score::detail::find_first_uncalculated(isa, column.data(), column.size()));
+    }
+}
+
+TEST(CalculationState, IsAllCalculated)
+{
+    std::vector<double> column(240 * 10, 1.0);
+    EXPECT_TRUE(DoubleState::is_all_calculated(column.data(), column.size()));
+    DoubleState::set<CalculationState::NotCalculatedSaturn>(column[1234]);
+    EXPECT_FALSE(DoubleState::is_all_calculated(column.data(), column.size()));
+    EXPECT_EQ(1234, DoubleState::find_first_uncalculated(column.data(), column.size()));
+    EXPECT_EQ(1, DoubleState::count_states(column.data(), column.size()).not_calculated_saturn_);
+
+    DoubleState::set_not_calculated_score(column.data(), column.size());
+    EXPECT_EQ(column.size(), DoubleState::count_states(column.data(), column.size()).not_calculated_);
+}
+
+namespace {
+/// the summary never claims more than the values say
+void CheckSummary(const std::vector<double>& column, const score::BlockSummary& summary)
+{
+    for (size_t block = 0; block < summary.blocks(); ++block) {
+        for (size_t i = block * 64; i < block * 64 + summary.block_length(block); ++i) {
+            if (summary.block(block) == score::BlockSummary::AllCalculated) {
+                ASSERT_FALSE(IsUncalculated(column[i])) << "block " << block << " at " << i;
+            } else if (summary.block(block) == score::BlockSummary::AllNotCalculated) {
+                ASSERT_TRUE(DoubleState::is<CalculationState::NotCalculated>(column[i])) << "block " << block << " at " << i;
+            }
+        }
+    }
+}
+}
+
+TEST(CalculationState, BlockSummary)
+{
+    using score::BlockSummary;
+    std::vector<double> column(64 * 5 + 10, 1.0);
+    BlockSummary summary(column.data(), column.size());
+    EXPECT_EQ(6, summary.blocks());
+    EXPECT_EQ(10, summary.block_length(5));
+    EXPECT_TRUE(summary.is_all_calculated());
+
+    DoubleState::set_not_calculated_score(column.data(), summary);
+    for (size_t block = 0; block < summary.blocks(); ++block)
+        EXPECT_EQ(BlockSummary::AllNotCalculated, summary.block(block));
+    EXPECT_EQ(0, DoubleState::find_first_uncalculated(column.data(), summary));
+
+    // calculate blocks 0 and 1, and block 2 but for one value
+    for (size_t i = 0; i < 3 * 64; ++i) {
+        column[i] = 2.0;
+        summary.calculated(i);
+    }
+    DoubleState::set<CalculationState::Busy>(column.data(), 150, summary);
+    EXPECT_EQ(150, DoubleState::find_first_uncalculated(column.data(), summary));
+    EXPECT_EQ(BlockSummary::AllCalculated, summary.block(0)); // found out by the check
+    EXPECT_EQ(BlockSummary::Mixed, summary.block(2));
+    CheckSummary(column, summary);
+
+    // a reset leaves the blocks that are still NotCalculated alone: a value changed behind the summary's back shows it
+    column[64 * 4 + 1] = 3.0;
+    DoubleState::set_not_calculated_score(column.data(), summary);
+    EXPECT_EQ(3.0, column[64 * 4 + 1]);
+    for (size_t i = 0; i < 3 * 64; ++i)
+        ASSERT_TRUE(DoubleState::is<CalculationState::NotCalculated>(column[i])) << i;
+
+    DoubleState::set_not_calculated_saturn(column.data(), summary);
+    EXPECT_EQ(BlockSummary::Mixed, summary.block(4));
+    EXPECT_EQ(0, DoubleState::find_first_uncalculated(column.data(), summary));
+    CheckSummary(column, summary);
+}
+
+TEST(CalculationState, BlockSummary_Random)
+{
+    // random stores, resets and checks: the summary stays true to the column, and the checks agree with a full scan
+    std::vector<double> column(64 * 40 + 33, 1.0);
+    score::BlockSummary summary(column.size());
+    unsigned random = 7;
+    for (int step = 0; step < 20000; ++step) {
+        random = random * 1103515245 + 12345;
+        const size_t index = (random >> 8) % column.size();
+        switch ((random >> 28) % 8) {
+        case 0:
+            if (step % 1000 == 0)
+                DoubleState::set_not_calculated_score(column.data(), summary);
+            break;
+        case 1:
+            DoubleState::set<CalculationState::Busy>(column.data(), index, summary);
+            break;
+        case 2:
+            DoubleState::set<CalculationState::NoAvg>(column.data(), index, summary);
+            break;
+        case 3:
+            DoubleState::set<CalculationState::NotCalculated>(column.data(), index, summary);
+            break;
+        default:
+            column[index] = static_cast<double>(step);
+            summary.calculated(index);
+        }
+
+        if (step % 97 == 0) {
+            if (step % 3 == 0)
+                summary.refresh(column.data(), index / 64);
+            ASSERT_EQ(DoubleState::find_first_uncalculated(column.data(), column.size()), DoubleState::find_first_uncalculated(column.data(), summary)) << step;
+            CheckSummary(column, summary);
+        }
+    }
+}
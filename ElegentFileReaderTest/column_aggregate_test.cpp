@@ -0,0 +1,107 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "ColumnAggregate.h"
+#include "TestHelpers.h"
+
+using score::CalculationState;
+using score::ColumnAggregate;
+using score::DoubleState;
+using score::detail::Isa;
+using test::MixedColumn;
+using test::StateValue;
+
+namespace {
+const Isa isas[] = {Isa::Scalar, Isa::Avx2, Isa::Avx512};
+}
+
+TEST(ColumnAggregate, Aggregate)
+{
+    for (const auto isa : isas) {
+        if (!score::detail::is_supported(isa))
+            continue;
+
+        for (size_t size = 0; size < 300; size += 1 + size / 8) {
+            const std::vector<double> column = MixedColumn(size + 1, static_cast<unsigned>(size));
+            const double* const values = column.data() + 1; // not vector aligned
+
+            ColumnAggregate expected;
+            for (size_t i = 0; i < size; ++i) {
+                const auto state = DoubleState::get_state(values[i]);
+                if (state == CalculationState::NoAvg || state == CalculationState::NotCalculated
+                    || state == CalculationState::NotCalculatedSaturn || state == CalculationState::Busy)
+                    continue;
+                expected.sum_ += values[i];
+                ++expected.count_;
+                expected.min_ = std::min(expected.min_, values[i]);
+                expected.max_ = std::max(expected.max_, values[i]);
+            }
+
+            const ColumnAggregate aggregate = score::detail::aggregate(isa, values, size);
+            EXPECT_EQ(expected.sum_, aggregate.sum_) << static_cast<int>(isa) << " size " << size;
+            EXPECT_EQ(expected.count_, aggregate.count_) << static_cast<int>(isa) << " size " << size;
+            EXPECT_EQ(expected.min_, aggregate.min_) << static_cast<int>(isa) << " size " << size;
+            EXPECT_EQ(expected.max_, aggregate.max_) << static_cast<int>(isa) << " size " << size;
+        }
+    }
+}
+
+TEST(ColumnAggregate, NaNsAndInfinities)
+{
+    // -inf has the high dword just below NotCalculatedSaturn; neither it nor a NaN is a state
+    std::vector<double> column(37, 1.0);
+    column[5] = -std::numeric_limits<double>::infinity();
+    column[20] = std::numeric_limits<double>::quiet_NaN();
+    column[30] = StateValue(CalculationState::NoAvg);
+    for (const auto isa : isas) {
+        if (!score::detail::is_supported(isa))
+            continue;
+        const ColumnAggregate aggregate = score::detail::aggregate(isa, column.data(), column.size());
+        EXPECT_EQ(36, aggregate.count_) << static_cast<int>(isa);
+        EXPECT_NE(aggregate.sum_, aggregate.sum_) << static_cast<int>(isa); // the NaN
+        EXPECT_EQ(-std::numeric_limits<double>::infinity(), aggregate.min_) << static_cast<int>(isa);
+        EXPECT_EQ(1.0, aggregate.max_) << static_cast<int>(isa);
+    }
+}
+
+TEST(ColumnAggregate, Mean)
+{
+    const double values[] = {2.0, StateValue(CalculationState::NoAvg), 4.0};
+    EXPECT_EQ(3.0, score::aggregate(values, 3).mean());
+
+    const double no_avg = score::aggregate(values + 1, 1).mean();
+    EXPECT_EQ(CalculationState::NoAvg, DoubleState::get_state(no_avg));
+}
+
+TEST(ColumnAggregate, Accumulate)
+{
+    const size_t months = 131;
+    for (const auto isa : isas) {
+        if (!score::detail::is_supported(isa))
+            continue;
+
+        std::vector<double> sums(months + 1, 0.0), expected_sums(months + 1, 0.0);
+        std::vector<uint64_t> counts(months + 1, 0), expected_counts(months + 1, 0);
+        for (unsigned scenario = 0; scenario < 10; ++scenario) {
+            // one short of the end: the guard stays untouched
+            const std::vector<double> values = MixedColumn(months, scenario);
+            score::detail::accumulate(isa, values.data(), months, sums.data(), counts.data());
+            score::detail::accumulate(Isa::Scalar, values.data(), months, expected_sums.data(), expected_counts.data());
+        }
+        EXPECT_EQ(expected_sums, sums) << static_cast<int>(isa);
+        EXPECT_EQ(expected_counts, counts) << static_cast<int>(isa);
+        EXPECT_EQ(0, counts[months]);
+
+        std::vector<double> means(months);
+        score::mean(sums.data(), counts.data(), months, means.data());
+        for (size_t i = 0; i < months; ++i) {
+            if (counts[i])
+                EXPECT_EQ(sums[i] / counts[i], means[i]);
+            else
+                EXPECT_EQ(CalculationState::NoAvg, DoubleState::get_state(means[i]));
+        }
+    }
+}
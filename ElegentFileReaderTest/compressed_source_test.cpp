@@ -0,0 +1,173 @@
+#include "pch.h"
+
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CSVFileIndex.h"
+#include "CompressedSource.h"
+#include "ElegentFileReader.h"
+#include "InputSource.h"
+#include "TestHelpers.h"
+
+#if ELEGENT_READER_GZIP
+#include <zlib.h>
+
+namespace {
+/// about 2 MB: more than one chunk, and blocks of 100 records by key
+std::string Text()
+{
+    std::string text = "key\trecord\tvalue\n";
+    for (int i = 0; i < 100000; ++i)
+        text += "K" + std::to_string(i / 100) + "\t" + std::to_string(i) + "\t" + std::to_string(i * 0.5) + "\n";
+    return text;
+}
+
+/// window_bits: 15 + 16 for a gzip member, -15 for raw deflate
+std::string Deflate(const char* const text, const size_t size, const int window_bits)
+{
+    z_stream stream = {};
+    deflateInit2(&stream, 6, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY);
+    std::string result(deflateBound(&stream, static_cast<uLong>(size)), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text));
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = reinterpret_cast<Bytef*>(&result[0]);
+    stream.avail_out = static_cast<uInt>(result.size());
+    deflate(&stream, Z_FINISH);
+    result.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result;
+}
+
+/// gzip, split into members of member_size bytes of the text
+std::string Gzip(const std::string& text, const size_t member_size)
+{
+    std::string result;
+    for (size_t begin = 0; begin < text.size(); begin += member_size)
+        result += Deflate(text.data() + begin, std::min(member_size, text.size() - begin), 15 + 16);
+    return result;
+}
+
+void Append32(std::string& s, const uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        s += static_cast<char>(value >> (8 * i));
+}
+
+/// what bgzip writes: members of up to 64 KB, each with its size in a BC extra field, and an empty member at the end
+std::string Bgzf(const std::string& text)
+{
+    std::string result;
+    const size_t member_text = 60000;
+    for (size_t begin = 0; begin <= text.size(); begin += member_text) {
+        const size_t size = std::min(member_text, text.size() - begin);
+        const std::string deflated = Deflate(text.data() + begin, size, -15);
+        const size_t member_size = 18 + deflated.size() + 8;
+        result += std::string("\x1f\x8b\x08\x04\0\0\0\0\0\xff\x06\0BC\x02\0", 16);
+        result += static_cast<char>((member_size - 1) & 0xff);
+        result += static_cast<char>((member_size - 1) >> 8);
+        result += deflated;
+        Append32(result, crc32(0, reinterpret_cast<const Bytef*>(text.data() + begin), static_cast<uInt>(size)));
+        Append32(result, static_cast<uint32_t>(size));
+    }
+    return result;
+}
+
+std::vector<std::string> Keys(ElegentFileReader& efr)
+{
+    std::vector<std::string> keys;
+    while (!efr.isEOF()) {
+        const auto& record = efr.readRecord();
+        keys.push_back(std::string(record[0]) + "/" + record[1]);
+    }
+    return keys;
+}
+
+std::vector<std::string> Keys(std::unique_ptr<InputSource> source, const uint32_t read_size = 64_Kb)
+{
+    ElegentFileReader efr(read_size, '\t');
+    efr.open(std::move(source));
+    return Keys(efr);
+}
+}
+
+TEST(CompressedSource, Gzip)
+{
+    const std::string text = Text();
+    const std::vector<std::string> expected = Keys(std::make_unique<MemorySource>(text.data(), text.size()));
+
+    // one member; many members, with padding after them (ignored)
+    for (const size_t member_size : {text.size(), size_t(300000)}) {
+        const std::string gzip = Gzip(text, member_size) + std::string(member_size < text.size() ? 100 : 0, '\0');
+        const std::string path = test::WriteFile(test::TempPath("efr_test.tbl.gz"), gzip);
+        ElegentFileReader efr(4_Kb, '\t');
+        efr.open(path.c_str());
+        EXPECT_EQ(InputSource::unknown_size, efr.fileSize());
+        EXPECT_EQ(expected, Keys(efr));
+        EXPECT_EQ(text.size(), efr.fileSize());
+
+        CompressedSource source(std::make_unique<MemorySource>(gzip.data(), gzip.size()));
+        EXPECT_EQ(CompressedSource::Format::Gzip, source.format());
+        EXPECT_FALSE(source.isBgzf());
+        std::string read(text.size(), '\0');
+        EXPECT_EQ(text.size(), source.read(0, &read[0], read.size() + 100));
+        EXPECT_EQ(text, read);
+        EXPECT_EQ((text.size() + member_size - 1) / member_size, source.checkpoints().size());
+    }
+}
+
+TEST(CompressedSource, BgzfInParallel)
+{
+    const std::string text = Text();
+    const std::string bgzf = Bgzf(text);
+    const std::vector<std::string> expected = Keys(std::make_unique<MemorySource>(text.data(), text.size()));
+
+    for (const size_t workers : {1u, 3u}) {
+        auto source = std::make_unique<CompressedSource>(std::make_unique<MemorySource>(bgzf.data(), bgzf.size()), workers);
+        EXPECT_TRUE(source->isBgzf());
+        EXPECT_EQ(expected, Keys(std::move(source), 16_Kb));
+    }
+
+    // an index, and seeks back to what it found: they restart at the member before
+    const std::string path = test::WriteFile(test::TempPath("efr_test_bgzf.tbl.gz"), bgzf);
+    ElegentFileReader efr(4_Kb, '\t');
+    efr.open(path.c_str());
+    CSVFileIndex index;
+    index.createIndex(efr, 0);
+    std::vector<CSVFileIndex::FileBlockInfo> blocks;
+    index.find({"K999", "K0", "K500"}, blocks);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        EXPECT_EQ(100U, blocks[i].record_count_);
+        efr.seek(blocks[i].begin_offset_);
+        EXPECT_EQ(std::to_string(i == 0 ? 99900 : i == 1 ? 0 : 50000), efr.readRecord()[1]);
+    }
+}
+
+TEST(CompressedSource, Errors)
+{
+    const std::string text = Text();
+    const std::string gzip = Gzip(text, text.size());
+    const std::string cut_short = gzip.substr(0, gzip.size() / 2);
+    ElegentFileReader efr(4_Kb, '\t');
+    efr.open(std::make_unique<CompressedSource>(std::make_unique<MemorySource>(cut_short.data(), cut_short.size())));
+    EXPECT_THROW(Keys(efr), std::exception);
+
+    std::string corrupt = gzip;
+    corrupt[gzip.size() / 2] ^= 0x55;
+    efr.close();
+    efr.open(std::make_unique<CompressedSource>(std::make_unique<MemorySource>(corrupt.data(), corrupt.size())));
+    EXPECT_THROW(Keys(efr), std::exception);
+
+    EXPECT_THROW(CompressedSource(std::make_unique<MemorySource>(text.data(), text.size())), std::exception);
+#if !ELEGENT_READER_ZSTD
+    const char zstd[] = "\x28\xb5\x2f\xfd....";
+    EXPECT_THROW(CompressedSource(std::make_unique<MemorySource>(zstd, sizeof(zstd))), std::exception);
+#endif
+}
+#endif
+
+TEST(CompressedSource, Uncompressed)
+{
+    EXPECT_NE(nullptr, dynamic_cast<FileSource*>(OpenInput("TestFiles\\fr_records.tbl").get()));
+}
@@ -0,0 +1,107 @@
+#include "pch.h"
+
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "ElegentFileReader.h"
+#include "ElegentFileWriter.h"
+#include "TestHelpers.h"
+
+using test::Contents;
+using test::TempPath;
+
+TEST(ElegentFileWriter, Format)
+{
+    const std::string path = TempPath("efw_test_format.tbl");
+    ElegentFileWriter efw(64, ',', ElegentFileWriter::LineEnd::Lf);
+    efw.open(path.c_str());
+    efw.field("a");
+    efw.field(1);
+    efw.field(-2LL);
+    efw.field(0.1);
+    efw.field(1e300);
+    efw.field(std::string_view());
+    efw.endRecord();
+    efw.endRecord(); // a blank line
+    efw.field(uint64_t(18446744073709551615u));
+    efw.endRecord();
+    const std::string expected = "a,1,-2,0.1,1e+300,\n\n18446744073709551615\n";
+    EXPECT_EQ(expected.size(), efw.bytesWritten());
+    efw.close();
+    EXPECT_EQ(expected, Contents(path));
+
+    // CRLF, and the unicode signature - which the reader skips
+    ElegentFileWriter signed_crlf(64, '\t', ElegentFileWriter::LineEnd::CrLf, true);
+    signed_crlf.open(path.c_str());
+    signed_crlf.field("key");
+    signed_crlf.field("value");
+    signed_crlf.endRecord();
+    signed_crlf.close();
+    EXPECT_EQ("\xEF\xBB\xBFkey\tvalue\r\n", Contents(path));
+    ElegentFileReader efr;
+    efr.open(path.c_str());
+    EXPECT_STREQ("key", efr.readRecord()[0]);
+
+    EXPECT_ANY_THROW(ElegentFileWriter(32));
+    EXPECT_ANY_THROW(efw.open(TempPath("no such directory/x.tbl").c_str()));
+}
+
+TEST(ElegentFileWriter, ReadsBack)
+{
+    // doubles in the fewest digits that read back the same, records and fields across block ends, a field bigger than a block
+    std::vector<double> values = {0.0, -0.0, 1.0 / 3, 2.0 / 3, 1e-308, 4.9e-324, std::numeric_limits<double>::max(), 123456789.125};
+    double x = 0.5;
+    for (int i = 0; i < 2000; ++i) {
+        x = std::fmod(x * 3.7 + 0.123456789, 1.0);
+        values.push_back((x - 0.5) * std::pow(10.0, i % 40 - 20));
+    }
+    const std::string big(1000, 'x');
+    for (const bool write_behind : {false, true}) {
+        for (const uint32_t block_size : {33u, 100u, 4096u}) {
+            const std::string path = TempPath("efw_test_reads_back.tbl");
+            ElegentFileWriter efw(block_size, '\t', ElegentFileWriter::LineEnd::CrLf, false, write_behind);
+            efw.open(path.c_str());
+            for (size_t i = 0; i < values.size(); ++i) {
+                efw.field("R" + std::to_string(i));
+                efw.field(values[i]);
+                if (i % 100 == 0)
+                    efw.field(big);
+                efw.endRecord();
+            }
+            const uint64_t bytes = efw.bytesWritten();
+            efw.close();
+            EXPECT_EQ(bytes, std::filesystem::file_size(path));
+
+            ElegentFileReader efr(7, '\t');
+            efr.open(path.c_str());
+            for (size_t i = 0; i < values.size(); ++i) {
+                const auto& record = efr.readRecord();
+                ASSERT_EQ(i % 100 == 0 ? 3U : 2U, record.size()) << i;
+                EXPECT_EQ("R" + std::to_string(i), record[0]);
+                double value = 0;
+                std::from_chars(record[1], record[1] + strlen(record[1]), value);
+                EXPECT_EQ(values[i], value) << record[1];
+                EXPECT_EQ(std::signbit(values[i]), std::signbit(value));
+                if (i % 100 == 0) {
+                    EXPECT_EQ(big, record[2]);
+                }
+            }
+            efr.readRecord();
+            EXPECT_TRUE(efr.isEOF());
+
+            // a record read, written out again
+            ElegentFileWriter copy(block_size, '\t', ElegentFileWriter::LineEnd::CrLf, false, write_behind);
+            const std::string copy_path = TempPath("efw_test_copy.tbl");
+            copy.open(copy_path.c_str());
+            efr.seek(0);
+            while (!efr.isEOF())
+                copy.writeRecord(efr.readRecord());
+            copy.close();
+            EXPECT_EQ(Contents(path), Contents(copy_path));
+        }
+    }
+}
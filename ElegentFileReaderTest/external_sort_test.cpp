@@ -0,0 +1,165 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CSVFileIndex.h"
+#include "ElegentFileReader.h"
+#include "ExternalSort.h"
+#include "TestHelpers.h"
+
+using score::SortFile;
+using score::SortOptions;
+using score::SortStats;
+using test::Contents;
+using test::TempPath;
+using test::WriteFile;
+
+namespace {
+std::vector<std::string> Split(const std::string& line, const char delimiter)
+{
+    std::vector<std::string> fields(1);
+    for (const char c : line)
+        if (c == delimiter)
+            fields.emplace_back();
+        else
+            fields.back() += c;
+    return fields;
+}
+
+/// the records (without their line ends) of policies, unsorted: keys K0 to K{keys - 1} in field 1, a sequence
+/// number in field 2 (to check the sort is stable), and a field a few hundred bytes wide
+std::vector<std::string> Policies(const size_t records, const size_t keys)
+{
+    std::vector<std::string> lines;
+    uint32_t random = 12345;
+    for (size_t i = 0; i < records; ++i) {
+        random = random * 1664525u + 1013904223u;
+        const std::string key = "K" + std::to_string((random >> 8) % keys);
+        lines.push_back("POL" + std::to_string(random % 97) + "\t" + key + "\t" + std::to_string(i) + "\t"
+                        + std::string(random % 300, 'x'));
+    }
+    return lines;
+}
+
+/// what SortFile() should make of them
+std::vector<std::string> Sorted(const std::vector<std::string>& lines, const std::vector<size_t>& keys)
+{
+    std::vector<std::pair<std::vector<std::string>, std::string>> keyed;
+    for (const auto& line : lines) {
+        const auto fields = Split(line, '\t');
+        std::vector<std::string> key;
+        for (const size_t field : keys)
+            key.push_back(field < fields.size() ? fields[field] : "");
+        keyed.emplace_back(key, line);
+    }
+    std::stable_sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::vector<std::string> sorted;
+    for (const auto& line : keyed)
+        sorted.push_back(line.second);
+    return sorted;
+}
+
+std::string Join(const std::string& header, const std::vector<std::string>& lines, const char* eol)
+{
+    std::string text = header;
+    for (const auto& line : lines)
+        text += line + eol;
+    return text;
+}
+}
+
+TEST(ExternalSort, SameAsSortingInMemory)
+{
+    const std::vector<std::string> lines = Policies(20000, 500);
+    const std::string input = TempPath("efr_sort_input.tbl");
+    const std::string output = TempPath("efr_sort_output.tbl");
+    // CRLF with the unicode signature: kept
+    WriteFile(input, Join("\xEF\xBB\xBFPOLICY\tKEY\tSEQ\tTEXT\r\n", lines, "\r\n"));
+
+    for (const auto& keys : {std::vector<size_t>{1}, std::vector<size_t>{1, 0}, std::vector<size_t>{0, 7}}) {
+        const std::string expected = Join("\xEF\xBB\xBFPOLICY\tKEY\tSEQ\tTEXT\r\n", Sorted(lines, keys), "\r\n");
+        // in memory; runs merged in one pass; merged in passes of 2; parts sorted in parallel
+        for (const auto& budget : {std::make_pair(uint64_t(64) << 20, size_t(0)), std::make_pair(uint64_t(256) << 10, size_t(0)),
+                                   std::make_pair(uint64_t(64) << 10, size_t(2))}) {
+            for (const size_t workers : {1u, 4u}) {
+                SortOptions options;
+                options.keys_ = keys;
+                options.memory_budget_ = budget.first;
+                options.merge_fan_in_ = budget.second;
+                options.workers_ = workers;
+                const SortStats stats = SortFile(input.c_str(), output.c_str(), options);
+                EXPECT_EQ(lines.size(), stats.records_);
+                EXPECT_EQ(expected, Contents(output)) << budget.first << " " << workers;
+                if (budget.first == uint64_t(64) << 20) {
+                    EXPECT_EQ(0U, stats.runs_);
+                } else {
+                    EXPECT_LT(2U, stats.runs_);
+                }
+                if (budget.second) {
+                    EXPECT_LT(1U, stats.merge_passes_);
+                }
+            }
+        }
+    }
+    // the runs are gone
+    for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::temp_directory_path()))
+        EXPECT_EQ(std::string::npos, entry.path().filename().string().find("efr_sort_output.tbl.run"));
+}
+
+TEST(ExternalSort, ReadyForTheIndex)
+{
+    // LF, no header; then every key is in one block
+    const std::vector<std::string> lines = Policies(5000, 50);
+    const std::string input = TempPath("efr_sort_index_input.tbl");
+    const std::string output = TempPath("efr_sort_index_output.tbl");
+    WriteFile(input, Join("", lines, "\n"));
+    SortOptions options;
+    options.keys_ = {1};
+    options.header_ = false;
+    options.memory_budget_ = 64 << 10;
+    SortFile(input.c_str(), output.c_str(), options);
+    EXPECT_EQ(Join("", Sorted(lines, {1}), "\n"), Contents(output));
+
+    // the index skips a header: put one in
+    WriteFile(input, Join("POLICY\tKEY\tSEQ\tTEXT\n", lines, "\n"));
+    options.header_ = true;
+    SortFile(input.c_str(), output.c_str(), options);
+    ElegentFileReader efr(64_Kb, '\t');
+    efr.setErrorPolicy(OnError::SkipRow);
+    efr.open(output.c_str());
+    CSVFileIndex index;
+    index.createIndex(efr, 1);
+    EXPECT_EQ(0U, efr.errors().count());
+    EXPECT_LT(0U, index.find("K7").record_count_);
+}
+
+TEST(ExternalSort, SmallFiles)
+{
+    const std::string input = TempPath("efr_sort_small_input.tbl");
+    const std::string output = TempPath("efr_sort_small_output.tbl");
+    SortOptions options;
+    options.keys_ = {0};
+
+    WriteFile(input, "");
+    EXPECT_EQ(0U, SortFile(input.c_str(), output.c_str(), options).records_);
+    EXPECT_EQ("", Contents(output));
+
+    WriteFile(input, "key\tvalue\r\n");
+    EXPECT_EQ(0U, SortFile(input.c_str(), output.c_str(), options).records_);
+    EXPECT_EQ("key\tvalue\r\n", Contents(output));
+
+    // short records and blank lines: a missing key sorts as empty; the last record without a line end gets one
+    WriteFile(input, "key\tvalue\r\nb\t1\r\n\r\na\t2\r\na\r\n\t3");
+    options.keys_ = {1, 0};
+    EXPECT_EQ(5U, SortFile(input.c_str(), output.c_str(), options).records_);
+    EXPECT_EQ("key\tvalue\r\n\r\na\r\nb\t1\r\na\t2\r\n\t3\r\n", Contents(output));
+
+    options.keys_.clear();
+    EXPECT_ANY_THROW(SortFile(input.c_str(), output.c_str(), options));
+    options.keys_ = {0};
+    EXPECT_ANY_THROW(SortFile(TempPath("efr_sort_no_such_file.tbl").c_str(), output.c_str(), options));
+}
@@ -0,0 +1,95 @@
+#include "pch.h"
+
+#include "FixedWidthFileReader.h"
+
+namespace {
+const char* const inforce_file = "TestFiles\\FixedWidth\\inforce.txt";
+
+FixedWidthFileReader::Layout InforceLayout()
+{
+    auto layout = FixedWidthFileReader::layoutFromConfig("TestFiles\\FixedWidth\\config");
+    layout.push_back({"sum_assured", 20, 10});
+    layout.push_back({"age", 30, 10});
+    return layout;
+}
+}
+
+TEST(FixedWidthFileReader, LayoutFromConfig) {
+    const auto layout = FixedWidthFileReader::layoutFromConfig("TestFiles\\FixedWidth\\config");
+    ASSERT_EQ(3, layout.size()); // max_iteration_length is not a column: there's no position for it
+    EXPECT_EQ("product", layout[0].name_);
+    EXPECT_EQ(0, layout[0].position_);
+    EXPECT_EQ(8, layout[0].length_);
+    EXPECT_EQ("group", layout[1].name_);
+    EXPECT_EQ(8, layout[1].position_);
+    EXPECT_EQ(6, layout[1].length_);
+    EXPECT_EQ("recno", layout[2].name_);
+    EXPECT_EQ(14, layout[2].position_);
+    EXPECT_EQ(6, layout[2].length_);
+
+    // the run config has the columns, with 0 lengths
+    const auto run_layout = FixedWidthFileReader::layoutFromConfig("TestFiles\\Config\\config");
+    ASSERT_EQ(3, run_layout.size());
+    EXPECT_EQ(0, run_layout[2].length_);
+}
+
+TEST(FixedWidthFileReader, ReadThrough) {
+    for (uint32_t read_size = 1; read_size < 500; read_size += 13) {
+        FixedWidthFileReader fwr(InforceLayout(), false, read_size);
+        fwr.open(inforce_file);
+        const size_t recno = fwr.columnIndex("recno");
+
+        size_t count = 0;
+        while (!fwr.isEOF()) {
+            const auto record = fwr.readRecord();
+            EXPECT_EQ(40, record.size());
+            ++count;
+            EXPECT_EQ(count, std::stoul(std::string(fwr.field(recno))));
+        }
+        EXPECT_EQ(10, count);
+        EXPECT_EQ(0, fwr.recordLength());
+    }
+}
+
+TEST(FixedWidthFileReader, Fields) {
+    FixedWidthFileReader fwr(InforceLayout());
+    fwr.open(inforce_file);
+
+    fwr.readRecord();
+    EXPECT_EQ("TERM10  ", fwr.field(0));
+    EXPECT_EQ("G01   ", fwr.field(1));
+    EXPECT_EQ("000001", fwr.field(2));
+    EXPECT_EQ("   1000.50", fwr.field(3));
+    EXPECT_EQ("        35", fwr.field(4));
+    EXPECT_ANY_THROW(fwr.columnIndex("no such column"));
+}
+
+TEST(FixedWidthFileReader, SeekToRecord) {
+    for (uint32_t read_size = 16; read_size < 500; read_size += 29) {
+        FixedWidthFileReader fwr(InforceLayout(), true, read_size);
+        EXPECT_ANY_THROW(fwr.seekToRecord(0)); // not open
+
+        fwr.open(inforce_file);
+        EXPECT_EQ(42, fwr.recordLength()); // 40 + CRLF
+        EXPECT_EQ(10, fwr.recordCount());
+
+        fwr.seekToRecord(7);
+        EXPECT_EQ(7 * 42, fwr.ftell());
+        fwr.readRecord();
+        EXPECT_EQ("000008", fwr.field(2));
+        EXPECT_EQ("ANN_RP  ", fwr.field(0));
+
+        fwr.seekToRecord(1);
+        fwr.readRecord();
+        EXPECT_EQ("000002", fwr.field(2));
+
+        fwr.seekToRecord(9);
+        fwr.readRecord();
+        EXPECT_EQ("UL      ", fwr.field(0));
+        EXPECT_TRUE(fwr.isEOF());
+
+        fwr.seekToRecord(10); // the end of the file
+        EXPECT_TRUE(fwr.isEOF());
+        EXPECT_ANY_THROW(fwr.seekToRecord(11));
+    }
+}
@@ -0,0 +1,121 @@
+#include "pch.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ElegentFileReader.h"
+#include "HashJoin.h"
+#include "InputSource.h"
+
+using score::HashJoin;
+
+namespace {
+using Products = std::map<std::string, std::pair<std::string, std::string>>;
+
+/// positioned on the 1st product, after the comments and the heading
+void SkipHeading(ElegentFileReader& prod_code)
+{
+    while (!prod_code.isEOF() && std::string("OriginalProdCode") != prod_code.readRecord()[0])
+        ;
+}
+
+/// the join the slow way: OriginalProdCode -> ProdCode, IsVA in a map of strings
+Products ReadProducts()
+{
+    ElegentFileReader efr(4_Kb, '\t');
+    efr.open("TestFiles\\prod_code.tbl");
+    SkipHeading(efr);
+    Products products;
+    while (!efr.isEOF()) {
+        const auto& record = efr.readRecord();
+        if (record.size() == 4)
+            products.emplace(record[0], std::make_pair(record[2], record[3]));
+    }
+    return products;
+}
+}
+
+TEST(HashJoin, ProdCode)
+{
+    const Products products = ReadProducts();
+    ASSERT_LT(3000U, products.size());
+
+    // policies: every 7th product and some that aren't there, with the product code in field 1
+    std::string inforce = "POLICY\tPRODUCT\tSUM\r\n";
+    std::vector<std::string> expected;
+    size_t i = 0;
+    for (const auto& product : products) {
+        if (i++ % 7)
+            continue;
+        const std::string policy = "P" + std::to_string(i);
+        inforce += policy + "\t" + product.first + "\t" + std::to_string(i * 1000) + "\r\n";
+        expected.push_back(policy + "," + product.first + "," + std::to_string(i * 1000) + "/" + product.second.first + "/"
+                           + product.second.second);
+        inforce += "Q" + std::to_string(i) + "\t" + product.first + "_\t0\r\n";
+    }
+    inforce += "short\r\nP0\t" + products.begin()->first; // the last without a line end
+    expected.push_back("P0," + products.begin()->first + "/" + products.begin()->second.first + "/" + products.begin()->second.second);
+
+    for (const size_t batch : {1u, 3u, 16u, 1000u}) {
+        ElegentFileReader prod_code(4_Kb, '\t');
+        prod_code.open("TestFiles\\prod_code.tbl");
+        SkipHeading(prod_code);
+        HashJoin join(batch);
+        join.build(prod_code, 0, {2, 3});
+        EXPECT_EQ(products.size(), join.size());
+        EXPECT_EQ(0U, join.duplicates());
+
+        for (const uint32_t read_size : {7u, 4096u}) {
+            ElegentFileReader efr(read_size, '\t');
+            efr.open(std::make_unique<MemorySource>(inforce.data(), inforce.size()));
+            std::vector<std::string> joined;
+            const uint64_t emitted = join.probe(efr, 1, [&](const ElegentFileReader::Record& policy, const char* const* product) {
+                std::string fields;
+                for (const char* const field : policy)
+                    fields += (fields.empty() ? "" : ",") + std::string(field);
+                joined.push_back(fields + "/" + product[0] + "/" + product[1]);
+            });
+            EXPECT_EQ(expected, joined) << batch << " " << read_size;
+            EXPECT_EQ(expected.size(), emitted);
+        }
+    }
+}
+
+TEST(HashJoin, Build)
+{
+    // a duplicate key keeps the 1st; records too short for the fields wanted are left out
+    const std::string text = "a\tx\t1\nb\ty\t2\na\tz\t3\nc\tw\nd\tv\t4\n\t\t5\n";
+    ElegentFileReader efr(4096, '\t');
+    efr.open(std::make_unique<MemorySource>(text.data(), text.size()));
+    HashJoin join;
+    join.build(efr, 0, {2, 1});
+    EXPECT_EQ(4U, join.size());
+    EXPECT_EQ(1U, join.duplicates());
+    ASSERT_NE(nullptr, join.find("a"));
+    EXPECT_STREQ("1", join.find("a")[0]);
+    EXPECT_STREQ("x", join.find("a")[1]);
+    EXPECT_STREQ("v", join.find("d")[1]);
+    EXPECT_STREQ("5", join.find("")[0]);
+    EXPECT_EQ(nullptr, join.find("c"));
+    EXPECT_EQ(nullptr, join.find("ab"));
+
+    // built again: only the new table
+    efr.seek(0);
+    efr.skipRecord();
+    join.build(efr, 1, {0});
+    EXPECT_EQ(5U, join.size());
+    EXPECT_EQ(0U, join.duplicates());
+    EXPECT_STREQ("a", join.find("z")[0]);
+    EXPECT_EQ(nullptr, join.find("x"));
+
+    HashJoin empty;
+    EXPECT_ANY_THROW(empty.find("a"));
+    efr.seek(efr.fileSize());
+    empty.build(efr, 0, {1});
+    EXPECT_EQ(0U, empty.size());
+    EXPECT_EQ(nullptr, empty.find("a"));
+    EXPECT_ANY_THROW(empty.build(efr, 0, {}));
+}
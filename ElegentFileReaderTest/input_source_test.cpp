@@ -0,0 +1,104 @@
+#include "pch.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CSVFileIndex.h"
+#include "ElegentFileReader.h"
+#include "InputSource.h"
+#include "TestHelpers.h"
+
+using test::Contents;
+using test::ReadAll;
+using test::Records;
+
+namespace {
+Records ReadAll(std::unique_ptr<InputSource> source, const uint32_t read_size, const char delimiter = '\t',
+                const ElegentFileReader::Quoting quoting = ElegentFileReader::Quoting::None)
+{
+    ElegentFileReader efr(read_size, delimiter, false, -1, ElegentFileReader::Encoding::Unchecked, quoting);
+    efr.open(std::move(source));
+    return test::ReadAll(efr);
+}
+}
+
+TEST(InputSource, SameRecordsFromEverySource)
+{
+    for (const char* const filename : {"TestFiles\\fr_records.tbl", "TestFiles\\Meritz.tbl"}) {
+        const std::string contents = Contents(filename);
+        const std::vector<uint32_t> read_sizes = contents.size() < 1000 ? std::vector<uint32_t>{1, 2, 3, 16, 4096}
+                                                                        : std::vector<uint32_t>{4096, 65536};
+        for (const uint32_t read_size : read_sizes) {
+            const Records expected = ReadAll(std::make_unique<FileSource>(filename), read_size);
+            ASSERT_LT(1U, expected.size());
+            EXPECT_EQ(expected, ReadAll(std::make_unique<PreadSource>(filename), read_size));
+            EXPECT_EQ(expected, ReadAll(std::make_unique<MappedSource>(filename), read_size));
+            EXPECT_EQ(expected, ReadAll(std::make_unique<MemorySource>(contents.data(), contents.size()), read_size));
+            std::istringstream stream(contents);
+            EXPECT_EQ(expected, ReadAll(std::make_unique<StreamSource>(stream), read_size));
+        }
+    }
+
+    // quoted mode too
+    const char* const quoted = "TestFiles\\FileReader\\quoted.csv";
+    const std::string contents = Contents(quoted);
+    for (const uint32_t read_size : {1u, 7u, 4096u}) {
+        const Records expected = ReadAll(std::make_unique<FileSource>(quoted), read_size, ',', ElegentFileReader::Quoting::Rfc4180);
+        std::istringstream stream(contents);
+        EXPECT_EQ(expected, ReadAll(std::make_unique<StreamSource>(stream), read_size, ',', ElegentFileReader::Quoting::Rfc4180));
+    }
+}
+
+TEST(InputSource, Stream)
+{
+    // the size is found out when the last block is read: here, a whole block, ending with the LF
+    std::istringstream stream("a\tb\nc\td\ne\tf\n");
+    ElegentFileReader efr(4, '\t');
+    efr.open(std::make_unique<StreamSource>(stream));
+    EXPECT_EQ(InputSource::unknown_size, efr.fileSize());
+    EXPECT_FALSE(efr.isEOF());
+    efr.seek(0); // still in the (empty) buffer
+    EXPECT_STREQ("b", efr.readRecord()[1]);
+    EXPECT_EQ(InputSource::unknown_size, efr.fileSize());
+    EXPECT_STREQ("d", efr.readRecord()[1]);
+    EXPECT_FALSE(efr.isEOF());
+    EXPECT_STREQ("f", efr.readRecord()[1]);
+    EXPECT_EQ(12U, efr.fileSize());
+    EXPECT_TRUE(efr.isEOF());
+    EXPECT_TRUE(efr.readRecord().empty());
+
+    // only forwards: the read after the seek throws
+    efr.seek(0);
+    EXPECT_THROW(efr.readRecord(), std::exception);
+
+    std::istringstream empty;
+    ElegentFileReader empty_reader;
+    empty_reader.open(std::make_unique<StreamSource>(empty));
+    EXPECT_EQ(0U, empty_reader.fileSize());
+    EXPECT_TRUE(empty_reader.isEOF());
+}
+
+TEST(InputSource, Memory)
+{
+    const std::string file = "key\tvalue\r\nA\t1\r\nA\t2\r\nB\t3";
+    ElegentFileReader efr(4_Kb, '\t');
+    efr.open(std::make_unique<MemorySource>(file.data(), file.size()));
+    CSVFileIndex index;
+    index.createIndex(efr, 0);
+    std::vector<CSVFileIndex::FileBlockInfo> blocks;
+    index.find({"A", "B"}, blocks);
+    EXPECT_EQ(11U, blocks[0].begin_offset_);
+    EXPECT_EQ(2U, blocks[0].record_count_);
+    EXPECT_EQ(file.size(), blocks[1].end_offset_);
+
+    efr.seek(blocks[1].begin_offset_);
+    EXPECT_STREQ("3", efr.readRecord()[1]);
+    efr.close();
+    EXPECT_FALSE(efr.isOpen());
+
+    EXPECT_THROW(PreadSource("TestFiles\\no such file"), std::exception);
+    EXPECT_THROW(MappedSource("TestFiles\\no such file"), std::exception);
+    EXPECT_EQ(0U, MappedSource("TestFiles\\empty file.txt").size());
+}
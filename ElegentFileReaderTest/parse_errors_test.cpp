@@ -0,0 +1,167 @@
+#include "pch.h"
+
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "CSVFileIndex.h"
+#include "ElegentFileReader.h"
+#include "ParseErrors.h"
+
+namespace {
+/// 4 fields; line 3 has 3, line 5 has 5, and key A comes back at line 7
+const char* const bad_rows = "TestFiles\\FileReader\\bad_rows.tbl";
+
+/// where each record starts (so the tests don't depend on how git checked out the line ends)
+std::vector<uint64_t> Offsets()
+{
+    ElegentFileReader efr(4_Kb, '\t');
+    efr.open(bad_rows);
+    std::vector<uint64_t> offsets;
+    while (!efr.isEOF()) {
+        offsets.push_back(efr.ftell());
+        efr.skipRecord();
+    }
+    return offsets;
+}
+
+std::vector<std::string> Keys(ElegentFileReader& efr)
+{
+    std::vector<std::string> keys;
+    for (auto record = efr.readRecord(); !record.empty(); record = efr.readRecord())
+        keys.push_back(std::string(record[0]) + record[1]);
+    return keys;
+}
+
+void ExpectError(const ParseError& error, const ParseError::Kind kind, const uint64_t offset, const uint64_t line, const size_t field)
+{
+    EXPECT_EQ(kind, error.kind_);
+    EXPECT_EQ(offset, error.offset_);
+    EXPECT_EQ(line, error.line_);
+    EXPECT_EQ(field, error.field_);
+}
+}
+
+TEST(ErrorLog, Policies)
+{
+    const ParseError error{ParseError::Kind::FieldCount, 42, 3, 7};
+    EXPECT_EQ("wrong number of fields at file offset 42, line 3, field 7", ToString(error));
+    EXPECT_EQ("duplicate key at file offset 42, field 0", ToString(ParseError{ParseError::Kind::DuplicateKey, 42, 0, 0}));
+
+    ErrorLog throwing;
+    EXPECT_EQ(OnError::Throw, throwing.onError());
+    EXPECT_THROW(throwing.add(error), std::exception);
+
+    ErrorLog skipping(OnError::SkipRow);
+    skipping.add(error);
+    skipping.add(error);
+    EXPECT_EQ(2U, skipping.count());
+    EXPECT_TRUE(skipping.errors().empty());
+
+    ErrorLog collecting(OnError::Collect, 2);
+    for (int i = 0; i < 5; ++i)
+        collecting.add(ParseError{ParseError::Kind::FieldCount, uint64_t(i), 0, 0});
+    EXPECT_EQ(5U, collecting.count());
+    ASSERT_EQ(2U, collecting.errors().size());
+    EXPECT_EQ(1U, collecting.errors()[1].offset_);
+
+    collecting.clear();
+    EXPECT_EQ(0U, collecting.count());
+    EXPECT_TRUE(collecting.errors().empty());
+}
+
+TEST(ErrorLog, ReaderThrows)
+{
+    const std::vector<uint64_t> offsets = Offsets();
+    ElegentFileReader efr(16, '\t');
+    efr.setErrorPolicy(OnError::Throw, 4);
+    efr.open(bad_rows);
+    efr.readRecord();
+    efr.readRecord();
+    try {
+        efr.readRecord();
+        FAIL();
+    } catch (const std::exception& e) {
+        EXPECT_EQ("wrong number of fields at file offset " + std::to_string(offsets[2]) + ", line 3, field 3", e.what());
+    }
+    // and carries on after it
+    EXPECT_STREQ("2", efr.readRecord()[1]);
+}
+
+TEST(ErrorLog, ReaderSkipsAndCollects)
+{
+    const std::vector<uint64_t> offsets = Offsets();
+    ASSERT_EQ(8U, offsets.size());
+    for (const uint32_t read_size : {4u, 16u, 4096u}) {
+        ElegentFileReader skipping(read_size, '\t');
+        skipping.setErrorPolicy(OnError::SkipRow, 4);
+        skipping.open(bad_rows);
+        EXPECT_EQ((std::vector<std::string>{"keyt", "A0", "A2", "B1", "A0", "C0"}), Keys(skipping));
+        EXPECT_EQ(2U, skipping.errors().count());
+        EXPECT_TRUE(skipping.errors().errors().empty());
+
+        ElegentFileReader collecting(read_size, '\t');
+        collecting.setErrorPolicy(OnError::Collect, 4);
+        collecting.open(bad_rows);
+        EXPECT_EQ(6U, Keys(collecting).size());
+        const auto& errors = collecting.errors().errors();
+        ASSERT_EQ(2U, errors.size());
+        ExpectError(errors[0], ParseError::Kind::FieldCount, offsets[2], 3, 3);
+        ExpectError(errors[1], ParseError::Kind::FieldCount, offsets[4], 5, 4);
+
+        // the line isn't known after a seek to the middle of the file; the policy stays after close(), the log goes on open()
+        collecting.seek(offsets[3]);
+        collecting.readRecord();
+        collecting.readRecord();
+        ExpectError(collecting.errors().errors()[2], ParseError::Kind::FieldCount, offsets[4], 0, 4);
+        collecting.close();
+        EXPECT_EQ(3U, collecting.errors().count());
+        collecting.open(bad_rows);
+        EXPECT_EQ(0U, collecting.errors().count());
+        EXPECT_EQ(6U, Keys(collecting).size());
+        EXPECT_EQ(2U, collecting.errors().count());
+    }
+}
+
+TEST(ErrorLog, Index)
+{
+    const std::vector<uint64_t> offsets = Offsets();
+    // a key seen before: its block is left out
+    ElegentFileReader efr(16, '\t');
+    efr.setErrorPolicy(OnError::Collect, 4);
+    efr.open(bad_rows);
+    CSVFileIndex index;
+    index.createIndex(efr, 0);
+    std::vector<CSVFileIndex::FileBlockInfo> blocks;
+    index.find({"A", "B", "C"}, blocks);
+    EXPECT_EQ(offsets[1], blocks[0].begin_offset_);
+    EXPECT_EQ(2U, blocks[0].record_count_);
+    EXPECT_EQ(1U, blocks[1].record_count_);
+    EXPECT_EQ(offsets[7], blocks[2].begin_offset_);
+    ASSERT_EQ(3U, efr.errors().count());
+    ExpectError(efr.errors().errors()[2], ParseError::Kind::DuplicateKey, offsets[6], 7, 0);
+    // B's block starts after the bad row skipped before it, so reading it doesn't log that again
+    EXPECT_EQ(offsets[5], blocks[1].begin_offset_);
+    efr.seek(blocks[1].begin_offset_);
+    EXPECT_STREQ("B", efr.readRecord()[0]);
+    EXPECT_EQ(3U, efr.errors().count());
+
+    // a row too short to have the key
+    ElegentFileReader short_rows(16, '\t');
+    short_rows.setErrorPolicy(OnError::Collect);
+    short_rows.open(bad_rows);
+    CSVFileIndex index3;
+    index3.createIndex(short_rows, 3);
+    index3.find({"1.2", "3.2", "7.2"}, blocks);
+    EXPECT_EQ(1U, blocks[0].record_count_);
+    EXPECT_EQ(1U, blocks[1].record_count_);
+    EXPECT_EQ(1U, blocks[2].record_count_);
+    ASSERT_EQ(1U, short_rows.errors().count());
+    ExpectError(short_rows.errors().errors()[0], ParseError::Kind::MissingField, offsets[2], 3, 3);
+
+    // by default the 1st one throws
+    ElegentFileReader throwing(16, '\t');
+    throwing.open(bad_rows);
+    CSVFileIndex index_throwing;
+    EXPECT_THROW(index_throwing.createIndex(throwing, 0), std::exception);
+}
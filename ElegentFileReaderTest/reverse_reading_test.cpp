@@ -0,0 +1,105 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ElegentFileReader.h"
+#include "InputSource.h"
+#include "TestHelpers.h"
+
+using test::ReadAll;
+using test::Records;
+
+namespace {
+/// in file order, to compare
+Records Backwards(ElegentFileReader& efr)
+{
+    Records records;
+    for (auto record = efr.readPreviousRecord(); !record.empty(); record = efr.readPreviousRecord())
+        records.emplace_back(record.begin(), record.end());
+    std::reverse(records.begin(), records.end());
+    return records;
+}
+}
+
+TEST(ReverseReading, SameRecordsAsForwards)
+{
+    // CRLF (after checkout) with a unicode signature, LF, no line end at the end, blank lines
+    const std::string no_line_end = "a\tb\r\nc\td\r\ne\tf";
+    const std::string blank_lines = "a\n\n\nb\tc\n\n";
+    for (const uint32_t read_size : {1u, 2u, 3u, 7u, 64u, 4096u}) {
+        for (const char* const filename : {"TestFiles\\fr_records.tbl", "TestFiles\\fr_records_lf.tbl", "TestFiles\\Meritz.tbl"}) {
+            ElegentFileReader efr(read_size, '\t');
+            efr.open(filename);
+            const Records expected = ReadAll(efr);
+            ASSERT_LT(1U, expected.size());
+            efr.close();
+            efr.open(filename);
+            EXPECT_EQ(expected, Backwards(efr)) << filename << " " << read_size;
+        }
+        for (const std::string* const text : {&no_line_end, &blank_lines}) {
+            ElegentFileReader efr(read_size, '\t');
+            efr.open(std::make_unique<MemorySource>(text->data(), text->size()));
+            const Records expected = ReadAll(efr);
+            efr.seek(efr.fileSize());
+            EXPECT_EQ(expected, Backwards(efr)) << *text << " " << read_size;
+        }
+    }
+
+    ElegentFileReader empty;
+    empty.open("TestFiles\\empty file.txt");
+    EXPECT_TRUE(empty.readPreviousRecord().empty());
+    EXPECT_TRUE(empty.tail(3).empty());
+}
+
+TEST(ReverseReading, Position)
+{
+    const std::string text = "key\tvalue\r\nA\t1\r\nB\t2\r\nC\t3\r\n";
+    ElegentFileReader efr(4, '\t');
+    efr.open(std::make_unique<MemorySource>(text.data(), text.size()));
+    EXPECT_STREQ("C", efr.readPreviousRecord()[0]);
+    EXPECT_EQ(text.size(), efr.ftell()); // read forwards, so at its end
+    EXPECT_STREQ("B", efr.readPreviousRecord()[0]);
+    // forwards from there: the record after it, and that doesn't move the backward position
+    EXPECT_STREQ("C", efr.readRecord()[0]);
+    EXPECT_STREQ("A", efr.readPreviousRecord()[0]);
+
+    // from the middle of a record: the one that's in
+    efr.seek(text.find("B") + 2);
+    EXPECT_STREQ("2", efr.readPreviousRecord()[1]);
+    efr.seek(text.find("B"));
+    EXPECT_STREQ("1", efr.readPreviousRecord()[1]);
+    EXPECT_STREQ("key", efr.readPreviousRecord()[0]);
+    EXPECT_TRUE(efr.readPreviousRecord().empty());
+
+    EXPECT_EQ((std::vector<std::vector<std::string>>{{"B", "2"}, {"C", "3"}}), efr.tail(2));
+    EXPECT_STREQ("A", efr.readPreviousRecord()[0]);
+    EXPECT_EQ(4U, efr.tail(10).size());
+
+    ElegentFileReader quoted(4_Kb, ',', false, -1, ElegentFileReader::Encoding::Unchecked, ElegentFileReader::Quoting::Rfc4180);
+    quoted.open("TestFiles\\FileReader\\quoted.csv");
+    EXPECT_ANY_THROW(quoted.readPreviousRecord());
+}
+
+TEST(ReverseReading, BadRows)
+{
+    // as forwards: skipped and logged
+    for (const uint32_t read_size : {3u, 4096u}) {
+        ElegentFileReader efr(read_size, '\t');
+        efr.setErrorPolicy(OnError::SkipRow, 4);
+        efr.open("TestFiles\\FileReader\\bad_rows.tbl");
+        std::vector<std::string> keys;
+        for (auto record = efr.readPreviousRecord(); !record.empty(); record = efr.readPreviousRecord())
+            keys.push_back(std::string(record[0]) + record[1]);
+        EXPECT_EQ((std::vector<std::string>{"C0", "A0", "B1", "A2", "A0", "keyt"}), keys);
+        EXPECT_EQ(2U, efr.errors().count());
+
+        const auto last = efr.tail(2);
+        ASSERT_EQ(2U, last.size());
+        EXPECT_EQ("A", last[0][0]);
+        EXPECT_EQ("C", last[1][0]);
+    }
+}
@@ -0,0 +1,127 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ElegentFileReader.h"
+#include "InputSource.h"
+#include "TestHelpers.h"
+
+using test::ReadAll;
+using test::Records;
+
+namespace {
+using Predicate = std::function<bool(const std::vector<std::string>&)>;
+
+/// what the filters should give: every record, filtered here
+Records Expected(ElegentFileReader& efr, const Predicate& keep)
+{
+    Records records = ReadAll(efr);
+    records.erase(std::remove_if(records.begin(), records.end(), std::not_fn(keep)), records.end());
+    return records;
+}
+}
+
+TEST(RowFilter, SameAsFilteringTheRecords)
+{
+    const std::vector<std::pair<std::function<void(ElegentFileReader&)>, Predicate>> filters = {
+        {[](ElegentFileReader& efr) { efr.whereEquals(0, "2170245114"); },
+         [](const auto& r) { return r[0] == "2170245114"; }},
+        {[](ElegentFileReader& efr) { efr.whereEquals(5, "FEMALE"); efr.whereStartsWith(0, "217"); },
+         [](const auto& r) { return r[5] == "FEMALE" && r[0].compare(0, 3, "217") == 0; }},
+        {[](ElegentFileReader& efr) { efr.whereIn(0, {"1510362214", "2170245214", "1510362214", "nothing"}); },
+         [](const auto& r) { return r[0] == "1510362214" || r[0] == "2170245214"; }},
+        {[](ElegentFileReader& efr) { efr.whereEquals(5, "SEX"); },
+         [](const auto& r) { return r[5] == "SEX"; }},
+    };
+    // as checked out (CRLF), and with LFs
+    std::string crlf = test::Contents("TestFiles\\Meritz.tbl");
+    std::string lf = crlf;
+    lf.erase(std::remove(lf.begin(), lf.end(), '\r'), lf.end());
+    for (const uint32_t read_size : {1u, 7u, 64u, 1000u, 4096u, 1u << 20}) {
+        for (const std::string* const text : {&crlf, &lf}) {
+            for (const auto& filter : filters) {
+                ElegentFileReader efr(read_size, '\t');
+                efr.open(std::make_unique<MemorySource>(text->data(), text->size()));
+                const Records expected = Expected(efr, filter.second);
+                ASSERT_FALSE(expected.empty());
+                efr.close();
+
+                filter.first(efr);
+                efr.open(std::make_unique<MemorySource>(text->data(), text->size()));
+                EXPECT_EQ(expected, ReadAll(efr)) << (text == &lf ? "LF " : "CRLF ") << read_size;
+                // kept by close()
+                efr.close();
+                efr.open(std::make_unique<MemorySource>(text->data(), text->size()));
+                EXPECT_EQ(expected.size(), ReadAll(efr).size());
+            }
+        }
+    }
+}
+
+TEST(RowFilter, Fields)
+{
+    // the last record without a line end; blank lines, short records and the last field up to max_fields
+    const std::string text = "k\tv\tw\r\nA\t1\t2\r\n\r\nB\t1\nA\r\nA\t1\tx\ty\nA\t1";
+    for (const uint32_t read_size : {1u, 2u, 5u, 4096u}) {
+        ElegentFileReader efr(read_size, '\t');
+        efr.whereEquals(0, "A");
+        efr.open(std::make_unique<MemorySource>(text.data(), text.size()));
+        EXPECT_EQ((Records{{"A", "1", "2"}, {"A"}, {"A", "1", "x", "y"}, {"A", "1"}}), ReadAll(efr)) << read_size;
+
+        // a record without the field doesn't pass; and back in the buffer, the records already split are checked split
+        efr.whereEquals(1, "1");
+        efr.seek(0);
+        EXPECT_EQ((Records{{"A", "1", "2"}, {"A", "1", "x", "y"}, {"A", "1"}}), ReadAll(efr)) << read_size;
+
+        ElegentFileReader three(read_size, '\t', false, 3);
+        three.whereEquals(2, "x\ty");
+        three.open(std::make_unique<MemorySource>(text.data(), text.size()));
+        EXPECT_EQ((Records{{"A", "1", "x\ty"}}), ReadAll(three)) << read_size;
+        EXPECT_ANY_THROW(three.whereEquals(3, "y"));
+
+        three.clearFilters();
+        three.whereStartsWith(1, "");
+        three.seek(0);
+        EXPECT_EQ(5U, ReadAll(three).size()); // not the blank line or the "A"
+    }
+}
+
+TEST(RowFilter, QuotedAndConsecutiveDelimiters)
+{
+    // checked on the records: a delimiter in quotes, and "" as one
+    const std::string quoted = "key,value\r\n\"a,b\",1\r\na,2\r\n\"a\",3\r\n";
+    for (const uint32_t read_size : {3u, 4096u}) {
+        ElegentFileReader efr(read_size, ',', false, -1, ElegentFileReader::Encoding::Unchecked, ElegentFileReader::Quoting::Rfc4180);
+        efr.whereEquals(0, "a");
+        efr.open(std::make_unique<MemorySource>(quoted.data(), quoted.size()));
+        EXPECT_EQ((Records{{"a", "2"}, {"a", "3"}}), ReadAll(efr)) << read_size;
+
+        const std::string spaced = "a  1\nb 2\n  a 3\n";
+        ElegentFileReader as_one(read_size, ' ', true);
+        as_one.whereEquals(1, "3");
+        as_one.open(std::make_unique<MemorySource>(spaced.data(), spaced.size()));
+        EXPECT_EQ((Records{{"a", "3"}}), ReadAll(as_one)) << read_size;
+    }
+}
+
+TEST(RowFilter, NotBadRows)
+{
+    ElegentFileReader efr(4096, '\t');
+    efr.setErrorPolicy(OnError::SkipRow, 4);
+    efr.whereEquals(0, "A");
+    efr.open("TestFiles\\FileReader\\bad_rows.tbl");
+    std::vector<std::string> keys;
+    for (const auto& record : ReadAll(efr))
+        keys.push_back(record[0] + record[1]);
+    EXPECT_EQ((std::vector<std::string>{"A0", "A2", "A0"}), keys);
+    EXPECT_EQ(1U, efr.errors().count()); // the bad "A" row; not the bad "B" one
+
+    // backwards too
+    efr.seek(efr.fileSize());
+    EXPECT_STREQ("0", efr.readPreviousRecord()[1]);
+    EXPECT_STREQ("2", efr.readPreviousRecord()[1]);
+}
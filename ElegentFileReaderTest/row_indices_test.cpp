@@ -2,6 +2,8 @@
 
 #include <vector>
 
+#include "TimeWindow.h"
+
 struct Model {
     static size_t model_capacity() { return 20; }
 };
@@ -24,13 +26,7 @@ std::vector<size_t> expected(const Model& model = Model()) {
 }
 
 std::vector<size_t> row_indices(const Model& model = Model()) {
-    std::vector<size_t> result(model.model_capacity(), Total::NA);
-    for (size_t i = 0; i < model.model_capacity(); i++) {
-        const auto t = static_cast<int>(i + t_low);
-        if (column_dbf_from <= t && t <= column_dbf_to)
-            result[i] = i;
-    }
-    return result;
+    return TimeWindow(t_low, column_dbf_from, column_dbf_to, model.model_capacity()).row_indices();
 }
 
 TEST(row_indices, all) {
@@ -41,4 +37,40 @@ TEST(row_indices, all) {
             }
         }
     }
-}
\ No newline at end of file
+}
+
+TEST(row_indices, window) {
+    for (t_low = -25; t_low < 25; ++t_low) {
+        for (column_dbf_from = -30; column_dbf_from < 30; ++column_dbf_from) {
+            for (column_dbf_to = column_dbf_from - 1; column_dbf_to < 35; ++column_dbf_to) {
+                const TimeWindow window(t_low, column_dbf_from, column_dbf_to, Model::model_capacity());
+                const std::vector<size_t> indices = expected();
+
+                // the view, without the vector
+                std::vector<size_t> slots;
+                for (const size_t slot : window)
+                    slots.push_back(slot);
+                std::vector<size_t> expected_slots;
+                for (size_t i = 0; i < indices.size(); ++i) {
+                    EXPECT_EQ(indices[i], window[i]);
+                    if (indices[i] != Total::NA)
+                        expected_slots.push_back(i);
+                }
+                EXPECT_EQ(expected_slots, slots);
+                EXPECT_EQ(expected_slots.size(), window.size());
+            }
+        }
+    }
+}
+
+TEST(row_indices, window_limits) {
+    EXPECT_TRUE(TimeWindow(0, 5, 4, 20).empty());
+    EXPECT_TRUE(TimeWindow(0, 0, 20, 0).empty());
+    EXPECT_EQ(Total::NA, TimeWindow(0, 0, 20, 0)[0]);
+
+    // no overflow at the ends of int
+    const TimeWindow all(std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), 20);
+    EXPECT_EQ(0, all.first());
+    EXPECT_EQ(20, all.end_slot());
+    EXPECT_TRUE(TimeWindow(std::numeric_limits<int>::max(), std::numeric_limits<int>::min(), 0, 20).empty());
+}
@@ -0,0 +1,125 @@
+#include "pch.h"
+
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ElegentFileReader.h"
+#include "InputSource.h"
+#include "Sampling.h"
+#include "TestHelpers.h"
+
+using test::TempPath;
+using test::WriteFile;
+
+namespace {
+/// every record by its offset
+std::map<uint64_t, std::vector<std::string>> ByOffset(ElegentFileReader& efr)
+{
+    std::vector<uint64_t> offsets;
+    efr.seek(0);
+    test::Records records = test::ReadAll(efr, &offsets);
+    std::map<uint64_t, std::vector<std::string>> by_offset;
+    for (size_t i = 0; i < records.size(); ++i)
+        by_offset[offsets[i]] = std::move(records[i]);
+    return by_offset;
+}
+}
+
+TEST(Sampling, FixedWidthRecordsAreEstimatedExactly)
+{
+    std::string text = "key\tnumber\ttext\n";
+    char record[64];
+    for (int i = 0; i < 10000; ++i) {
+        snprintf(record, sizeof(record), "K%05d\t%08d\tabc\n", i, i * 7);
+        text += record;
+    }
+    ElegentFileReader efr(4_Kb, '\t');
+    efr.open(std::make_unique<MemorySource>(text.data(), text.size()));
+    const FileEstimate estimate = EstimateStats(efr, 100);
+    EXPECT_EQ(100U, estimate.sampled_);
+    EXPECT_EQ(10000U, estimate.records_);
+    EXPECT_DOUBLE_EQ(20.0, estimate.average_record_length_);
+    EXPECT_EQ(3U, estimate.fields_);
+    EXPECT_EQ((std::vector<double>{6, 8, 3}), estimate.field_widths_);
+    EXPECT_EQ((std::vector<size_t>{6, 8, 3}), estimate.max_field_widths_);
+}
+
+TEST(Sampling, Sample)
+{
+    // records of 10 to 40 bytes, CRLF
+    std::string text = "key\tvalue\r\n";
+    for (int i = 0; i < 100; ++i)
+        text += "K" + std::to_string(i) + "\t" + std::string(5 + (i * 37) % 30, 'x') + "\r\n";
+    const std::string path = WriteFile(TempPath("efr_test_sample.tbl"), text);
+    ElegentFileReader efr(64, '\t');
+    efr.open(path.c_str());
+    const auto records = ByOffset(efr);
+
+    // left where it was
+    efr.seek(0);
+    efr.skipRecord();
+    efr.skipRecord();
+    const uint64_t position = efr.ftell();
+    const std::vector<SampledRecord> sample = Sample(efr, 5000, true, 42);
+    EXPECT_EQ(position, efr.ftell());
+    EXPECT_STREQ("K1", efr.readRecord()[0]);
+
+    // real records, in file order, and every one picked (the 1st and last too), never the header
+    ASSERT_EQ(5000U, sample.size());
+    std::set<uint64_t> picked;
+    for (size_t i = 0; i < sample.size(); ++i) {
+        ASSERT_EQ(1U, records.count(sample[i].offset_));
+        EXPECT_EQ(records.at(sample[i].offset_), sample[i].fields_);
+        EXPECT_EQ(sample[i].fields_[0].size() + sample[i].fields_[1].size() + 3, sample[i].length_);
+        if (i) {
+            EXPECT_LE(sample[i - 1].offset_, sample[i].offset_);
+        }
+        picked.insert(sample[i].offset_);
+    }
+    EXPECT_EQ(100U, picked.size());
+    EXPECT_EQ(0U, picked.count(0));
+
+    // the same seed, the same records
+    std::vector<uint64_t> offsets1;
+    std::vector<uint64_t> offsets2;
+    std::vector<uint64_t> offsets3;
+    for (const auto& record : Sample(efr, 10, true, 7))
+        offsets1.push_back(record.offset_);
+    for (const auto& record : Sample(efr, 10, true, 7))
+        offsets2.push_back(record.offset_);
+    for (const auto& record : Sample(efr, 10, true, 8))
+        offsets3.push_back(record.offset_);
+    EXPECT_EQ(offsets1, offsets2);
+    EXPECT_NE(offsets1, offsets3);
+
+    // without a header, the 1st record can be picked
+    std::set<uint64_t> no_header;
+    for (const auto& record : Sample(efr, 5000, false))
+        no_header.insert(record.offset_);
+    EXPECT_EQ(101U, no_header.size());
+
+    const FileEstimate estimate = EstimateStats(efr, 1000);
+    EXPECT_NEAR(100.0, double(estimate.records_), 10.0);
+    EXPECT_EQ(2U, estimate.fields_);
+    EXPECT_NEAR(2.9, estimate.field_widths_[0], 0.2);
+    EXPECT_EQ(34U, estimate.max_field_widths_[1]);
+}
+
+TEST(Sampling, NothingToSample)
+{
+    ElegentFileReader efr;
+    efr.open("TestFiles\\empty file.txt");
+    EXPECT_EQ(0U, EstimateStats(efr).sampled_);
+    efr.close();
+
+    const std::string header_only = "key\tvalue\n";
+    efr.open(std::make_unique<MemorySource>(header_only.data(), header_only.size()));
+    EXPECT_TRUE(Sample(efr, 10).empty());
+    EXPECT_EQ(1U, Sample(efr, 1, false).size());
+    EXPECT_EQ(0U, EstimateStats(efr).records_);
+    EXPECT_EQ(1U, EstimateStats(efr, 10, false).records_);
+}
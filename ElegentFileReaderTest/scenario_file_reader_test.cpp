@@ -0,0 +1,63 @@
+#include "pch.h"
+
+#include "ScenarioFileReader.h"
+
+namespace {
+const char* const marker_file = "TestFiles\\Scenario\\econ_scen_markers.tbl";
+const char* const scenario_file = "TestFiles\\Scenario\\econ_scen.csv";
+}
+
+TEST(ScenarioFileReader, Markers) {
+    ScenarioFileReader sfr;
+    EXPECT_NO_THROW(sfr.open(marker_file, scenario_file));
+
+    EXPECT_EQ(4, sfr.scenarioCount());
+    EXPECT_EQ(0, sfr.markers_[0]);
+    EXPECT_EQ(60, sfr.scenarioOffset(1));
+    EXPECT_EQ(472, sfr.scenarioOffset(2));
+    EXPECT_EQ(874, sfr.scenarioOffset(3));
+    EXPECT_EQ(1288, sfr.scenarioOffset(4));
+
+    EXPECT_ANY_THROW(sfr.readScenario(0));
+    EXPECT_ANY_THROW(sfr.readScenario(5));
+}
+
+TEST(ScenarioFileReader, ReadInOrder) {
+    for (uint32_t read_size = 7; read_size < 2000; read_size += 97) {
+        ScenarioFileReader sfr(read_size);
+        sfr.open(marker_file, scenario_file);
+
+        for (size_t s = 1; s <= sfr.scenarioCount(); ++s) {
+            const auto& scenario = sfr.readScenario(s);
+            EXPECT_EQ(s, scenario.number_);
+            EXPECT_EQ(12, scenario.months_);
+            EXPECT_EQ(4, scenario.variables_);
+            EXPECT_EQ(48, scenario.values_.size());
+        }
+    }
+}
+
+TEST(ScenarioFileReader, RandomAccess) {
+    ScenarioFileReader sfr(64u);
+    sfr.open(marker_file, scenario_file);
+
+    // jump straight to scenario 3 - scenario 4 is prefetched, but we go backwards instead
+    auto scenario = sfr.readScenario(3);
+    EXPECT_DOUBLE_EQ(0.0031, scenario.row(0)[0]);
+    EXPECT_DOUBLE_EQ(142.5761, scenario.row(11)[2]);
+    EXPECT_DOUBLE_EQ(0.0065, scenario.row(11)[3]);
+
+    scenario = sfr.readScenario(1);
+    EXPECT_DOUBLE_EQ(0.0011, scenario.row(0)[0]);
+    EXPECT_DOUBLE_EQ(111.5668, scenario.row(10)[2]);
+    EXPECT_DOUBLE_EQ(0.0186, scenario.row(11)[1]);
+
+    // the prefetched scenario is the same as one read directly
+    const auto prefetched = sfr.readScenario(2);
+    ScenarioFileReader direct(64u);
+    direct.open(marker_file, scenario_file);
+    EXPECT_EQ(direct.readScenario(2).values_, prefetched.values_);
+
+    sfr.close();
+    EXPECT_EQ(0, sfr.scenarioCount());
+}
@@ -0,0 +1,103 @@
+#include "pch.h"
+
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "CompressedSource.h"
+#include "ElegentFileReader.h"
+#include "TableLoader.h"
+#include "TestHelpers.h"
+
+#if ELEGENT_READER_GZIP
+#include <zlib.h>
+#endif
+
+using score::TableLoader;
+using test::ReadAll;
+using test::Records;
+
+namespace {
+const std::vector<std::string> tables = {
+    "TestFiles\\input_variable\\CASHFLOWS_INFO_5b60b791-33be-4b80-ac8b-0562ac731092.tbl",
+    "TestFiles\\input_variable\\PRODUCT_INFO_c957804e-87d7-4f51-bbcd-a93e5d026a9b.tbl",
+    "TestFiles\\input_variable\\RISK_BEN_DEFN_5aa10c7b-390a-4f5d-91e6-25f6d162bca3__nolf.tbl",
+    "TestFiles\\fr_records.tbl",
+    "TestFiles\\Meritz.tbl",
+    "TestFiles\\empty file.txt",
+};
+}
+
+TEST(TableLoader, SameAsOneAtATime)
+{
+    std::vector<Records> expected;
+    for (const auto& table : tables)
+        expected.push_back(ReadAll(table.c_str()));
+
+    // a budget for about two 4 KB readers at once (each charged 8 KB)
+    for (const uint64_t budget : {20_Kb, 16 * 1024_Kb}) {
+        TableLoader loader(4, budget, static_cast<uint32_t>(4_Kb));
+        std::vector<Records> loaded(tables.size());
+        for (size_t i = 0; i < tables.size(); ++i)
+            loader.add(tables[i], [&, i](ElegentFileReader& efr) { loaded[i] = ReadAll(efr); });
+        EXPECT_EQ(tables.size(), loader.size());
+        loader.load();
+        EXPECT_EQ(0U, loader.size());
+        EXPECT_EQ(expected, loaded);
+        EXPECT_LT(0U, loader.peakBufferBytes());
+        EXPECT_GE(budget, loader.peakBufferBytes());
+    }
+
+    // a budget smaller than one buffer still loads, a table at a time
+    TableLoader loader(2, 100);
+    Records loaded;
+    loader.add(tables[4], [&](ElegentFileReader& efr) { loaded = ReadAll(efr); });
+    loader.load();
+    EXPECT_EQ(expected[4], loaded);
+    EXPECT_EQ(100U, loader.peakBufferBytes());
+}
+
+#if ELEGENT_READER_GZIP
+TEST(TableLoader, Compressed)
+{
+    const Records expected = ReadAll(tables[4].c_str());
+
+    // the same table gzipped: charged what it decompresses ahead too
+    const std::string path = test::TempPath("efr_table_loader.tbl.gz");
+    const std::string text = test::Contents(tables[4]);
+    const gzFile gz = gzopen(path.c_str(), "wb");
+    ASSERT_NE(nullptr, gz);
+    ASSERT_EQ(int(text.size()), gzwrite(gz, text.data(), static_cast<unsigned>(text.size())));
+    ASSERT_EQ(Z_OK, gzclose(gz));
+
+    TableLoader loader(2, 64 * 1024_Kb, static_cast<uint32_t>(4_Kb));
+    Records loaded;
+    loader.add(path, [&](ElegentFileReader& efr) { loaded = ReadAll(efr); });
+    loader.load();
+    EXPECT_EQ(expected, loaded);
+    EXPECT_LE(CompressedSource::max_buffer_bytes + 8_Kb, loader.peakBufferBytes());
+}
+#endif
+
+TEST(TableLoader, Errors)
+{
+    TableLoader loader(3);
+    std::vector<Records> loaded(3);
+    loader.add(tables[0], [&](ElegentFileReader& efr) { loaded[0] = ReadAll(efr); });
+    loader.add("TestFiles\\no such file.tbl", [&](ElegentFileReader& efr) { loaded[1] = ReadAll(efr); });
+    loader.add(tables[1], [&](ElegentFileReader&) { throw std::exception("bad table"); });
+    loader.add(tables[2], [&](ElegentFileReader& efr) { loaded[2] = ReadAll(efr); });
+    try {
+        loader.load();
+        FAIL();
+    } catch (const std::exception& e) {
+        // the 1st that failed, in the order added
+        EXPECT_EQ(0U, std::string(e.what()).find("TestFiles\\no such file.tbl: cannot open"));
+    }
+    // the others were still loaded
+    EXPECT_FALSE(loaded[0].empty());
+    EXPECT_TRUE(loaded[1].empty());
+    EXPECT_FALSE(loaded[2].empty());
+    EXPECT_EQ(0U, loader.size());
+    loader.load(); // nothing to do
+}
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "CalculationState.h"
+#include "ColumnAggregate.h"
 
 
 //const double NO_AVG = score::DoubleState(score::CalculationState::NoAvg).as_double_state_in_high_dword();
@@ -17,19 +18,29 @@ static __forceinline double __vectorcall HandleNoAvg(const double value) {
 
 double d[] = { NO_AVG,2,3,4,5,6,7,8,9,10 };
 double sums[] = { 0,0,0,0,0,0,0,0,0,0 };
-size_t cc[] = { 0,0,0,0,0,0,0,0,0,0 };
+uint64_t cc[] = { 0,0,0,0,0,0,0,0,0,0 };
 
 
+// The two loops are now score::accumulate(), fused and vectorized - the benchmark is BM_Accumulate
 TEST(ElegentFileReader, avxing) {
-    size_t n;
-    std::cout << "Testing AVX  - Run a small loop to debug \nEnter n <= 10 ";
-    std::cin >> n;
+    const size_t n = sizeof(d) / sizeof(d[0]);
+    double loop_sums[n] = {};
+    uint64_t loop_cc[n] = {};
     for (size_t i = 0; i < n; ++i) {
-        sums[i] += (d[i] == NO_AVG) ? 0 : d[i];
+        loop_sums[i] += (d[i] == NO_AVG) ? 0 : d[i];
     }
     for (size_t i = 0; i < n; ++i) {
-        cc[i] += (d[i] == NO_AVG) ? 0 : 1;
+        loop_cc[i] += (d[i] == NO_AVG) ? 0 : 1;
+    }
+
+    // the kernels know NoAvg as the CalculationState
+    double states[n];
+    std::copy(d, d + n, states);
+    score::DoubleState::set<score::CalculationState::NoAvg>(states[0]);
+    score::accumulate(states, n, sums, cc);
+    for (size_t i = 0; i < n; ++i) {
+        EXPECT_EQ(loop_sums[i], sums[i]);
+        EXPECT_EQ(loop_cc[i], cc[i]);
     }
     EXPECT_EQ(0.0, sums[0]);
 }
-
@@ -0,0 +1,110 @@
+#include "pch.h"
+
+#include <string>
+
+#include "TextEncoding.h"
+
+namespace {
+bool IsValidUtf8(const std::string& text)
+{
+    Utf8Validator validator;
+    validator.update(text.data(), text.size());
+    return validator.finish();
+}
+
+/// the same text fed a byte at a time: characters straddle every call
+bool IsValidUtf8_ByteAtATime(const std::string& text)
+{
+    Utf8Validator validator;
+    for (const char c : text)
+        validator.update(&c, 1);
+    return validator.finish();
+}
+}
+
+TEST(TextEncoding, IsAscii)
+{
+    const std::string ascii(100, 'a');
+    EXPECT_TRUE(IsAscii(ascii.data(), ascii.size()));
+    EXPECT_TRUE(IsAscii(ascii.data(), 0));
+
+    for (const size_t at : {0, 7, 31, 32, 63, 99}) {
+        std::string text = ascii;
+        text[at] = '\x80';
+        EXPECT_FALSE(IsAscii(text.data(), text.size())) << at;
+    }
+}
+
+TEST(TextEncoding, ValidUtf8)
+{
+    const std::string korean("\xEA\xB8\x89\xEC\x88\x98");     // 급수
+    const std::string japanese("\xE7\xB5\x82\xE8\xBA\xAB");   // 終身
+    const std::string four_byte("\xF0\x9F\x98\x80");          // U+1F600
+    const std::string limits("\xC2\x80\xDF\xBF\xE0\xA0\x80\xED\x9F\xBF\xEE\x80\x80\xF0\x90\x80\x80\xF4\x8F\xBF\xBF");
+
+    for (const auto& text : {std::string(), std::string("plain ascii"), korean, japanese, four_byte, limits,
+                             std::string(45, 'x') + korean + std::string(30, 'y') + four_byte + limits}) {
+        EXPECT_TRUE(IsValidUtf8(text)) << text;
+        EXPECT_TRUE(IsValidUtf8_ByteAtATime(text)) << text;
+    }
+}
+
+TEST(TextEncoding, InvalidUtf8)
+{
+    const char* const invalid[] = {
+        "\x80",             // continuation without a lead
+        "\xC0\x80",         // overlong 2 byte
+        "\xC1\xBF",
+        "\xE0\x80\x80",     // overlong 3 byte
+        "\xE0\x9F\xBF",
+        "\xED\xA0\x80",     // surrogate
+        "\xF0\x80\x80\x80", // overlong 4 byte
+        "\xF4\x90\x80\x80", // above U+10FFFF
+        "\xF5\x80\x80\x80",
+        "\xFF",
+        "\xE3\x81",         // cut short at the end
+        "\xE3\x81" "a",     // cut short by ASCII
+        "\xC3\xA9\xA9",     // one continuation too many
+    };
+
+    for (const char* const bytes : invalid) {
+        // at the start, at the end, and after a whole chunk of ASCII
+        for (const auto& text : {std::string(bytes), std::string("abc") + bytes, std::string(40, 'x') + bytes + std::string(40, 'y')}) {
+            EXPECT_FALSE(IsValidUtf8(text)) << text;
+            EXPECT_FALSE(IsValidUtf8_ByteAtATime(text)) << text;
+        }
+    }
+}
+
+TEST(TextEncoding, Utf8_AsciiBlocks)
+{
+    // a character can't be left open across an ASCII block
+    Utf8Validator validator;
+    EXPECT_TRUE(validator.update("ab\xE3\x81", 4));
+    EXPECT_FALSE(validator.updateAscii());
+    EXPECT_FALSE(validator.finish());
+
+    validator.reset();
+    EXPECT_TRUE(validator.update("ab\xE3\x81\x82", 5));
+    EXPECT_TRUE(validator.updateAscii());
+    EXPECT_TRUE(validator.update("\xE3\x81\x82", 3));
+    EXPECT_TRUE(validator.finish());
+}
+
+TEST(TextEncoding, ShiftJisToUtf8)
+{
+    std::string result("prefix:");
+    ShiftJisToUtf8("\x8F\x49\x90\x67\x95\xDB\x8C\xAF", 8, result); // 終身保険
+    EXPECT_EQ("prefix:\xE7\xB5\x82\xE8\xBA\xAB\xE4\xBF\x9D\xE9\x99\xBA", result);
+
+    result.clear();
+    ShiftJisToUtf8("\xC1" "1", 2, result); // half width katakana
+    EXPECT_EQ("\xEF\xBE\x81" "1", result);
+
+    result.clear();
+    ShiftJisToUtf8("\x87\x40", 2, result); // a circled 1: code page 932 rather than plain Shift-JIS
+    EXPECT_EQ("\xE2\x91\xA0", result);
+
+    result.clear();
+    EXPECT_ANY_THROW(ShiftJisToUtf8("\x82", 1, result)); // lead byte without its trail byte
+}
@@ -0,0 +1,144 @@
+#include "pch.h"
+
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CSVFileIndex.h"
+#include "ElegentFileReader.h"
+#include "Trace.h"
+
+namespace {
+size_t Count(const std::string& text, const std::string& what)
+{
+    size_t count = 0;
+    for (size_t pos = text.find(what); pos != std::string::npos; pos = text.find(what, pos + what.size()))
+        ++count;
+    return count;
+}
+
+std::string ChromeJson()
+{
+    std::ostringstream os;
+    trace::write_chrome_json(os);
+    return os.str();
+}
+
+/// on for one test, with nothing recorded before it
+class Tracing {
+public:
+    Tracing()
+    {
+        trace::clear();
+        trace::enable();
+    }
+    ~Tracing()
+    {
+        trace::enable(false);
+        trace::clear();
+    }
+};
+}
+
+TEST(Trace, OffRecordsNothing)
+{
+    trace::clear();
+    ASSERT_FALSE(trace::enabled());
+    {
+        trace::Span span("off");
+    }
+    EXPECT_EQ(0, Count(ChromeJson(), "\"ph\":\"X\""));
+}
+
+TEST(Trace, Spans)
+{
+    Tracing tracing;
+    {
+        trace::Span outer("outer");
+        trace::Span inner("inner");
+        inner.arg("bytes", 42);
+    }
+    const std::string json = ChromeJson();
+    EXPECT_EQ(0U, json.find("{\"traceEvents\":["));
+    EXPECT_EQ(2, Count(json, "\"ph\":\"X\""));
+    EXPECT_EQ(1, Count(json, "\"name\":\"outer\""));
+    EXPECT_EQ(1, Count(json, "\"name\":\"inner\""));
+    EXPECT_EQ(1, Count(json, "\"args\":{\"bytes\":42}"));
+
+    trace::clear();
+    EXPECT_EQ(0, Count(ChromeJson(), "\"ph\":\"X\""));
+}
+
+TEST(Trace, KeepsTheLastSpans)
+{
+    Tracing tracing;
+    for (size_t i = 0; i < trace::events_per_thread + 10; ++i) {
+        trace::Span span("span");
+        span.arg("i", i);
+    }
+    const std::string json = ChromeJson();
+    EXPECT_EQ(trace::events_per_thread, Count(json, "\"name\":\"span\""));
+    EXPECT_EQ(0, Count(json, "{\"i\":9}"));
+    EXPECT_EQ(1, Count(json, "{\"i\":10}"));
+    EXPECT_EQ(1, Count(json, "{\"i\":" + std::to_string(trace::events_per_thread + 9) + "}"));
+}
+
+TEST(Trace, ThreadsGetTheirOwnTimeline)
+{
+    Tracing tracing;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 3; ++t)
+        threads.emplace_back([] {
+            trace::name_thread("reader \"thread\"");
+            for (int i = 0; i < 100; ++i)
+                trace::Span span("work");
+        });
+    for (auto& thread : threads)
+        thread.join();
+
+    const std::string json = ChromeJson();
+    EXPECT_EQ(300, Count(json, "\"name\":\"work\""));
+    EXPECT_EQ(3, Count(json, "\"args\":{\"name\":\"reader \\\"thread\\\"\"}"));
+}
+
+TEST(Trace, ExportWhileTracing)
+{
+    // a writer lapping the export many times over: every span exported is whole
+    Tracing tracing;
+    std::atomic<bool> stop(false);
+    std::thread writer([&] {
+        for (uint64_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+            trace::Span span("busy");
+            span.arg("i", i);
+        }
+    });
+    for (int i = 0; i < 20; ++i) {
+        const std::string json = ChromeJson();
+        EXPECT_EQ(Count(json, "\"ph\":\"X\""), Count(json, "{\"name\":\"busy\",\"cat\":\"efr\""));
+        EXPECT_EQ(Count(json, "\"ph\":\"X\""), Count(json, "\"args\":{\"i\":"));
+    }
+    stop = true;
+    writer.join();
+}
+
+TEST(Trace, ReaderAndIndex)
+{
+    Tracing tracing;
+    ElegentFileReader efr(16, '\t');
+    efr.open("TestFiles\\fr_record.tbl");
+    CSVFileIndex index;
+    index.createIndex(efr, 2);
+    std::vector<CSVFileIndex::FileBlockInfo> blocks;
+    index.find({"1.1", "no such key"}, blocks);
+    ASSERT_EQ(2U, blocks.size());
+    EXPECT_EQ(0U, blocks[1].record_count_);
+
+    const std::string json = ChromeJson();
+    EXPECT_EQ(1, Count(json, "\"name\":\"open\""));
+    EXPECT_LT(1U, Count(json, "\"name\":\"readBlock\""));
+    EXPECT_EQ(1, Count(json, "\"name\":\"createIndex\""));
+    EXPECT_EQ(1, Count(json, "\"args\":{\"keys\":6}"));
+    EXPECT_EQ(1, Count(json, "\"name\":\"find\""));
+}
@@ -0,0 +1,92 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "CalculationState.h"
+#include "WorkerPool.h"
+
+using score::CalculationState;
+using score::DoubleState;
+using score::WorkerPool;
+
+TEST(WorkerPool, RunsOnEveryWorker)
+{
+    WorkerPool pool(4);
+    EXPECT_EQ(4, pool.size());
+
+    for (int run = 0; run < 3; ++run) {
+        std::vector<std::thread::id> ids(pool.size());
+        std::atomic<size_t> calls(0);
+        pool.run([&](const size_t worker) {
+            ids[worker] = std::this_thread::get_id();
+            ++calls;
+        });
+        EXPECT_EQ(pool.size(), calls.load());
+        EXPECT_EQ(pool.size(), std::set<std::thread::id>(ids.begin(), ids.end()).size());
+        EXPECT_EQ(0, std::count(ids.begin(), ids.end(), std::this_thread::get_id()));
+    }
+
+    EXPECT_LE(1, WorkerPool().size());
+    EXPECT_EQ(2, WorkerPool(2, true).size());
+}
+
+TEST(WorkerPool, RethrowsErrors)
+{
+    WorkerPool pool(3);
+    EXPECT_THROW(pool.run([](const size_t worker) {
+        if (1 == worker)
+            throw std::runtime_error("worker 1");
+    }), std::runtime_error);
+
+    // and still works
+    std::atomic<size_t> calls(0);
+    pool.run([&](size_t) { ++calls; });
+    EXPECT_EQ(3, calls.load());
+}
+
+TEST(WorkerPool, Partition)
+{
+    const std::vector<double> values(100000);
+    for (const size_t workers : {1, 3, 8}) {
+        WorkerPool pool(workers);
+        for (const size_t offset : {0, 1, 7}) {
+            for (const size_t size : {0, 1, 511, 512, 5000, 99990}) {
+                const double* const column = values.data() + offset;
+                size_t end = 0;
+                for (size_t worker = 0; worker < pool.size(); ++worker) {
+                    const WorkerPool::Range part = pool.partition(column, size, worker);
+                    ASSERT_EQ(end, part.begin_) << workers << " workers, size " << size << ", worker " << worker;
+                    ASSERT_LE(part.begin_, part.end_);
+                    // on a page, apart from the ends
+                    if (part.begin_ && part.begin_ < size) {
+                        ASSERT_EQ(0, reinterpret_cast<uintptr_t>(column + part.begin_) % 4096);
+                    }
+                    end = part.end_;
+                }
+                EXPECT_EQ(size, end);
+            }
+        }
+    }
+}
+
+TEST(WorkerPool, SetNotCalculated)
+{
+    WorkerPool pool(4);
+    for (const size_t size : {size_t(100), score::detail::min_parallel_fill_bytes / sizeof(double) + 3}) {
+        // not yet touched, as a column to be placed by the reset would be
+        const std::unique_ptr<double[]> values(new double[size + 1]);
+        values[size] = 1.5;
+        DoubleState::set_not_calculated_score(pool, values.get(), size);
+        EXPECT_EQ(size, DoubleState::count_states(values.get(), size).not_calculated_);
+        EXPECT_EQ(1.5, values[size]);
+
+        DoubleState::set_not_calculated_saturn(pool, values.get(), size);
+        EXPECT_EQ(size, DoubleState::count_states(values.get(), size).not_calculated_saturn_);
+    }
+}
@@ -0,0 +1,202 @@
+#include "pch.h"
+
+#include <string>
+
+#include "ProductXmlReader.h"
+#include "XmlPullReader.h"
+
+namespace {
+/// flatten the token stream so that it can be compared across read sizes
+std::string Tokens(const char* filename, const uint32_t read_size)
+{
+    XmlPullReader xml(read_size);
+    xml.open(filename);
+
+    std::string tokens;
+    for (auto token = xml.next(); token != XmlPullReader::Token::EndOfDocument; token = xml.next()) {
+        switch (token) {
+        case XmlPullReader::Token::StartElement:
+            tokens += '<';
+            tokens += xml.name();
+            for (const auto& attribute : xml.attributes()) {
+                tokens += ' ';
+                tokens += attribute.name_;
+                tokens += '=';
+                tokens += attribute.value_;
+            }
+            tokens += '>';
+            break;
+        case XmlPullReader::Token::EndElement:
+            tokens += "</";
+            tokens += xml.name();
+            tokens += '>';
+            break;
+        case XmlPullReader::Token::Text:
+            tokens += xml.text();
+            break;
+        default: ;
+        }
+    }
+    EXPECT_EQ(0, xml.depth());
+    return tokens;
+}
+
+const char* const lookup_test = "TestFiles\\XmlReader\\product_xml_reader_lookup_test.xml";
+const char* const input_variables_test = "TestFiles\\XmlReader\\product_xml_reader_input_variables_test.xml";
+const char* const composite_test = "TestFiles\\XmlReader\\product_xml_reader_composite_external_sources.xml";
+}
+
+TEST(XmlPullReader, NonExistentFile) {
+    XmlPullReader xml;
+    EXPECT_ANY_THROW(xml.open("file that does not exist"));
+    EXPECT_FALSE(xml.isOpen());
+}
+
+TEST(XmlPullReader, Tokens) {
+    XmlPullReader xml;
+    xml.open(lookup_test);
+
+    ASSERT_EQ(XmlPullReader::Token::StartElement, xml.next());
+    EXPECT_EQ("assumptionset", xml.name());
+    EXPECT_EQ("default1", xml.attribute("topmodelclassname"));
+    EXPECT_EQ("", xml.attribute("no such attribute"));
+    EXPECT_EQ(1, xml.depth());
+
+    ASSERT_EQ(XmlPullReader::Token::StartElement, xml.next());
+    EXPECT_EQ("externalSources", xml.name());
+
+    ASSERT_EQ(XmlPullReader::Token::StartElement, xml.next());
+    EXPECT_EQ("externalSource", xml.name());
+    EXPECT_EQ("Excel File: Book1.xlsm (Sheet4)", xml.attribute("displayname"));
+
+    // <externalSourceStructure ... /> gives a start and an end
+    ASSERT_EQ(XmlPullReader::Token::StartElement, xml.next());
+    EXPECT_EQ("externalSourceStructure", xml.name());
+    EXPECT_EQ(12, xml.attributes().size());
+    EXPECT_EQ(4, xml.depth());
+    ASSERT_EQ(XmlPullReader::Token::EndElement, xml.next());
+    EXPECT_EQ("externalSourceStructure", xml.name());
+    EXPECT_EQ(3, xml.depth());
+    ASSERT_EQ(XmlPullReader::Token::EndElement, xml.next());
+    EXPECT_EQ("externalSource", xml.name());
+}
+
+TEST(XmlPullReader, Entities) {
+    XmlPullReader xml;
+    xml.open(input_variables_test); // this one has a unicode signature
+
+    ASSERT_EQ(XmlPullReader::Token::StartElement, xml.next());
+    EXPECT_EQ("assumptionset", xml.name());
+
+    while (xml.next() != XmlPullReader::Token::EndOfDocument)
+        if (xml.name() == "inputVariable")
+            break;
+    // In\u795D\u4F60\u597D\u8FD0put.P&lt;a&gt;g&amp;e&quot;1...
+    EXPECT_EQ("In\xE7\xA5\x9D\xE4\xBD\xA0\xE5\xA5\xBD\xE8\xBF\x90put.P<a>g&e\"1.non_indexed_default_floating_point_number", xml.attribute("name"));
+}
+
+TEST(XmlPullReader, SmallBlocks) {
+    // tokens that straddle block boundaries come out the same whatever the read size
+    const std::string expected = Tokens(lookup_test, static_cast<uint32_t>(64_Kb));
+    for (uint32_t read_size = 1; read_size < 300; read_size += 7)
+        EXPECT_EQ(expected, Tokens(lookup_test, read_size));
+}
+
+TEST(ProductXmlReader, Lookup) {
+    AssumptionSet set;
+    ProductXmlReader reader(256u);
+    EXPECT_NO_THROW(reader.read(lookup_test, set));
+
+    ASSERT_EQ(1, set.external_sources_.size());
+    EXPECT_EQ("795bdd78-b013-4962-8311-457b4e9c50c8", set.str(set.external_sources_[0].name_));
+    EXPECT_TRUE(set.external_sources_[0].has_structure_);
+    EXPECT_EQ(-1, set.external_sources_[0].column_key_names_column_);
+
+    ASSERT_EQ(1, set.input_variables_.size());
+    const auto& variable = set.input_variables_[0];
+    EXPECT_EQ("Input Page1.initial_variable", set.str(variable.name_));
+    EXPECT_EQ(AssumptionSet::ValueSource::Lookup, variable.value_.source_);
+    ASSERT_EQ(0, variable.lookup_);
+
+    const auto& lookup = set.lookups_[0];
+    EXPECT_EQ(AssumptionSet::none, lookup.external_source_); // not one of the external sources in the file
+    EXPECT_TRUE(lookup.has_column_key_names_);
+    EXPECT_EQ(9, lookup.key_count_);
+    ASSERT_EQ(9, set.keys_.size());
+
+    EXPECT_EQ(AssumptionSet::ValueSource::Constant, set.keys_[0].value_.source_);
+    EXPECT_EQ("Viel Gl\xC3\xBC" "ck", set.str(set.keys_[0].value_.text_)); // utf-8
+    EXPECT_EQ(2, set.keys_[0].type_);
+
+    const auto& value_of = set.keys_[2];
+    EXPECT_EQ(43, value_of.external_source_key_.length_); // 15 tamil characters in utf-8
+    EXPECT_EQ(AssumptionSet::Fallback::ValueOf, value_of.missing_);
+    EXPECT_EQ(AssumptionSet::ValueSource::InputVariable, value_of.value_.source_);
+    EXPECT_EQ("Input Page1.an_input_variable", set.str(value_of.value_.text_));
+    EXPECT_EQ("non-blank", set.str(value_of.missing_fallback_.text_));
+    EXPECT_EQ(AssumptionSet::ValueSource::Constant, value_of.before_first_fallback_.source_);
+    EXPECT_EQ("", set.str(value_of.before_first_fallback_.text_));
+    EXPECT_EQ("\xD1\x83\xD0\xB4\xD0\xB0\xD1\x87\xD0\xB8", set.str(value_of.after_last_fallback_.text_));
+
+    const auto& scalar = set.keys_[4];
+    EXPECT_EQ(AssumptionSet::ValueSource::ModelScalar, scalar.value_.source_);
+    EXPECT_EQ("a_scalar", set.str(scalar.value_.text_));
+    EXPECT_EQ("default1", set.str(scalar.value_.model_object_));
+    ASSERT_EQ(3, scalar.transformation_count_);
+    EXPECT_EQ("good luck", set.str(set.transformations_[scalar.first_transformation_ + 2].transformed_value_));
+
+    EXPECT_EQ(AssumptionSet::ValueSource::ModelColumn, set.keys_[5].value_.source_);
+    EXPECT_EQ(AssumptionSet::Fallback::Last, set.keys_[5].after_last_);
+    EXPECT_EQ(AssumptionSet::ValueSource::SystemVariable, set.keys_[6].value_.source_);
+    EXPECT_EQ(AssumptionSet::Fallback::AddExcess, set.keys_[7].after_last_);
+    EXPECT_EQ(AssumptionSet::ValueSource::None, set.keys_[7].after_last_fallback_.source_);
+    EXPECT_EQ(AssumptionSet::KeyType::Row, set.keys_[8].key_type_);
+    EXPECT_TRUE(set.keys_[8].use_position_);
+}
+
+TEST(ProductXmlReader, InputVariables) {
+    AssumptionSet set;
+    ProductXmlReader().read(input_variables_test, set);
+
+    EXPECT_EQ(28, set.input_variables_.size());
+    EXPECT_EQ(AssumptionSet::ValueSource::Default, set.input_variables_[0].value_.source_);
+    EXPECT_EQ(AssumptionSet::ValueSource::Constant, set.input_variables_[6].value_.source_);
+    EXPECT_EQ("12", set.str(set.input_variables_[6].value_.text_));
+    EXPECT_EQ(4, set.input_variables_[8].type_);
+    EXPECT_EQ("1 2 3", set.str(set.input_variables_[8].value_.text_));
+
+    // the values of an indexed input variable belong to it; the variable it is indexed by is not a definition
+    size_t indexed_values = 0;
+    for (const auto& variable : set.input_variables_) {
+        if (AssumptionSet::none == variable.parent_)
+            continue;
+        const auto& parent = set.input_variables_[variable.parent_];
+        EXPECT_EQ(set.str(parent.name_), set.str(variable.name_).substr(0, parent.name_.length_));
+        EXPECT_EQ(parent.type_, variable.type_);
+        ++indexed_values;
+    }
+    EXPECT_EQ(6, indexed_values);
+}
+
+TEST(ProductXmlReader, CompositeExternalSources) {
+    AssumptionSet set;
+    ProductXmlReader().read(composite_test, set);
+
+    ASSERT_EQ(6, set.external_sources_.size());
+    EXPECT_EQ("<*project_directory*>Inputs\\Book1.xlsx", set.str(set.external_sources_[0].original_location_));
+    EXPECT_TRUE(set.external_sources_[2].is_composite_);
+    EXPECT_EQ(2, set.external_sources_[2].num_row_keys_);
+
+    // the lookups are resolved to their external sources
+    ASSERT_EQ(2, set.lookups_.size());
+    EXPECT_EQ(2, set.lookups_[0].external_source_);
+    EXPECT_EQ(5, set.lookups_[1].external_source_);
+    EXPECT_EQ(5, set.lookups_[1].first_key_);
+    EXPECT_EQ(5, set.lookups_[1].key_count_);
+    EXPECT_EQ("h", set.str(set.keys_[6].missing_fallback_.text_));
+}
+
+TEST(ProductXmlReader, InvalidInteger) {
+    AssumptionSet set;
+    EXPECT_ANY_THROW(ProductXmlReader().read("TestFiles\\XmlReader\\product_xml_reader_invalid_integer_conversion_exception.xml", set));
+}